@@ -0,0 +1,89 @@
+#!/usr/bin/env bash
+# Runs a dedicated server on each map with 8, 16, 32 and 64 headless bots and collects the server's csv.
+# Also writes server.csv with the server binary size, the time from launch to accepting connections and the idle
+# resident memory of every run. Needs no GPU, everything runs with -nullrhi.
+# corrections.csv gets the movement corrections per minute the bots were sent, set PKTLAG to add that many ms of
+# simulated latency each way and PREDICT_MOVE_STATE=0 to compare against the unpredicted carry speed.
+# items.csv gets the average items in flight, all bytes per second each connection was sent and the item movement
+# bytes per second each connection was sent per in-flight item, set COMPACT_ITEM_MOVEMENT=0 to count the stock
+# FRepMovement in the same column instead.
+#
+# usage: [PKTLAG=ms] [PREDICT_MOVE_STATE=0|1] [COMPACT_ITEM_MOVEMENT=0|1] Scripts/LoadTest.sh <server binary> <client binary> [duration seconds] [output dir]
+#   e.g. PKTLAG=60 Scripts/LoadTest.sh Binaries/Linux/LlamaLlamaServer Binaries/Linux/LlamaLlama 120 Saved/LoadTest
+
+set -euo pipefail
+
+SERVER="${1:?server binary}"
+CLIENT="${2:?client binary}"
+DURATION="${3:-120}"
+OUT="${4:-Saved/LoadTest}"
+PORT=7777
+MAPS=(City Farm)
+COUNTS=(8 16 32 64)
+PKTLAG="${PKTLAG:-0}"
+PREDICT_MOVE_STATE="${PREDICT_MOVE_STATE:-1}"
+COMPACT_ITEM_MOVEMENT="${COMPACT_ITEM_MOVEMENT:-1}"
+
+mkdir -p "$OUT"
+OUT="$(cd "$OUT" && pwd)"
+
+SERVER_BYTES=$(stat -c %s "$SERVER")
+echo "map,llamas,binary_bytes,ready_s,idle_mb" > "$OUT/server.csv"
+echo "map,llamas,pktlag_ms,predict_move_state,bot_minutes,corrections_per_min" > "$OUT/corrections.csv"
+echo "map,llamas,compact_item_movement,items_in_flight,out_bytes_per_conn_s,item_move_bytes_per_conn_item_s" > "$OUT/items.csv"
+
+for MAP in "${MAPS[@]}"; do
+	for COUNT in "${COUNTS[@]}"; do
+		CSV="$OUT/${MAP}_${COUNT}.csv"
+		echo "== $MAP with $COUNT llamas -> $CSV"
+
+		"$SERVER" "/Game/LlamaLlama/Maps/$MAP" -server -nullrhi -nosound -unattended -log \
+			-port=$PORT -LlamaLoadTest="$CSV" -LoadTestDuration="$DURATION" \
+			-PktLag=$PKTLAG -ExecCmds="Llama.PredictMoveState $PREDICT_MOVE_STATE, Llama.CompactItemMovement $COMPACT_ITEM_MOVEMENT" \
+			> "$OUT/${MAP}_${COUNT}_server.log" 2>&1 &
+		SERVER_PID=$!
+
+		# wait for the map to load before the bots knock, the load test subsystem logs once the server accepts connections
+		SERVER_LOG="$OUT/${MAP}_${COUNT}_server.log"
+		for ((t = 0; t < 120; t++)); do
+			grep -q "Server ready:" "$SERVER_LOG" && break
+			kill -0 "$SERVER_PID" 2>/dev/null || break
+			sleep 1
+		done
+		READY=$(sed -n 's/.*Server ready: accepting connections \([0-9.]*\) s after launch, \([0-9.]*\) MB resident.*/\1,\2/p' "$SERVER_LOG" | head -n 1)
+		if [[ -z "$READY" ]]; then
+			echo "error: the $MAP server never logged Server ready, see $SERVER_LOG" >&2
+			kill "$SERVER_PID" 2>/dev/null || true
+			wait "$SERVER_PID" 2>/dev/null || true
+			exit 1
+		fi
+		echo "$MAP,$COUNT,$SERVER_BYTES,$READY" >> "$OUT/server.csv"
+
+		BOT_PIDS=()
+		for ((i = 0; i < COUNT; i++)); do
+			"$CLIENT" "127.0.0.1:$PORT" -game -nullrhi -nosound -unattended -log -LlamaBot \
+				-PktLag=$PKTLAG -ExecCmds="Llama.PredictMoveState $PREDICT_MOVE_STATE" > "$OUT/${MAP}_${COUNT}_bot$i.log" 2>&1 &
+			BOT_PIDS+=($!)
+		done
+
+		# the server exits on its own after the duration
+		wait "$SERVER_PID" || true
+
+		kill "${BOT_PIDS[@]}" 2>/dev/null || true
+		wait "${BOT_PIDS[@]}" 2>/dev/null || true
+
+		# every bot logs one line per minute
+		cat "$OUT/${MAP}_${COUNT}"_bot*.log | sed -n 's/.*Bot corrections: \([0-9]*\) in the last minute.*/\1/p' \
+			| awk -v prefix="$MAP,$COUNT,$PKTLAG,$PREDICT_MOVE_STATE" \
+				'{ total += $1; minutes++ } END { printf "%s,%d,%.1f\n", prefix, minutes, minutes ? total / minutes : 0 }' \
+			>> "$OUT/corrections.csv"
+
+		# out_bytes_per_conn_s is column 7, items_in_flight 13 and item_move_bytes_per_conn_item_s 14
+		awk -F, -v prefix="$MAP,$COUNT,$COMPACT_ITEM_MOVEMENT" \
+			'NR > 1 { items += $13; out += $7; move += $14; rows++ }
+			END { printf "%s,%.1f,%.1f,%.1f\n", prefix, rows ? items / rows : 0, rows ? out / rows : 0, rows ? move / rows : 0 }' \
+			"$CSV" >> "$OUT/items.csv"
+	done
+done
+
+echo "done, csv files in $OUT"
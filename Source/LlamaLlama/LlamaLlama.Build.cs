@@ -8,6 +8,14 @@ public class LlamaLlama : ModuleRules
 	{
 		PCHUsage = PCHUsageMode.UseExplicitOrSharedPCHs;
 
-		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore", "HeadMountedDisplay" });
+		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore" });
+
+		// VR is client only, the server target compiles those code paths out with UE_SERVER
+		if (Target.Type != TargetType.Server)
+		{
+			PublicDependencyModuleNames.Add("HeadMountedDisplay");
+		}
+
+		PrivateDependencyModuleNames.AddRange(new string[] { "ReplicationGraph" });
 	}
 }
@@ -2,6 +2,105 @@
 
 #include "LlamaLlama.h"
 #include "Modules/ModuleManager.h"
+#include "Misc/CoreDelegates.h"
+#include "HAL/IConsoleManager.h"
+
+DEFINE_STAT(STAT_LlamaAwakeItems);
+DEFINE_STAT(STAT_LlamaDormantItems);
+
+CSV_DEFINE_CATEGORY_MODULE(LLAMALLAMA_API, Llama, true);
 
 IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, LlamaLlama, "LlamaLlama" );
- 
\ No newline at end of file
+
+//////////////////////////////////////////////////////////////////////////
+// FLlamaFrameCapture
+
+bool FLlamaFrameCapture::bCapturing = false;
+bool FLlamaFrameCapture::bRequested = false;
+
+namespace
+{
+	struct FCapturedScope
+	{
+		int32 calls = 0;
+		uint64 cycles = 0;
+	};
+
+	TMap<const TCHAR*, FCapturedScope> capturedScopes;
+	TMap<const TCHAR*, int32> capturedCounts;
+	uint64 captureStartCycles = 0;
+}
+
+void FLlamaFrameCapture::AddTime(const TCHAR* scope, uint64 cycles)
+{
+	FCapturedScope& captured = capturedScopes.FindOrAdd(scope);
+	captured.calls++;
+	captured.cycles += cycles;
+}
+
+void FLlamaFrameCapture::AddCount(const TCHAR* counter, int32 count)
+{
+	capturedCounts.FindOrAdd(counter) += count;
+}
+
+void FLlamaFrameCapture::SetCount(const TCHAR* counter, int32 count)
+{
+	capturedCounts.FindOrAdd(counter) = count;
+}
+
+void FLlamaFrameCapture::Request()
+{
+	static bool bBound = false;
+	if (!bBound)
+	{
+		FCoreDelegates::OnBeginFrame.AddStatic(&FLlamaFrameCapture::OnBeginFrame);
+		FCoreDelegates::OnEndFrame.AddStatic(&FLlamaFrameCapture::OnEndFrame);
+		bBound = true;
+	}
+
+	bRequested = true;
+}
+
+void FLlamaFrameCapture::OnBeginFrame()
+{
+	if (!bRequested)
+		return;
+
+	bRequested = false;
+	bCapturing = true;
+	capturedScopes.Reset();
+	capturedCounts.Reset();
+	captureStartCycles = FPlatformTime::Cycles64();
+}
+
+void FLlamaFrameCapture::OnEndFrame()
+{
+	if (!bCapturing)
+		return;
+
+	bCapturing = false;
+	const double frameMs = FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - captureStartCycles);
+
+	capturedScopes.ValueSort([](const FCapturedScope& a, const FCapturedScope& b) { return a.cycles > b.cycles; });
+
+	double gameplayMs = 0.0;
+	UE_LOG(LogTemp, Log, TEXT("Llama.DumpFrame frame %llu, %.3f ms"), (uint64)GFrameCounter, frameMs);
+	for (const auto& scope : capturedScopes)
+	{
+		const double scopeMs = FPlatformTime::ToMilliseconds64(scope.Value.cycles);
+		gameplayMs += scopeMs;
+		UE_LOG(LogTemp, Log, TEXT("  %-40s %4d calls %8.3f ms %5.1f%%"), scope.Key, scope.Value.calls, scopeMs, frameMs > 0.0 ? scopeMs * 100.0 / frameMs : 0.0);
+	}
+	UE_LOG(LogTemp, Log, TEXT("  %-40s            %8.3f ms %5.1f%%"), TEXT("gameplay total (nested scopes count twice)"), gameplayMs, frameMs > 0.0 ? gameplayMs * 100.0 / frameMs : 0.0);
+
+	capturedCounts.KeySort([](const TCHAR* a, const TCHAR* b) { return FCString::Strcmp(a, b) < 0; });
+	for (const auto& counter : capturedCounts)
+	{
+		UE_LOG(LogTemp, Log, TEXT("  %-40s %d"), counter.Key, counter.Value);
+	}
+}
+
+static FAutoConsoleCommand DumpFrameCommand(
+	TEXT("Llama.DumpFrame"),
+	TEXT("Logs the time of every gameplay scope and the gameplay counters for the next frame"),
+	FConsoleCommandDelegate::CreateStatic(&FLlamaFrameCapture::Request));
@@ -3,3 +3,80 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+
+/** Object channel of the push hands, only llama capsules overlap it */
+#define ECC_Push ECC_GameTraceChannel1
+
+DECLARE_STATS_GROUP(TEXT("Llama"), STATGROUP_Llama, STATCAT_Advanced);
+
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Awake items"), STAT_LlamaAwakeItems, STATGROUP_Llama, LLAMALLAMA_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Dormant items"), STAT_LlamaDormantItems, STATGROUP_Llama, LLAMALLAMA_API);
+
+CSV_DECLARE_CATEGORY_MODULE_EXTERN(LLAMALLAMA_API, Llama);
+
+/**
+ * One frame breakdown of the gameplay scopes and counters, requested with Llama.DumpFrame.
+ * Recording is a bool check until a dump is requested.
+ */
+class LLAMALLAMA_API FLlamaFrameCapture
+{
+public:
+	static bool IsCapturing() { return bCapturing; }
+
+	static void AddTime(const TCHAR* scope, uint64 cycles);
+	static void AddCount(const TCHAR* counter, int32 count);
+	static void SetCount(const TCHAR* counter, int32 count);
+
+	/** Captures the next frame and logs it when it ends */
+	static void Request();
+
+private:
+	static void OnBeginFrame();
+	static void OnEndFrame();
+
+	static bool bCapturing;
+	static bool bRequested;
+};
+
+/** Times the enclosing scope into the frame capture */
+struct FLlamaScopeTimer
+{
+	explicit FLlamaScopeTimer(const TCHAR* inScope)
+		: scope(FLlamaFrameCapture::IsCapturing() ? inScope : nullptr)
+		, startCycles(scope ? FPlatformTime::Cycles64() : 0)
+	{
+	}
+
+	~FLlamaScopeTimer()
+	{
+		if (scope)
+		{
+			FLlamaFrameCapture::AddTime(scope, FPlatformTime::Cycles64() - startCycles);
+		}
+	}
+
+	const TCHAR* scope;
+	uint64 startCycles;
+};
+
+/** Cycle stat for stat Llama and the profiler, plus the Llama.DumpFrame breakdown */
+#define LLAMA_SCOPE_CYCLE_COUNTER(Stat) \
+	SCOPE_CYCLE_COUNTER(Stat); \
+	FLlamaScopeTimer ANONYMOUS_VARIABLE(LlamaScopeTimer)(TEXT(#Stat))
+
+/** Adds to a per frame Llama CSV counter */
+#define LLAMA_COUNT(Name, Value) \
+	do \
+	{ \
+		CSV_CUSTOM_STAT(Llama, Name, Value, ECsvCustomStatOp::Accumulate); \
+		if (FLlamaFrameCapture::IsCapturing()) { FLlamaFrameCapture::AddCount(TEXT(#Name), Value); } \
+	} while (0)
+
+/** Sets a per frame Llama CSV counter */
+#define LLAMA_SET_COUNT(Name, Value) \
+	do \
+	{ \
+		CSV_CUSTOM_STAT(Llama, Name, Value, ECsvCustomStatOp::Set); \
+		if (FLlamaFrameCapture::IsCapturing()) { FLlamaFrameCapture::SetCount(TEXT(#Name), Value); } \
+	} while (0)
@@ -1,34 +1,86 @@
 // Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
 
 #include "LlamaLlamaCharacter.h"
+#if !UE_SERVER
 #include "HeadMountedDisplayFunctionLibrary.h"
+#endif
 #include "Camera/CameraComponent.h"
 #include "Components/CapsuleComponent.h"
 #include "Components/InputComponent.h"
 #include "GameFramework/CharacterMovementComponent.h"
 #include "GameFramework/Controller.h"
 #include "GameFramework/SpringArmComponent.h"
+#include "GameFramework/PlayerState.h"
+#include "GameFramework/GameStateBase.h"
+#include "Animation/AnimInstance.h"
 
 #include "Net/UnrealNetwork.h"
 
 #include "Public/BaseItem.h"
+#include "Public/ItemGridSubsystem.h"
+#include "Public/LlamaCharacterMovementComponent.h"
+#include "Public/LoadTestSubsystem.h"
+#include "Public/EventJournal.h"
+#include "Public/LlamaSocketTrack.h"
+#include "Public/TimerWheelSubsystem.h"
+#include "Public/LlamaLlamaGameState.h"
+#include "Public/AnimNotifyState_PushWindow.h"
+#include "LlamaLlama.h"
 #include "Components/SphereComponent.h"
-#include "TimerManager.h"
 
 #include "Engine.h"
 
+DECLARE_CYCLE_STAT(TEXT("PickUp"), STAT_LlamaPickUp, STATGROUP_Llama);
+DECLARE_CYCLE_STAT(TEXT("OnItemChanged"), STAT_LlamaOnItemChanged, STATGROUP_Llama);
+DECLARE_CYCLE_STAT(TEXT("ResolvePushHits"), STAT_LlamaResolvePushHits, STATGROUP_Llama);
+DECLARE_CYCLE_STAT(TEXT("StunLlama"), STAT_LlamaStunLlama, STATGROUP_Llama);
+DECLARE_CYCLE_STAT(TEXT("TossItem"), STAT_LlamaTossItem, STATGROUP_Llama);
+DECLARE_CYCLE_STAT(TEXT("PlayReplicatedMontage"), STAT_LlamaPlayReplicatedMontage, STATGROUP_Llama);
+DECLARE_CYCLE_STAT(TEXT("OnRep_montageState"), STAT_LlamaOnRepMontageState, STATGROUP_Llama);
+DECLARE_CYCLE_STAT(TEXT("UpdateServerAnimation"), STAT_LlamaUpdateServerAnimation, STATGROUP_Llama);
+
+static TAutoConsoleVariable<int32> CVarServerFullPose(
+	TEXT("Llama.ServerFullPose"),
+	0,
+	TEXT("1 evaluates the full anim graph for every llama on a dedicated server, for debugging.\n")
+	TEXT("0 only ticks montages and poses the push and carry sockets from baked tracks."));
+
+namespace
+{
+	//order matches the samples in the baked tracks
+	const TArray<FName>& GetServerSockets()
+	{
+		static const TArray<FName> sockets = { "push_socket_L", "push_socket_R", "item_socket_R" };
+		return sockets;
+	}
+}
+
 //////////////////////////////////////////////////////////////////////////
 // ALlamaLlamaCharacter
 
-ALlamaLlamaCharacter::ALlamaLlamaCharacter()
+ALlamaLlamaCharacter::ALlamaLlamaCharacter(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer.SetDefaultSubobjectClass<ULlamaCharacterMovementComponent>(ACharacter::CharacterMovementComponentName))
 {
 	// Set size for collision capsule
 	GetCapsuleComponent()->InitCapsuleSize(42.f, 96.0f);
+	GetCapsuleComponent()->SetCollisionResponseToChannel(ECC_Push, ECollisionResponse::ECR_Overlap);
 
 	// set our turn rates for input
 	BaseTurnRate = 45.f;
 	BaseLookUpRate = 45.f;
 
+	pickUpRadius = 150.f;
+	predictedItem = nullptr;
+	maxPushRewind = 0.4f;
+	pushMontage = nullptr;
+	pushWindowFallbackDuration = 0.3f;
+	bPushWindowOpen = false;
+	bStunned = false;
+	stunDuration = 2.5f;
+	stunEndTime = 0.f;
+	bPushing = false;
+	pushEndTime = 0.f;
+
 	// Don't rotate when the controller rotates. Let that just affect the camera.
 	bUseControllerRotationPitch = false;
 	bUseControllerRotationYaw = false;
@@ -53,29 +105,69 @@ ALlamaLlamaCharacter::ALlamaLlamaCharacter()
 
 	leftHandPushSphere = CreateDefaultSubobject<USphereComponent>(TEXT("Left Hand Sphere"));
 	leftHandPushSphere->SetSphereRadius(5.f);
-	leftHandPushSphere->SetGenerateOverlapEvents(true);
-	leftHandPushSphere->SetCollisionResponseToAllChannels(ECollisionResponse::ECR_Overlap);
+	leftHandPushSphere->SetGenerateOverlapEvents(false);
+	leftHandPushSphere->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	leftHandPushSphere->SetCollisionObjectType(ECC_Push);
+	leftHandPushSphere->SetCollisionResponseToAllChannels(ECollisionResponse::ECR_Ignore);
 	leftHandPushSphere->AttachToComponent(GetMesh(), FAttachmentTransformRules::SnapToTargetNotIncludingScale, "push_socket_L");
 
 	rightHandPushSphere = CreateDefaultSubobject<USphereComponent>(TEXT("Right Hand Sphere"));
 	rightHandPushSphere->SetSphereRadius(5.f);
-	rightHandPushSphere->SetGenerateOverlapEvents(true);
-	rightHandPushSphere->SetCollisionResponseToAllChannels(ECollisionResponse::ECR_Overlap);
+	rightHandPushSphere->SetGenerateOverlapEvents(false);
+	rightHandPushSphere->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	rightHandPushSphere->SetCollisionObjectType(ECC_Push);
+	rightHandPushSphere->SetCollisionResponseToAllChannels(ECollisionResponse::ECR_Ignore);
 	rightHandPushSphere->AttachToComponent(GetMesh(), FAttachmentTransformRules::SnapToTargetNotIncludingScale, "push_socket_R");
 
 	// Note: The skeletal mesh and anim blueprint references on the Mesh component (inherited from Character) 
 	// are set in the derived blueprint asset named MyCharacter (to avoid direct content references in C++)
 }
 
+void ALlamaLlamaCharacter::PostInitializeComponents()
+{
+	Super::PostInitializeComponents();
+
+	//before the initial replication so OnRep_montageState can resolve the index, same order on every machine
+	for (UAnimMontage* montage : { pickUpMontage, tossMontage, pushMontage })
+	{
+		if (montage)
+		{
+			montageTable.AddUnique(montage);
+		}
+	}
+}
+
 void ALlamaLlamaCharacter::BeginPlay()
 {
 	Super::BeginPlay();
 
-	leftHandPushSphere->OnComponentBeginOverlap.AddDynamic(this, &ALlamaLlamaCharacter::OnHandPushHit);
-	rightHandPushSphere->OnComponentBeginOverlap.AddDynamic(this, &ALlamaLlamaCharacter::OnHandPushHit);
 	//GetCapsuleComponent()->OnComponentBeginOverlap.AddDynamic(this, &ALlamasAndRobotsCharacter::OnOverlapBegin);
 }
 
+void ALlamaLlamaCharacter::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	//disconnects and respawns, the whole world going away takes the items with it
+	if (EndPlayReason == EEndPlayReason::Destroyed || EndPlayReason == EEndPlayReason::RemovedFromWorld)
+	{
+		if (item)
+		{
+			ReleaseItem(item);
+		}
+		predictedItem = nullptr;
+
+		//releasing takes the held item's entry out, this catches one that didn't match item on the server
+		if (Role == ROLE_Authority)
+		{
+			if (ALlamaLlamaGameState* gameState = GetWorld()->GetGameState<ALlamaLlamaGameState>())
+			{
+				gameState->RemoveLlama(this);
+			}
+		}
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
 //////////////////////////////////////////////////////////////////////////
 // Input
 
@@ -97,12 +189,14 @@ void ALlamaLlamaCharacter::SetupPlayerInputComponent(class UInputComponent* Play
 	PlayerInputComponent->BindAxis("LookUp", this, &APawn::AddControllerPitchInput);
 	PlayerInputComponent->BindAxis("LookUpRate", this, &ALlamaLlamaCharacter::LookUpAtRate);
 
+#if !UE_SERVER
 	// handle touch devices
 	PlayerInputComponent->BindTouch(IE_Pressed, this, &ALlamaLlamaCharacter::TouchStarted);
 	PlayerInputComponent->BindTouch(IE_Released, this, &ALlamaLlamaCharacter::TouchStopped);
 
 	// VR headset functionality
 	PlayerInputComponent->BindAction("ResetVR", IE_Pressed, this, &ALlamaLlamaCharacter::OnResetVR);
+#endif
 
 	PlayerInputComponent->BindAction("PickUp", IE_Pressed, this, &ALlamaLlamaCharacter::PickUp);
 	PlayerInputComponent->BindAction("PrimaryAction", IE_Pressed, this, &ALlamaLlamaCharacter::PrimaryAction);
@@ -110,6 +204,7 @@ void ALlamaLlamaCharacter::SetupPlayerInputComponent(class UInputComponent* Play
 
 }
 
+#if !UE_SERVER
 void ALlamaLlamaCharacter::OnResetVR()
 {
 	UHeadMountedDisplayFunctionLibrary::ResetOrientationAndPosition();
@@ -124,21 +219,142 @@ void ALlamaLlamaCharacter::TouchStopped(ETouchIndex::Type FingerIndex, FVector L
 {
 	StopJumping();
 }
+#endif
+
+void ALlamaLlamaCharacter::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	if (IsRunningDedicatedServer())
+	{
+		UpdateServerAnimation();
+	}
+
+	if (Role == ROLE_Authority)
+	{
+		FLlamaPoseSnapshot snapshot;
+		snapshot.serverTime = GetWorld()->GetTimeSeconds();
+		snapshot.capsuleLocation = GetCapsuleComponent()->GetComponentLocation();
+		snapshot.leftHand = leftHandPushSphere->GetComponentLocation();
+		snapshot.rightHand = rightHandPushSphere->GetComponentLocation();
+
+		FLlamaPoseSnapshot previousPose;
+		if (bPushWindowOpen && poseHistory.Sample(snapshot.serverTime, previousPose))
+		{
+			ResolvePushHits(previousPose);
+		}
+
+		poseHistory.Record(snapshot);
+	}
+}
+
+void ALlamaLlamaCharacter::UpdateServerAnimation()
+{
+	LLAMA_SCOPE_CYCLE_COUNTER(STAT_LlamaUpdateServerAnimation);
+
+	USkeletalMeshComponent* mesh = GetMesh();
+
+	const bool bFullPose = CVarServerFullPose.GetValueOnGameThread() != 0;
+	if (bFullPose != bServerFullPose)
+	{
+		bServerFullPose = bFullPose;
+		mesh->VisibilityBasedAnimTickOption = bFullPose ? EVisibilityBasedAnimTickOption::AlwaysTickPoseAndRefreshBones : EVisibilityBasedAnimTickOption::OnlyTickMontagesWhenNotRendered;
+	}
+
+	//a tossed item is still ours until the toss finishes, leave it alone once it's off the socket
+	ABaseItem* carriedItem = (item && item->GetAttachParentActor() == this) ? item : nullptr;
+
+	//between montages, and when switching to the full pose, the attachments go back on the sockets.
+	//without the full pose the bone transforms never refresh, so those are the ref pose sockets
+	UAnimInstance* animInstance = mesh->GetAnimInstance();
+	UAnimMontage* montage = GetCurrentMontage();
+	TSharedPtr<const FLlamaSocketTrack> track = (!bServerFullPose && animInstance && montage) ? FLlamaSocketTrack::FindOrBake(montage, mesh->SkeletalMesh, GetServerSockets()) : nullptr;
+	if (!track.IsValid())
+	{
+		leftHandPushSphere->SetRelativeLocation(FVector::ZeroVector);
+		rightHandPushSphere->SetRelativeLocation(FVector::ZeroVector);
+		if (carriedItem)
+		{
+			carriedItem->GetRootComponent()->SetRelativeLocation(FVector::ZeroVector);
+		}
+		return;
+	}
+
+	const float position = animInstance->Montage_GetPosition(montage);
+	const FTransform& meshTransform = mesh->GetComponentTransform();
+	leftHandPushSphere->SetWorldLocation(meshTransform.TransformPosition(track->Sample(0, position)));
+	rightHandPushSphere->SetWorldLocation(meshTransform.TransformPosition(track->Sample(1, position)));
+	if (carriedItem)
+	{
+		carriedItem->SetActorLocation(meshTransform.TransformPosition(track->Sample(2, position)));
+	}
+}
 
-void ALlamaLlamaCharacter::OnHandPushHit(UPrimitiveComponent* OverlappedComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult)
+void ALlamaLlamaCharacter::ResolvePushHits(const FLlamaPoseSnapshot& previousPose)
 {
-	if (OtherActor != this)
+	LLAMA_SCOPE_CYCLE_COUNTER(STAT_LlamaResolvePushHits);
+
+	//a client sees the other llamas about a round trip behind the server
+	float rewind = 0.f;
+	if (!IsLocallyControlled() && PlayerState)
+	{
+		rewind = FLlamaPoseHistory::GetPushRewind(PlayerState->ExactPing * 0.001f, maxPushRewind);
+	}
+	const float rewindTime = GetWorld()->GetTimeSeconds() - rewind;
+
+	FLlamaPoseSnapshot currentPose;
+	currentPose.leftHand = leftHandPushSphere->GetComponentLocation();
+	currentPose.rightHand = rightHandPushSphere->GetComponentLocation();
+	const float handRadius = FMath::Max(leftHandPushSphere->GetScaledSphereRadius(), rightHandPushSphere->GetScaledSphereRadius());
+
+	//broadphase on the push channel, grown by how far a llama can have moved since the pose we rewind to
+	const float rewindMargin = GetCharacterMovement()->MaxWalkSpeed * rewind;
+	const FCollisionShape sweepShape = FCollisionShape::MakeSphere(handRadius + rewindMargin);
+	FCollisionQueryParams queryParams(SCENE_QUERY_STAT(LlamaPush), false, this);
+
+	TArray<FHitResult> hits;
+	GetWorld()->SweepMultiByChannel(hits, previousPose.leftHand, currentPose.leftHand, FQuat::Identity, ECC_Push, sweepShape, queryParams);
+
+	TArray<FHitResult> rightHits;
+	GetWorld()->SweepMultiByChannel(rightHits, previousPose.rightHand, currentPose.rightHand, FQuat::Identity, ECC_Push, sweepShape, queryParams);
+	hits.Append(rightHits);
+
+	for (const FHitResult& hit : hits)
 	{
-		if (ALlamaLlamaCharacter * llama = Cast<ALlamaLlamaCharacter>(OtherActor))
+		ALlamaLlamaCharacter* otherLlama = Cast<ALlamaLlamaCharacter>(hit.GetActor());
+		if (otherLlama == nullptr || otherLlama == this || pushVictims.Contains(otherLlama))
+			continue;
+
+		const float capsuleRadius = otherLlama->GetCapsuleComponent()->GetScaledCapsuleRadius();
+		const float capsuleHalfHeight = otherLlama->GetCapsuleComponent()->GetScaledCapsuleHalfHeight();
+
+		FVector rewoundLocation;
+		if (otherLlama->poseHistory.TestPushHit(previousPose, currentPose, handRadius, rewindTime, capsuleRadius, capsuleHalfHeight, rewoundLocation))
 		{
-			//llama->bStunned = true;
-			StunOtherLlama(llama);
-			//TODO add a stun function with a server_ function to set the value so it gets replicated to all 
-			GEngine->AddOnScreenDebugMessage(0, 1.0f, FColor::White, "should stun the other llama");
+			pushVictims.Add(otherLlama);
+			FLlamaEventJournal::Record(GetWorld(), ELlamaJournalEvent::PushHit, this, otherLlama, rewoundLocation);
+			StunOtherLlama(otherLlama);
 		}
 	}
 }
 
+void ALlamaLlamaCharacter::BeginPushWindow()
+{
+	if (Role == ROLE_Authority)
+	{
+		bPushWindowOpen = true;
+		pushVictims.Reset();
+	}
+}
+
+void ALlamaLlamaCharacter::EndPushWindow()
+{
+	if (Role == ROLE_Authority)
+	{
+		bPushWindowOpen = false;
+	}
+}
+
 void ALlamaLlamaCharacter::TurnAtRate(float Rate)
 {
 	// calculate delta for this frame from the rate information
@@ -180,224 +396,504 @@ void ALlamaLlamaCharacter::MoveRight(float Value)
 	}
 }
 
-void ALlamaLlamaCharacter::Multicast_PlayMontage_Implementation(UAnimMontage* montage)
+void ALlamaLlamaCharacter::PlayReplicatedMontage(UAnimMontage* montage, float playRate)
 {
-	if (montage)
-		PlayAnimMontage(montage, 1.f, "Spine");
-}
+	LLAMA_SCOPE_CYCLE_COUNTER(STAT_LlamaPlayReplicatedMontage);
 
-bool ALlamaLlamaCharacter::Server_StunLlama_Validate()
-{
-	return true;
+	if (Role < ROLE_Authority || montage == nullptr)
+		return;
+
+	const int32 index = montageTable.Find(montage);
+	if (!ensureMsgf(index != INDEX_NONE && index < FLlamaMontageState::NoMontage, TEXT("%s is not in %s's montage table"), *montage->GetName(), *GetName()))
+		return;
+
+	AGameStateBase* gameState = GetWorld()->GetGameState();
+
+	montageState.montageIndex = (uint8)index;
+	montageState.playCount++;
+	montageState.startServerTime = gameState ? gameState->GetServerWorldTimeSeconds() : GetWorld()->GetTimeSeconds();
+	montageState.playRate = playRate;
+
+	PlayAnimMontage(montage, playRate, "Spine");
 }
 
-void ALlamaLlamaCharacter::Server_StunLlama_Implementation()
+void ALlamaLlamaCharacter::OnRep_montageState()
 {
-	StunLlama();
+	LLAMA_SCOPE_CYCLE_COUNTER(STAT_LlamaOnRepMontageState);
+
+	if (!montageTable.IsValidIndex(montageState.montageIndex))
+		return;
+
+	UAnimMontage* montage = montageTable[montageState.montageIndex];
+	if (montage == nullptr)
+		return;
+
+	//the owning client already played it when it predicted the action
+	if (IsLocallyControlled() && GetCurrentMontage() == montage)
+		return;
+
+	AGameStateBase* gameState = GetWorld()->GetGameState();
+	const float elapsed = gameState ? (gameState->GetServerWorldTimeSeconds() - montageState.startServerTime) * montageState.playRate : 0.f;
+
+	//became relevant after it already finished
+	if (elapsed >= montage->GetPlayLength())
+		return;
+
+	PlayAnimMontage(montage, montageState.playRate, "Spine");
+
+	UAnimInstance* animInstance = GetMesh()->GetAnimInstance();
+	if (animInstance && elapsed > 0.f)
+	{
+		animInstance->Montage_SetPosition(montage, animInstance->Montage_GetPosition(montage) + elapsed);
+	}
 }
 
 void ALlamaLlamaCharacter::StunLlama()
 {
-	if (Role < ROLE_Authority)
-	{
-		Server_StunLlama();
-	}
-	else if (Role == ROLE_Authority)
+	LLAMA_SCOPE_CYCLE_COUNTER(STAT_LlamaStunLlama);
+
+	if (Role == ROLE_Authority)
 	{
-		bStunned = true;
+		LLAMA_COUNT(Stuns, 1);
+		FLlamaEventJournal::Record(GetWorld(), ELlamaJournalEvent::Stun, this, item, GetActorLocation());
 		if (item)
 		{
-			item->meshComp->SetSimulatePhysics(true);
-			item->carrier = nullptr;
-			item = nullptr;
+			if (UTimerWheelSubsystem* timers = UTimerWheelSubsystem::Get(this))
+			{
+				timers->ClearTimer(tossTimer);
+			}
+			ReleaseItem(item);
 		}
+
+		//a stun on a stunned llama starts over
+		AGameStateBase* gameState = GetWorld()->GetGameState();
+		bStunned = true;
+		stunEndTime = (gameState ? gameState->GetServerWorldTimeSeconds() : GetWorld()->GetTimeSeconds()) + stunDuration;
+		ScheduleEffectEnd(stunEndTime, stunTimer, &ALlamaLlamaCharacter::EndStun);
+		UpdateMoveState();
 	}
 }
 
-bool ALlamaLlamaCharacter::Server_StunOtherLlama_Validate(ALlamaLlamaCharacter* otherLlama)
+void ALlamaLlamaCharacter::OnRep_stunEndTime()
 {
-	return true;
+	bStunned = true;
+	ScheduleEffectEnd(stunEndTime, stunTimer, &ALlamaLlamaCharacter::EndStun);
+	UpdateMoveState();
 }
 
-void ALlamaLlamaCharacter::Server_StunOtherLlama_Implementation(ALlamaLlamaCharacter* otherLlama)
+void ALlamaLlamaCharacter::EndStun()
 {
-	StunOtherLlama(otherLlama);
+	bStunned = false;
+	UpdateMoveState();
 }
 
-void ALlamaLlamaCharacter::StunOtherLlama(ALlamaLlamaCharacter* otherLlama)
+void ALlamaLlamaCharacter::ScheduleEffectEnd(float endTime, FLlamaTimerHandle& timer, void (ALlamaLlamaCharacter::*onEnd)())
 {
-	if (Role < ROLE_Authority)
+	UTimerWheelSubsystem* timers = UTimerWheelSubsystem::Get(this);
+	if (timers == nullptr)
+		return;
+
+	timers->ClearTimer(timer);
+	if (endTime > timers->GetServerTime())
 	{
-		Server_StunOtherLlama(otherLlama);
+		timer = timers->SetTimerAt(endTime, FSimpleDelegate::CreateUObject(this, onEnd));
 	}
-	else if (Role == ROLE_Authority)
+	else
 	{
-		//bStunned = true;
-		if (bPushing)
-		{
-			//otherLlama->bStunned = true;
-			otherLlama->StunLlama();
-		}
+		(this->*onEnd)();
 	}
 }
 
-void ALlamaLlamaCharacter::TossItem()
+void ALlamaLlamaCharacter::ClearEffectTimers()
 {
-	item->meshComp->SetSimulatePhysics(true);
-	item->meshComp->AddImpulse(GetActorForwardVector() * 300);
-	item->carrier = nullptr;
-	item = nullptr;
+	if (UTimerWheelSubsystem* timers = UTimerWheelSubsystem::Get(this))
+	{
+		timers->ClearTimer(tossTimer);
+		timers->ClearTimer(stunTimer);
+		timers->ClearTimer(pushTimer);
+		timers->ClearTimer(pushWindowTimer);
+	}
 }
 
-bool ALlamaLlamaCharacter::Server_OnPickUp_Validate()
+void ALlamaLlamaCharacter::StunOtherLlama(ALlamaLlamaCharacter* otherLlama)
 {
-	return true;
+	if (Role == ROLE_Authority)
+	{
+		if (bPushing)
+		{
+			otherLlama->StunLlama();
+		}
+	}
 }
 
-void ALlamaLlamaCharacter::Server_OnPickUp_Implementation()
+void ALlamaLlamaCharacter::TossItem()
 {
-	PickUp();
+	LLAMA_SCOPE_CYCLE_COUNTER(STAT_LlamaTossItem);
+
+	if (ABaseItem* tossed = item)
+	{
+		//same speed the old 300 impulse gave, sent once as a launch instead of streaming the whole flight
+		const float mass = tossed->meshComp->GetMass();
+		tossed->Launch(GetActorForwardVector() * 300.f / FMath::Max(mass, KINDA_SMALL_NUMBER), this);
+		OnItemRemoved(tossed);
+	}
 }
 
 void ALlamaLlamaCharacter::PickUp()
 {
-	TArray<AActor*> actors;
-	GetOverlappingActors(actors);
+	LLAMA_SCOPE_CYCLE_COUNTER(STAT_LlamaPickUp);
 
 	if (this->item == nullptr)
 	{
-		//ABaseItem* closestItem;
-		for (auto& actor : actors)
+		UItemGridSubsystem* grid = UItemGridSubsystem::Get(this);
+		ABaseItem* closestItem = grid ? grid->FindNearestFreeItem(GetActorLocation(), pickUpRadius) : nullptr;
+
+		if (Role < ROLE_Authority)
 		{
-			//if cast, it's an item you can pickup
-			if (ABaseItem * overlappingItem = Cast<ABaseItem>(actor))
+			//attach right away, the server runs the same query on this move and confirms through replication
+			if (closestItem)
 			{
-				//FVector
-
-				if (overlappingItem->carrier == nullptr)
-				{
-					if (Role < ROLE_Authority)
-					{
-						Server_OnPickUp();
-					}
-					else
-					{
-						this->item = overlappingItem;
-						this->item->OnPickUp(this);
-						OnRep_item();
-						if (pickUpMontage)
-						{
-							PlayAnimMontage(pickUpMontage, 1.f, "Spine");
-							Multicast_PlayMontage(pickUpMontage);
-						}
-						break;
-					}
-				}
+				predictedItem = closestItem;
+				PickUpItem(closestItem);
+				GetLlamaMovement()->QueueAction(ELlamaMoveAction::PickUp);
 			}
 		}
+		else if (closestItem)
+		{
+			PickUpItem(closestItem);
+		}
+		else if (!IsLocallyControlled())
+		{
+			//the client only sends a pick up when it predicted one
+			LLAMA_COUNT_RPC(Sent_Client_RejectPickUp);
+			Client_RejectPickUp();
+		}
 	}
 	else if (item)
 	{
 		if (Role < ROLE_Authority)
 		{
-			Server_OnPickUp();
-		}
-		else
-		{
-			//drop item
-			float t = tossMontage->CalculateSequenceLength() - 0.1f;
 			if (tossMontage)
 			{
 				PlayAnimMontage(tossMontage, 1.f, "Spine");
-				Multicast_PlayMontage(tossMontage);
 			}
-			FTimerHandle UnusedHandle;
-			GetWorldTimerManager().SetTimer(UnusedHandle, this, &ALlamaLlamaCharacter::TossItem, 0.3f, false);
+			predictedItem = nullptr;
+			bTossPending = true;
+			UpdateMoveState();
+			GetLlamaMovement()->QueueAction(ELlamaMoveAction::PickUp);
+		}
+		else
+		{
+			StartToss();
 		}
 	}
 }
 
-void ALlamaLlamaCharacter::OnRep_item()
+void ALlamaLlamaCharacter::Client_RejectPickUp_Implementation()
 {
-	if (item)
+	LLAMA_COUNT_RPC(Received_Client_RejectPickUp);
+	RollBackPickUp();
+}
+
+void ALlamaLlamaCharacter::RollBackPickUp()
+{
+	ABaseItem* target = predictedItem;
+	predictedItem = nullptr;
+
+	if (target == nullptr)
+		return;
+
+	//only undo our own prediction, if the inventory already gave it to another llama leave it be
+	ReleaseItem(target);
+
+	if (item == nullptr && pickUpMontage)
 	{
-		//there is an item being held
-		//add move ignore 
-		MoveIgnoreActorAdd(item);
-		GetCharacterMovement()->MaxWalkSpeed = 500;
+		StopAnimMontage(pickUpMontage);
 	}
-	else
+}
+
+void ALlamaLlamaCharacter::OnItemRemoved(ABaseItem* removed)
+{
+	if (removed == nullptr || item != removed)
+		return;
+
+	item = nullptr;
+	MoveIgnoreActorRemove(removed);
+	OnItemChanged();
+}
+
+void ALlamaLlamaCharacter::OnItemAdded(ABaseItem* added)
+{
+	//the server went with a different item than the one we predicted
+	if (predictedItem && predictedItem != added)
+	{
+		RollBackPickUp();
+	}
+
+	if (item == added)
+	{
+		//the server confirmed the pick up we predicted
+		if (predictedItem == added)
+		{
+			predictedItem = nullptr;
+		}
+		return;
+	}
+
+	//one hand
+	if (item)
 	{
-		//the item is null
-		//remove all move ignore
-		ClearComponentOverlaps();
-		GetCapsuleComponent()->ClearMoveIgnoreActors();
-		GetCharacterMovement()->MaxWalkSpeed = 600;
+		ReleaseItem(item);
 	}
+
+	item = added;
+	MoveIgnoreActorAdd(added);
+	OnItemChanged();
 }
 
-bool ALlamaLlamaCharacter::Server_PrimaryAction_Validate()
+void ALlamaLlamaCharacter::CarryItem(ABaseItem* carried)
 {
-	return true;
+	if (carried == nullptr)
+		return;
+
+	//another llama still has it on this machine, the inventory's removal for it hasn't arrived yet
+	if (carried->carrier && carried->carrier != this)
+	{
+		carried->carrier->ReleaseItem(carried);
+	}
+
+	if (carried->carrier != this)
+	{
+		carried->OnPickUp(this);
+	}
+
+	OnItemAdded(carried);
 }
 
-void ALlamaLlamaCharacter::Server_PrimaryAction_Implementation()
+void ALlamaLlamaCharacter::ReleaseItem(ABaseItem* released)
 {
-	PrimaryAction();
+	if (released == nullptr)
+		return;
+
+	const bool bOnOurHand = released->carrier == this;
+	OnItemRemoved(released);
+
+	if (bOnOurHand)
+	{
+		released->Drop();
+	}
 }
 
-void ALlamaLlamaCharacter::PrimaryAction()
+void ALlamaLlamaCharacter::ResetForRound(const FTransform& startTransform)
 {
 	if (Role < ROLE_Authority)
+		return;
+
+	//a pending toss, stun or push would run out in the new round
+	ClearEffectTimers();
+
+	if (item)
 	{
-		Server_PrimaryAction();
-		if (item)
-		{
+		ReleaseItem(item);
+	}
+	predictedItem = nullptr;
+
+	bStunned = false;
+	stunEndTime = 0.f;
+	bPushing = false;
+	pushEndTime = 0.f;
+	bPushWindowOpen = false;
+	pushVictims.Reset();
+	poseHistory.Reset();
+	UpdateMoveState();
+
+	StopAnimMontage();
+
+	GetCharacterMovement()->StopMovementImmediately();
+	SetActorLocationAndRotation(startTransform.GetLocation(), startTransform.GetRotation(), false, nullptr, ETeleportType::TeleportPhysics);
+}
+
+void ALlamaLlamaCharacter::PickUpItem(ABaseItem* target)
+{
+	CarryItem(target);
+
+	if (Role == ROLE_Authority)
+	{
+		FLlamaEventJournal::Record(GetWorld(), ELlamaJournalEvent::PickUp, this, target, GetActorLocation());
+	}
 
+	if (pickUpMontage)
+	{
+		if (Role == ROLE_Authority)
+		{
+			PlayReplicatedMontage(pickUpMontage);
 		}
 		else
 		{
-			//bPushing = true;
+			PlayAnimMontage(pickUpMontage, 1.f, "Spine");
 		}
 	}
+}
+
+void ALlamaLlamaCharacter::StartToss()
+{
+	if (Role == ROLE_Authority)
+	{
+		FLlamaEventJournal::Record(GetWorld(), ELlamaJournalEvent::Toss, this, item, GetActorLocation());
+	}
+
+	if (tossMontage)
+	{
+		PlayReplicatedMontage(tossMontage);
+	}
+	bTossPending = true;
+	UpdateMoveState();
+
+	if (UTimerWheelSubsystem* timers = UTimerWheelSubsystem::Get(this))
+	{
+		timers->ClearTimer(tossTimer);
+		tossTimer = timers->SetTimer(0.3f, FSimpleDelegate::CreateUObject(this, &ALlamaLlamaCharacter::TossItem));
+	}
+}
+
+void ALlamaLlamaCharacter::HandleMoveActions(uint8 actions)
+{
+	if (actions & ELlamaMoveAction::PickUp)
+	{
+		PickUp();
+	}
+	if (actions & ELlamaMoveAction::PrimaryAction)
+	{
+		PrimaryAction();
+	}
+	if (actions & ELlamaMoveAction::SecondaryAction)
+	{
+		SecondaryAction();
+	}
+}
+
+ULlamaCharacterMovementComponent* ALlamaLlamaCharacter::GetLlamaMovement() const
+{
+	return CastChecked<ULlamaCharacterMovementComponent>(GetCharacterMovement());
+}
+
+void ALlamaLlamaCharacter::OnItemChanged()
+{
+	LLAMA_SCOPE_CYCLE_COUNTER(STAT_LlamaOnItemChanged);
+
+	if (item == nullptr)
+	{
+		bTossPending = false;
+	}
+
+	if (ULlamaCharacterMovementComponent::IsMoveStatePredicted())
+	{
+		UpdateMoveState();
+	}
+	else
+	{
+		GetCharacterMovement()->MaxWalkSpeed = item ? 500 : 600;
+	}
+}
+
+void ALlamaLlamaCharacter::UpdateMoveState()
+{
+	uint8 state = 0;
+	if (item && !bTossPending)
+		state |= ELlamaMoveState::Carrying;
+	if (bStunned)
+		state |= ELlamaMoveState::Stunned;
+	if (bPushing)
+		state |= ELlamaMoveState::Pushing;
+
+	GetLlamaMovement()->SetMoveState(state);
+}
+
+void ALlamaLlamaCharacter::PrimaryAction()
+{
+	if (Role < ROLE_Authority)
+	{
+		//the server starts a push on this same move, unless it already has us pushing, carrying or stunned
+		if (item == nullptr && !bPushing && !bStunned)
+		{
+			AGameStateBase* gameState = GetWorld()->GetGameState();
+			bPushing = true;
+			pushEndTime = (gameState ? gameState->GetServerWorldTimeSeconds() : GetWorld()->GetTimeSeconds()) + GetPushDuration();
+			ScheduleEffectEnd(pushEndTime, pushTimer, &ALlamaLlamaCharacter::EndPush);
+			UpdateMoveState();
+		}
+		GetLlamaMovement()->QueueAction(ELlamaMoveAction::PrimaryAction);
+	}
 	else
 	{
 		if (item)
 		{
-			item->OnPrimaryAction();
+			item->PrimaryAction();
 		}
-		else
+		else if (!bPushing && !bStunned)
 		{
+			FLlamaEventJournal::Record(GetWorld(), ELlamaJournalEvent::Push, this, nullptr, GetActorLocation());
+			AGameStateBase* gameState = GetWorld()->GetGameState();
 			bPushing = true;
+			pushEndTime = (gameState ? gameState->GetServerWorldTimeSeconds() : GetWorld()->GetTimeSeconds()) + GetPushDuration();
+			ScheduleEffectEnd(pushEndTime, pushTimer, &ALlamaLlamaCharacter::EndPush);
+			UpdateMoveState();
+			if (pushMontage)
+			{
+				//the montage's push window notify opens and closes the hitboxes
+				PlayReplicatedMontage(pushMontage);
+			}
+			else
+			{
+				BeginPushWindow();
+				ScheduleEffectEnd(pushEndTime, pushWindowTimer, &ALlamaLlamaCharacter::EndPushWindow);
+			}
 		}
 	}
 }
 
-bool ALlamaLlamaCharacter::Server_SecondaryAction_Validate()
+void ALlamaLlamaCharacter::OnRep_pushEndTime()
 {
-	return true;
+	//also lands after a predicted push, moving its end to the server's
+	bPushing = true;
+	ScheduleEffectEnd(pushEndTime, pushTimer, &ALlamaLlamaCharacter::EndPush);
+	UpdateMoveState();
 }
 
-void ALlamaLlamaCharacter::Server_SecondaryAction_Implementation()
+void ALlamaLlamaCharacter::EndPush()
 {
-	SecondaryAction();
+	bPushing = false;
+	UpdateMoveState();
+}
+
+float ALlamaLlamaCharacter::GetPushDuration() const
+{
+	if (pushMontage == nullptr)
+		return pushWindowFallbackDuration;
+
+	//the push lasts as long as its window, the rest of the montage is just the follow through
+	float windowEnd = 0.f;
+	for (const FAnimNotifyEvent& notify : pushMontage->Notifies)
+	{
+		if (Cast<UAnimNotifyState_PushWindow>(notify.NotifyStateClass))
+		{
+			windowEnd = FMath::Max(windowEnd, notify.GetEndTriggerTime());
+		}
+	}
+	return windowEnd > 0.f ? windowEnd : pushMontage->GetPlayLength();
 }
 
 void ALlamaLlamaCharacter::SecondaryAction()
 {
 	if (Role < ROLE_Authority)
 	{
-		Server_SecondaryAction();
+		GetLlamaMovement()->QueueAction(ELlamaMoveAction::SecondaryAction);
 	}
 	else
 	{
 		if (item)
 		{
-			item->OnSecondaryAction();
-		}
-		else
-		{
-
+			item->SecondaryAction();
 		}
 	}
 }
@@ -406,7 +902,7 @@ void ALlamaLlamaCharacter::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>&
 {
 	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
 
-	DOREPLIFETIME(ALlamaLlamaCharacter, item);
-	DOREPLIFETIME(ALlamaLlamaCharacter, bStunned);
-	DOREPLIFETIME(ALlamaLlamaCharacter, bPushing);
+	DOREPLIFETIME(ALlamaLlamaCharacter, stunEndTime);
+	DOREPLIFETIME(ALlamaLlamaCharacter, pushEndTime);
+	DOREPLIFETIME(ALlamaLlamaCharacter, montageState);
 }
\ No newline at end of file
@@ -4,17 +4,45 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Character.h"
+#include "Public/LlamaPoseHistory.h"
+#include "Public/TimerWheel.h"
 #include "LlamaLlamaCharacter.generated.h"
 
 class ABaseItem;
 class USphereComponent;
 class UAnimMontage;
+class ULlamaCharacterMovementComponent;
+
+/** Montage a llama is playing, replicated as state so late joiners and newly relevant clients pick it up mid play */
+USTRUCT()
+struct FLlamaMontageState
+{
+	GENERATED_BODY()
+
+	static const uint8 NoMontage = 0xFF;
+
+	/** Index into the llama's montage table */
+	UPROPERTY()
+	uint8 montageIndex = NoMontage;
+
+	/** Bumped every play so the same montage played twice in a row still replicates */
+	UPROPERTY()
+	uint8 playCount = 0;
+
+	UPROPERTY()
+	float startServerTime = 0.f;
+
+	UPROPERTY()
+	float playRate = 1.f;
+};
 
 UCLASS(config=Game)
 class ALlamaLlamaCharacter : public ACharacter
 {
 	GENERATED_BODY()
 
+	friend class ULoadTestSubsystem;
+
 	/** Camera boom positioning the camera behind the character */
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Camera, meta = (AllowPrivateAccess = "true"))
 	class USpringArmComponent* CameraBoom;
@@ -23,7 +51,7 @@ class ALlamaLlamaCharacter : public ACharacter
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Camera, meta = (AllowPrivateAccess = "true"))
 	class UCameraComponent* FollowCamera;
 public:
-	ALlamaLlamaCharacter();
+	ALlamaLlamaCharacter(const FObjectInitializer& ObjectInitializer);
 
 	/** Base turn rate, in deg/sec. Other scaling may affect final turn rate. */
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category=Camera)
@@ -39,12 +67,52 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Animation)
 	UAnimMontage* tossMontage;
 
+	/** How far from the llama an item can be picked up */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Items)
+	float pickUpRadius;
+
+	/** Called by the push window notify state, hits can only land while the window is open */
+	void BeginPushWindow();
+	void EndPushWindow();
+
+	/** Lets go of removed if we are holding it, for items that leave play while carried */
+	void OnItemRemoved(ABaseItem* removed);
+
+	/**
+	 * Takes carried into our hand, attaching it unless it already is. The server calls this on a pick up, clients when
+	 * ALlamaLlamaGameState's inventory says so and the owning client to predict a pick up
+	 */
+	void CarryItem(ABaseItem* carried);
+
+	/** Lets go of released and drops it if it's still on our hand, the inverse of CarryItem */
+	void ReleaseItem(ABaseItem* released);
+
+	/** Plays the montage on the server and replicates it through montageState, server only. Items play their use montages through this too */
+	void PlayReplicatedMontage(UAnimMontage* montage, float playRate = 1.f);
+
+	/** Clears carry, stun and push state, stops montages and timers and teleports to startTransform, server only */
+	void ResetForRound(const FTransform& startTransform);
+
+	/** Runs the ELlamaMoveAction presses a client sent along with one of its moves, server only */
+	void HandleMoveActions(uint8 actions);
+
+	ULlamaCharacterMovementComponent* GetLlamaMovement() const;
+
 protected:
 
+	virtual void PostInitializeComponents() override;
+
 	virtual void BeginPlay() override;
 
+	/** Drops the held item, it would otherwise stay attached to us and replicate as our dependent after we're gone */
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	virtual void Tick(float DeltaSeconds) override;
+
+#if !UE_SERVER
 	/** Resets HMD orientation in VR. */
 	void OnResetVR();
+#endif
 
 	/** Called for forwards/backward input */
 	void MoveForward(float Value);
@@ -64,68 +132,161 @@ protected:
 	 */
 	void LookUpAtRate(float Rate);
 
+#if !UE_SERVER
 	/** Handler for when a touch input begins. */
 	void TouchStarted(ETouchIndex::Type FingerIndex, FVector Location);
 
 	/** Handler for when a touch input stops. */
 	void TouchStopped(ETouchIndex::Type FingerIndex, FVector Location);
+#endif
 
-	UFUNCTION(NetMulticast, Reliable)
-	void Multicast_PlayMontage(UAnimMontage* montage);
+	/**
+	 * Montages that can be replicated by index, pickUpMontage, tossMontage and pushMontage are added on PostInitializeComponents.
+	 * Montages the items play on their carrier have to be listed here
+	 */
+	UPROPERTY(EditDefaultsOnly, Category = Animation)
+	TArray<UAnimMontage*> montageTable;
 
-	UFUNCTION(Server, Reliable, WithValidation)
-	void Server_OnPickUp();
+	UPROPERTY(ReplicatedUsing=OnRep_montageState)
+	FLlamaMontageState montageState;
 
+	UFUNCTION()
+	void OnRep_montageState();
+
+	/** Picks up the nearest free item or tosses the held one, predicted on the owning client */
 	UFUNCTION()
 	void PickUp();
 
+	/** Sent by the server when it found nothing to pick up so the client can roll its prediction back */
+	UFUNCTION(Client, Reliable)
+	void Client_RejectPickUp();
+
+	/** Undoes the owning client's predicted pick up */
+	void RollBackPickUp();
+
+	/** Attaches the target to this llama and plays the pick up montage, on the owning client this is the prediction */
+	void PickUpItem(ABaseItem* target);
+
+	/** Item the owning client attached before the server confirmed it */
+	ABaseItem* predictedItem;
+
+	/** Plays the toss montage and schedules the release */
+	void StartToss();
+
+	FLlamaTimerHandle tossTimer;
+
+	/** Between the toss press and the release, the llama already moves at its empty handed speed */
+	bool bTossPending = false;
+
 	UFUNCTION()
 	void TossItem();
 
-	UPROPERTY(ReplicatedUsing=OnRep_item, VisibleAnywhere, BlueprintReadWrite)
+	/** The item in our hand, set from ALlamaLlamaGameState's inventory on clients */
+	UPROPERTY(VisibleAnywhere, BlueprintReadWrite)
 	ABaseItem* item;
 
-	UFUNCTION(BlueprintCallable)
-	void OnRep_item();
+	/** Starts carrying added, move ignored while it's in our hand */
+	void OnItemAdded(ABaseItem* added);
 
-	UFUNCTION(Server, Reliable, WithValidation)
-	void Server_PrimaryAction();
+	/** Updates the carry speed after item changed */
+	UFUNCTION(BlueprintCallable)
+	void OnItemChanged();
 
 	UFUNCTION()
 	void PrimaryAction();
 
-	UFUNCTION(Server, Reliable, WithValidation)
-	void Server_SecondaryAction();
-
 	UFUNCTION()
 	void SecondaryAction();
 
-	UPROPERTY(Replicated, VisibleAnywhere, BlueprintReadWrite)
+	/** True until stunEndTime, kept on every machine from the replicated end time */
+	UPROPERTY(VisibleAnywhere, BlueprintReadWrite)
 	bool bStunned;
 
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Combat)
+	float stunDuration;
+
+	/** Server time the current stun wears off, replicated instead of bStunned so it runs out without another update */
+	UPROPERTY(ReplicatedUsing=OnRep_stunEndTime)
+	float stunEndTime;
+
 	UFUNCTION()
-	void StunLlama();
+	void OnRep_stunEndTime();
 
-	UFUNCTION(Server, Reliable, WithValidation)
-	void Server_StunLlama();
+	void EndStun();
+
+	FLlamaTimerHandle stunTimer;
 
 	UFUNCTION()
-	void StunOtherLlama(ALlamaLlamaCharacter* otherLlama);
+	void StunLlama();
 
-	UFUNCTION(Server, Reliable, WithValidation)
-	void Server_StunOtherLlama(ALlamaLlamaCharacter* otherLlama);
+	UFUNCTION()
+	void StunOtherLlama(ALlamaLlamaCharacter* otherLlama);
 
-	UPROPERTY(Replicated, VisibleAnywhere, BlueprintReadWrite)
+	/** True until pushEndTime, predicted on the owning client */
+	UPROPERTY(VisibleAnywhere, BlueprintReadWrite)
 	bool bPushing;
 
+	/** Server time the current push ends, when the push window closes */
+	UPROPERTY(ReplicatedUsing=OnRep_pushEndTime)
+	float pushEndTime;
+
+	UFUNCTION()
+	void OnRep_pushEndTime();
+
+	void EndPush();
+
+	/** Seconds from the press to the end of the push montage's push window */
+	float GetPushDuration() const;
+
+	FLlamaTimerHandle pushTimer;
+
+	/** Hands carrying, stunned and pushing to the movement component, call right where any of them changes */
+	void UpdateMoveState();
+
 	UPROPERTY(VisibleAnywhere, BlueprintReadWrite, Category = Combat)
 	USphereComponent* leftHandPushSphere;
 
 	UPROPERTY(VisibleAnywhere, BlueprintReadWrite, Category = Combat)
 	USphereComponent* rightHandPushSphere;
 
-	UFUNCTION()
-	void OnHandPushHit(UPrimitiveComponent* OverlappedComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult);
+	/** Montage with a Push Window notify state, if none is set the window opens on the press for pushWindowFallbackDuration */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Animation)
+	UAnimMontage* pushMontage;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Combat)
+	float pushWindowFallbackDuration;
+
+	bool bPushWindowOpen;
+
+	/** Closes the window when there is no push montage to do it */
+	FLlamaTimerHandle pushWindowTimer;
+
+	/** Longest the server will rewind the other llamas when checking a push, in seconds */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Combat)
+	float maxPushRewind;
+
+	/** Capsule and hand positions of the last second or so, recorded on the server */
+	FLlamaPoseHistory poseHistory;
+
+	/** Llamas already stunned by the current push, a push only lands once per victim */
+	TArray<ALlamaLlamaCharacter*> pushVictims;
+
+	/** Sweeps our hands against the other llamas rewound to what our client saw, server only */
+	void ResolvePushHits(const FLlamaPoseSnapshot& previousPose);
+
+	/**
+	 * Dedicated servers only tick montage timing and notifies, the anim graph isn't evaluated. The push spheres and a
+	 * carried item are placed from the montage's baked FLlamaSocketTrack instead. Llama.ServerFullPose 1 brings the full pose back
+	 */
+	void UpdateServerAnimation();
+
+	bool bServerFullPose = true;
+
+	/** Puts timer on the timer wheel to call onEnd at the server time endTime, or calls it now if that has passed */
+	void ScheduleEffectEnd(float endTime, FLlamaTimerHandle& timer, void (ALlamaLlamaCharacter::*onEnd)());
+
+	/** Cancels every timer the llama has on the timer wheel */
+	void ClearEffectTimers();
 
 protected:
 	// APawn interface
@@ -2,14 +2,122 @@
 
 #include "LlamaLlamaGameMode.h"
 #include "LlamaLlamaCharacter.h"
-#include "UObject/ConstructorHelpers.h"
+#include "Public/BaseItem.h"
+#include "Public/LlamaLlamaGameState.h"
+#include "Public/FireFieldSubsystem.h"
+#include "Public/ActorPoolSubsystem.h"
+#include "GameFramework/PlayerController.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
 
 ALlamaLlamaGameMode::ALlamaLlamaGameMode()
+{
+	DefaultPawnClass = ALlamaLlamaCharacter::StaticClass();
+	GameStateClass = ALlamaLlamaGameState::StaticClass();
+}
+
+void ALlamaLlamaGameMode::InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage)
 {
 	// set default pawn class to our Blueprinted character
-	static ConstructorHelpers::FClassFinder<APawn> PlayerPawnBPClass(TEXT("/Game/ThirdPersonCPP/Blueprints/ThirdPersonCharacter"));
-	if (PlayerPawnBPClass.Class != NULL)
+	if (UClass* pawnClass = llamaPawnClass.TryLoadClass<APawn>())
+	{
+		DefaultPawnClass = pawnClass;
+	}
+
+	Super::InitGame(MapName, Options, ErrorMessage);
+}
+
+void ALlamaLlamaGameMode::StartPlay()
+{
+	Super::StartPlay();
+
+	SnapshotRound();
+}
+
+void ALlamaLlamaGameMode::SnapshotRound()
+{
+	itemSnapshots.Reset();
+	for (TActorIterator<ABaseItem> It(GetWorld()); It; ++It)
+	{
+		//pooled items are hidden, they aren't part of the round
+		if (It->bHidden || It->IsPendingKillPending())
+			continue;
+
+		FItemRoundSnapshot& snapshot = itemSnapshots.AddDefaulted_GetRef();
+		snapshot.item = *It;
+		snapshot.itemClass = It->GetClass();
+		snapshot.transform = It->GetActorTransform();
+	}
+}
+
+void ALlamaLlamaGameMode::ResetRound()
+{
+	//llamas first so nobody holds on to an item that is about to move
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
 	{
-		DefaultPawnClass = PlayerPawnBPClass.Class;
+		APlayerController* controller = It->Get();
+		if (controller == nullptr)
+			continue;
+
+		ALlamaLlamaCharacter* llama = Cast<ALlamaLlamaCharacter>(controller->GetPawn());
+		if (llama == nullptr)
+		{
+			RestartPlayer(controller);
+			continue;
+		}
+
+		AActor* start = ChoosePlayerStart(controller);
+		const FTransform startTransform = start ? start->GetActorTransform() : llama->GetActorTransform();
+		llama->ResetForRound(startTransform);
+		controller->ClientSetRotation(startTransform.Rotator(), true);
+	}
+
+	TSet<ABaseItem*> snapshotItems;
+	UActorPoolSubsystem* pool = UActorPoolSubsystem::Get(this);
+	for (FItemRoundSnapshot& snapshot : itemSnapshots)
+	{
+		ABaseItem* item = snapshot.item.Get();
+
+		//consumed or pooled during the round, bring a pooled one back in its place
+		if ((item == nullptr || item->IsPendingKillPending() || item->bHidden) && pool && *snapshot.itemClass)
+		{
+			item = pool->Acquire<ABaseItem>(GetWorld(), snapshot.itemClass, snapshot.transform);
+		}
+
+		if (item)
+		{
+			item->ResetForRound(snapshot.transform);
+			snapshot.item = item;
+			snapshotItems.Add(item);
+		}
+	}
+
+	//everything spawned during the round goes back to the pool
+	for (TActorIterator<ABaseItem> It(GetWorld()); It; ++It)
+	{
+		if (!It->bHidden && !snapshotItems.Contains(*It) && pool)
+		{
+			pool->Release(*It);
+		}
+	}
+
+	if (UFireFieldSubsystem* fireField = UFireFieldSubsystem::Get(this))
+	{
+		fireField->ResetField();
 	}
 }
+
+static void ResetRoundCommand(const TArray<FString>& Args, UWorld* World)
+{
+	if (ALlamaLlamaGameMode* gameMode = World ? World->GetAuthGameMode<ALlamaLlamaGameMode>() : nullptr)
+	{
+		const double start = FPlatformTime::Seconds();
+		gameMode->ResetRound();
+		UE_LOG(LogTemp, Log, TEXT("Llama.ResetRound took %.2f ms"), (FPlatformTime::Seconds() - start) * 1000.0);
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs ResetRoundConsoleCommand(
+	TEXT("Llama.ResetRound"),
+	TEXT("Resets the round in place on the server, without a map reload"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&ResetRoundCommand));
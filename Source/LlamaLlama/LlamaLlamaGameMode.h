@@ -3,17 +3,55 @@
 #pragma once
 
 #include "CoreMinimal.h"
-#include "GameFramework/GameModeBase.h"
+#include "GameFramework/GameMode.h"
 #include "LlamaLlamaGameMode.generated.h"
 
-UCLASS(minimalapi)
-class ALlamaLlamaGameMode : public AGameModeBase
+class ABaseItem;
+
+/** Where an item started the round */
+USTRUCT()
+struct FItemRoundSnapshot
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TWeakObjectPtr<ABaseItem> item;
+
+	UPROPERTY()
+	TSubclassOf<ABaseItem> itemClass;
+
+	UPROPERTY()
+	FTransform transform;
+};
+
+UCLASS(minimalapi, config=Game)
+class ALlamaLlamaGameMode : public AGameMode
 {
 	GENERATED_BODY()
 
 public:
 	ALlamaLlamaGameMode();
-};
 
+	virtual void InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage) override;
+	virtual void StartPlay() override;
 
+	/** Pawn spawned for players, resolved when a match starts instead of when the module loads */
+	UPROPERTY(Config)
+	FSoftClassPath llamaPawnClass;
 
+	/** Remembers where every item is, taken when play starts, ResetRound puts everything back to this */
+	UFUNCTION(BlueprintCallable, Category = Round)
+	void SnapshotRound();
+
+	/**
+	 * Starts a new round in place instead of travelling: items go back to their snapshot, items spawned during the round
+	 * go back to the pool, the fire field is cleared and every llama is reset and moved to a player start.
+	 * Nothing is loaded or destroyed and clients stay connected.
+	 */
+	UFUNCTION(BlueprintCallable, Category = Round)
+	void ResetRound();
+
+private:
+	UPROPERTY(Transient)
+	TArray<FItemRoundSnapshot> itemSnapshots;
+};
@@ -0,0 +1,248 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "../Public/ActorPoolSubsystem.h"
+#include "../Public/PooledActor.h"
+#include "../Public/BaseItem.h"
+
+#include "Engine/GameInstance.h"
+#include "Engine/Engine.h"
+#include "HAL/IConsoleManager.h"
+
+const FVector UActorPoolSubsystem::ParkingLocation(0.f, 0.f, -100000.f);
+
+UActorPoolSubsystem* UActorPoolSubsystem::Get(const UObject* worldContext)
+{
+	UWorld* world = GEngine ? GEngine->GetWorldFromContextObject(worldContext, EGetWorldErrorMode::ReturnNull) : nullptr;
+	UGameInstance* gameInstance = world ? world->GetGameInstance() : nullptr;
+	return gameInstance ? gameInstance->GetSubsystem<UActorPoolSubsystem>() : nullptr;
+}
+
+void UActorPoolSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	worldInitializedActorsHandle = FWorldDelegates::OnWorldInitializedActors.AddUObject(this, &UActorPoolSubsystem::OnWorldInitializedActors);
+	worldCleanupHandle = FWorldDelegates::OnWorldCleanup.AddUObject(this, &UActorPoolSubsystem::OnWorldCleanup);
+}
+
+void UActorPoolSubsystem::Deinitialize()
+{
+	FWorldDelegates::OnWorldInitializedActors.Remove(worldInitializedActorsHandle);
+	FWorldDelegates::OnWorldCleanup.Remove(worldCleanupHandle);
+	pools.Empty();
+
+	Super::Deinitialize();
+}
+
+void UActorPoolSubsystem::OnWorldInitializedActors(const UWorld::FActorsInitializedParams& params)
+{
+	UWorld* world = params.World;
+	if (world == nullptr || !world->IsGameWorld() || world->GetGameInstance() != GetGameInstance())
+		return;
+
+	//before BeginPlay, so nothing in the match pays for the spawns
+	const FString mapName = UWorld::RemovePIEPrefix(world->GetMapName());
+	for (const FActorPoolPrewarm& entry : prewarm)
+	{
+		if (entry.map == mapName)
+		{
+			Prewarm(world, entry.actorClass.TryLoadClass<AActor>(), entry.count);
+		}
+	}
+}
+
+void UActorPoolSubsystem::OnWorldCleanup(UWorld* world, bool bSessionEnded, bool bCleanupResources)
+{
+	//the pooled actors go down with their world
+	for (auto& pool : pools)
+	{
+		pool.Value.actors.RemoveAll([world](AActor* actor) { return actor == nullptr || actor->GetWorld() == world; });
+	}
+}
+
+void UActorPoolSubsystem::Prewarm(UWorld* world, TSubclassOf<AActor> actorClass, int32 count)
+{
+	if (world == nullptr || *actorClass == nullptr || world->IsNetMode(NM_Client))
+		return;
+
+	const FTransform parked(ParkingLocation);
+	for (int32 i = GetNumPooled(actorClass); i < count; ++i)
+	{
+		if (AActor* actor = SpawnForPool(world, actorClass, parked))
+		{
+			Release(actor);
+		}
+	}
+}
+
+AActor* UActorPoolSubsystem::Acquire(UWorld* world, TSubclassOf<AActor> actorClass, const FTransform& transform)
+{
+	if (world == nullptr || *actorClass == nullptr)
+		return nullptr;
+
+	AActor* actor = nullptr;
+	if (FActorPoolList* pool = pools.Find(*actorClass))
+	{
+		while (actor == nullptr && pool->actors.Num() > 0)
+		{
+			actor = pool->actors.Pop(false);
+			if (actor && (actor->IsPendingKillPending() || actor->GetWorld() != world))
+			{
+				actor = nullptr;
+			}
+		}
+	}
+
+	if (actor == nullptr)
+		return SpawnForPool(world, actorClass, transform);
+
+	if (actor->GetIsReplicated())
+	{
+		actor->SetNetDormancy(DORM_Awake);
+	}
+
+	actor->SetActorTransform(transform, false, nullptr, ETeleportType::ResetPhysics);
+	actor->SetActorHiddenInGame(false);
+	actor->SetActorEnableCollision(true);
+	actor->SetActorTickEnabled(actor->PrimaryActorTick.bStartWithTickEnabled);
+
+	if (IPooledActor* pooledActor = Cast<IPooledActor>(actor))
+	{
+		pooledActor->OnAcquiredFromPool();
+	}
+
+	return actor;
+}
+
+void UActorPoolSubsystem::Release(AActor* actor)
+{
+	if (actor == nullptr || actor->IsPendingKillPending())
+		return;
+
+	if (actor->Role < ROLE_Authority)
+	{
+		actor->Destroy();
+		return;
+	}
+
+	if (IPooledActor* pooledActor = Cast<IPooledActor>(actor))
+	{
+		pooledActor->OnReturnedToPool();
+	}
+
+	actor->SetActorHiddenInGame(true);
+	actor->SetActorEnableCollision(false);
+	actor->SetActorTickEnabled(false);
+	actor->SetActorLocation(ParkingLocation, false, nullptr, ETeleportType::ResetPhysics);
+
+	//clients get the hidden, parked state once more before the channel goes quiet
+	if (actor->GetIsReplicated())
+	{
+		actor->FlushNetDormancy();
+		actor->SetNetDormancy(DORM_DormantAll);
+	}
+
+	pools.FindOrAdd(actor->GetClass()).actors.AddUnique(actor);
+}
+
+int32 UActorPoolSubsystem::GetNumPooled(TSubclassOf<AActor> actorClass) const
+{
+	const FActorPoolList* pool = pools.Find(*actorClass);
+	return pool ? pool->actors.Num() : 0;
+}
+
+AActor* UActorPoolSubsystem::SpawnForPool(UWorld* world, TSubclassOf<AActor> actorClass, const FTransform& transform)
+{
+	FActorSpawnParameters spawnParams;
+	spawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	return world->SpawnActor<AActor>(actorClass, transform, spawnParams);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Benchmark
+
+/**
+ * Spawns and destroys a burst of actors, then acquires and releases the same burst from a prewarmed pool,
+ * and logs the total and the worst single call of each. Defaults to 200 ABaseItem.
+ * Args: [count] [class path], e.g. Llama.BenchPool 200 /Game/Items/Blueprint/BP_Fire.BP_Fire_C
+ */
+static void BenchPool(const TArray<FString>& Args, UWorld* World)
+{
+	UActorPoolSubsystem* pool = UActorPoolSubsystem::Get(World);
+	if (pool == nullptr || World->IsNetMode(NM_Client))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Llama.BenchPool needs a game world with authority"));
+		return;
+	}
+
+	const int32 count = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 200;
+	UClass* actorClass = ABaseItem::StaticClass();
+	if (Args.Num() > 1)
+	{
+		actorClass = FSoftClassPath(Args[1]).TryLoadClass<AActor>();
+		if (actorClass == nullptr)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Llama.BenchPool couldn't load %s"), *Args[1]);
+			return;
+		}
+	}
+
+	TArray<FTransform> transforms;
+	for (int32 i = 0; i < count; ++i)
+	{
+		const FVector2D offset = FMath::RandPointInCircle(3000.f);
+		transforms.Add(FTransform(FVector(offset.X, offset.Y, 200.f)));
+	}
+
+	TArray<AActor*> actors;
+	double worst = 0.0;
+
+	auto timed = [&worst](TFunctionRef<void()> call)
+	{
+		const double start = FPlatformTime::Seconds();
+		call();
+		const double elapsed = FPlatformTime::Seconds() - start;
+		worst = FMath::Max(worst, elapsed);
+		return elapsed;
+	};
+
+	FActorSpawnParameters spawnParams;
+	spawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	double spawnTotal = 0.0;
+	for (const FTransform& transform : transforms)
+	{
+		spawnTotal += timed([&]() { actors.Add(World->SpawnActor<AActor>(actorClass, transform, spawnParams)); });
+	}
+	double destroyTotal = 0.0;
+	for (AActor* actor : actors)
+	{
+		destroyTotal += timed([&]() { if (actor) actor->Destroy(); });
+	}
+	const double spawnDestroyWorst = worst;
+	actors.Reset();
+
+	pool->Prewarm(World, actorClass, count);
+
+	worst = 0.0;
+	double acquireTotal = 0.0;
+	for (const FTransform& transform : transforms)
+	{
+		acquireTotal += timed([&]() { actors.Add(pool->Acquire(World, actorClass, transform)); });
+	}
+	double releaseTotal = 0.0;
+	for (AActor* actor : actors)
+	{
+		releaseTotal += timed([&]() { pool->Release(actor); });
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("Llama.BenchPool %d x %s: spawn %.2f ms + destroy %.2f ms (worst call %.3f ms), acquire %.2f ms + release %.2f ms (worst call %.3f ms)"),
+		count, *actorClass->GetName(), spawnTotal * 1000.0, destroyTotal * 1000.0, spawnDestroyWorst * 1000.0,
+		acquireTotal * 1000.0, releaseTotal * 1000.0, worst * 1000.0);
+}
+
+static FAutoConsoleCommandWithWorldAndArgs BenchPoolCommand(
+	TEXT("Llama.BenchPool"),
+	TEXT("Compares spawn/destroy against pooled acquire/release for a burst of actors. Optional args: count (200), class path (ABaseItem)"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&BenchPool));
@@ -0,0 +1,32 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "../Public/AnimNotifyState_PushWindow.h"
+#include "../LlamaLlamaCharacter.h"
+
+#include "Components/SkeletalMeshComponent.h"
+
+void UAnimNotifyState_PushWindow::NotifyBegin(USkeletalMeshComponent* MeshComp, UAnimSequenceBase* Animation, float TotalDuration)
+{
+	Super::NotifyBegin(MeshComp, Animation, TotalDuration);
+
+	if (ALlamaLlamaCharacter* llama = MeshComp ? Cast<ALlamaLlamaCharacter>(MeshComp->GetOwner()) : nullptr)
+	{
+		llama->BeginPushWindow();
+	}
+}
+
+void UAnimNotifyState_PushWindow::NotifyEnd(USkeletalMeshComponent* MeshComp, UAnimSequenceBase* Animation)
+{
+	Super::NotifyEnd(MeshComp, Animation);
+
+	if (ALlamaLlamaCharacter* llama = MeshComp ? Cast<ALlamaLlamaCharacter>(MeshComp->GetOwner()) : nullptr)
+	{
+		llama->EndPushWindow();
+	}
+}
+
+FString UAnimNotifyState_PushWindow::GetNotifyName_Implementation() const
+{
+	return TEXT("Push Window");
+}
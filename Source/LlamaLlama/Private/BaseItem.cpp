@@ -7,13 +7,48 @@
 
 #include "Net/UnrealNetwork.h"
 
+#include "../LlamaLlama.h"
 #include "../LlamaLlamaCharacter.h"
+#include "../Public/ItemGridSubsystem.h"
+#include "../Public/LlamaLlamaGameState.h"
+#include "../Public/ItemAssetSubsystem.h"
+#include "../Public/ItemDefinition.h"
+#include "../Public/LoadTestSubsystem.h"
+#include "../Public/EventJournal.h"
+#include "../Public/RevolverItem.h"
+#include "../Public/ExtinguisherItem.h"
+#include "../Public/GasCanItem.h"
+#include "../Public/MatchesItem.h"
+#include "Engine/StaticMesh.h"
+#include "GameFramework/GameStateBase.h"
+#include "GameFramework/GameModeBase.h"
+#include "Kismet/GameplayStatics.h"
+#include "Sound/SoundBase.h"
+#include "Particles/ParticleSystem.h"
+#include "HAL/IConsoleManager.h"
+#include "Engine/NetDriver.h"
+#include "Engine/NetConnection.h"
+#include "Serialization/BitWriter.h"
+
+DECLARE_CYCLE_STAT(TEXT("Item OnPickUp"), STAT_LlamaItemOnPickUp, STATGROUP_Llama);
+DECLARE_CYCLE_STAT(TEXT("Item Drop"), STAT_LlamaItemDrop, STATGROUP_Llama);
+DECLARE_CYCLE_STAT(TEXT("Item OnPrimaryAction"), STAT_LlamaItemOnPrimaryAction, STATGROUP_Llama);
+DECLARE_CYCLE_STAT(TEXT("Item OnSecondaryAction"), STAT_LlamaItemOnSecondaryAction, STATGROUP_Llama);
+
+static TAutoConsoleVariable<int32> CVarCompactItemMovement(
+	TEXT("Llama.CompactItemMovement"),
+	1,
+	TEXT("1 replicates free items through the quantized, delta compressed FItemRepMovement at a rate that follows their speed.\n")
+	TEXT("0 uses the actor's FRepMovement at the full rate, for comparing bytes in the load test. Only read by the server."));
+
+FOnItemCarrierChanged ABaseItem::OnCarrierChanged;
+FOnItemNetUpdateFrequencyChanged ABaseItem::OnNetUpdateFrequencyChanged;
 
 // Sets default values
 ABaseItem::ABaseItem()
 {
- 	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
-	PrimaryActorTick.bCanEverTick = true;
+ 	// Items don't tick, blueprint subclasses that implement Tick get it turned back on by the compiler
+	PrimaryActorTick.bCanEverTick = false;
 
 	meshComp = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("Mesh Component"));
 	RootComponent = meshComp;
@@ -24,92 +59,621 @@ ABaseItem::ABaseItem()
 
 	meshComp->SetSimulatePhysics(true);
 	meshComp->CanCharacterStepUp(false);
+	meshComp->BodyInstance.bGenerateWakeEvents = true;
+
+	definition = nullptr;
+	ccdSpeed = 1500.f;
+	maxFlightSubstep = 1.f / 60.f;
+
+	minNetUpdateFrequency = 5.f;
+	maxNetUpdateFrequency = 30.f;
+	fastMovementSpeed = 1000.f;
+	linearVelocityThreshold = 8.f;
+	angularVelocityThreshold = 15.f;
 
 	SetReplicates(true);
 	SetReplicateMovement(true);
+	NetUpdateFrequency = maxNetUpdateFrequency;
 }
 
 // Called when the game starts or when spawned
 void ABaseItem::BeginPlay()
 {
 	Super::BeginPlay();
-	
+
+	meshComp->OnComponentWake.AddDynamic(this, &ABaseItem::OnMeshWake);
+	meshComp->OnComponentSleep.AddDynamic(this, &ABaseItem::OnMeshSleep);
+
+	//native items skip the blueprint VM unless a blueprint subclass put its own graph on top
+	bScriptPrimaryAction = GetClass()->IsFunctionImplementedInScript(GET_FUNCTION_NAME_CHECKED(ABaseItem, OnPrimaryAction));
+	bScriptSecondaryAction = GetClass()->IsFunctionImplementedInScript(GET_FUNCTION_NAME_CHECKED(ABaseItem, OnSecondaryAction));
+
+	RegisterWithWorld();
+
+	if (definition)
+	{
+		UItemAssetSubsystem* itemAssets = UItemAssetSubsystem::Get(this);
+		if (itemAssets && !itemAssets->IsItemDefinitionLoaded(definition))
+		{
+			itemDefinitionsLoadedHandle = itemAssets->OnItemDefinitionsLoaded.AddUObject(this, &ABaseItem::ApplyDefinition);
+			//items spawned or streamed in after the map started may not be in its set yet
+			itemAssets->LoadItemDefinition(definition);
+		}
+		else
+		{
+			ApplyDefinition();
+		}
+	}
+
 }
 
-// Called every frame
-void ABaseItem::Tick(float DeltaTime)
+void ABaseItem::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
-	Super::Tick(DeltaTime);
+	UnregisterFromWorld();
+
+	if (UItemAssetSubsystem* itemAssets = UItemAssetSubsystem::Get(this))
+	{
+		itemAssets->OnItemDefinitionsLoaded.Remove(itemDefinitionsLoadedHandle);
+	}
 
+	Super::EndPlay(EndPlayReason);
 }
 
-bool ABaseItem::Server_OnPickUp_Validate(ACharacter* invoker)
+bool ABaseItem::IsMovementCompact()
 {
-	return true;
+	return CVarCompactItemMovement.GetValueOnGameThread() != 0;
 }
 
-void ABaseItem::Server_OnPickUp_Implementation(ACharacter* invoker)
+void ABaseItem::PreReplication(IRepChangedPropertyTracker& ChangedPropertyTracker)
 {
-	OnPickUp(invoker);
+	Super::PreReplication(ChangedPropertyTracker);
+
+	const bool bCompact = IsMovementCompact();
+	const bool bFree = bReplicateMovement && carrier == nullptr;
+	if (bCompact && bFree)
+	{
+		if (UItemGridSubsystem* grid = UItemGridSubsystem::Get(this))
+		{
+			itemMovement.state.FromMovement(ReplicatedMovement, grid->movementBounds);
+		}
+		itemMovement.linearVelocityThreshold = FMath::RoundToInt(linearVelocityThreshold);
+		itemMovement.angularVelocityThreshold = FMath::RoundToInt(angularVelocityThreshold);
+	}
+
+	if (bFree && !bCompact && ULoadTestSubsystem::IsRecording())
+	{
+		CountStockMovementBits();
+	}
+
+	DOREPLIFETIME_ACTIVE_OVERRIDE(AActor, ReplicatedMovement, bFree && !bCompact);
+	DOREPLIFETIME_ACTIVE_OVERRIDE(ABaseItem, itemMovement, bFree && bCompact);
+	DOREPLIFETIME_ACTIVE_OVERRIDE(AActor, AttachmentReplication, false);
+	DOREPLIFETIME_ACTIVE_OVERRIDE(ABaseItem, carrier, !UsesInventory());
 }
 
-void ABaseItem::OnPickUp(ACharacter* invoker)
+void ABaseItem::CountStockMovementBits()
+{
+	const FRepMovement& movement = ReplicatedMovement;
+	if (movement.Location == countedMovement.Location && movement.Rotation == countedMovement.Rotation
+		&& movement.LinearVelocity == countedMovement.LinearVelocity && movement.AngularVelocity == countedMovement.AngularVelocity
+		&& movement.bSimulatedPhysicSleep == countedMovement.bSimulatedPhysicSleep && movement.bRepPhysics == countedMovement.bRepPhysics)
+	{
+		return;
+	}
+	countedMovement = movement;
+
+	//a change goes out whole to every connection with a channel open for the item, like FItemRepMovement is counted per connection
+	UNetDriver* driver = GetNetDriver();
+	if (!driver)
+	{
+		return;
+	}
+	int32 channels = 0;
+	for (UNetConnection* connection : driver->ClientConnections)
+	{
+		channels += (connection && connection->ActorChannelMap().Contains(this)) ? 1 : 0;
+	}
+	if (channels == 0)
+	{
+		return;
+	}
+
+	FBitWriter writer(0, true);
+	bool bOutSuccess = false;
+	countedMovement.NetSerialize(writer, nullptr, bOutSuccess);
+	ULoadTestSubsystem::CountItemMovementBits((int32)writer.GetNumBits() * channels);
+}
+
+bool ABaseItem::UsesInventory() const
+{
+	return GetWorld()->GetGameState<ALlamaLlamaGameState>() != nullptr;
+}
+
+void ABaseItem::OnRep_carrier(ALlamaLlamaCharacter* oldCarrier)
+{
+	//only replicated without an inventory, put the old value back so carrying and releasing see where the item was
+	ALlamaLlamaCharacter* newCarrier = carrier;
+	carrier = oldCarrier;
+	if (newCarrier == oldCarrier)
+		return;
+
+	if (oldCarrier)
+	{
+		oldCarrier->ReleaseItem(this);
+	}
+	if (newCarrier)
+	{
+		newCarrier->CarryItem(this);
+	}
+}
+
+void ABaseItem::OnRep_itemMovement()
+{
+	//flights and carried items are placed by the launch and the attachment, the first update after that catches up
+	if (bInFlight || carrier)
+		return;
+
+	if (UItemGridSubsystem* grid = UItemGridSubsystem::Get(this))
+	{
+		itemMovement.state.ToMovement(ReplicatedMovement, grid->movementBounds);
+		OnRep_ReplicatedMovement();
+	}
+}
+
+void ABaseItem::UpdateNetUpdateFrequency()
+{
+	if (Role != ROLE_Authority || carrier || bInFlight)
+		return;
+
+	float frequency = maxNetUpdateFrequency;
+	if (IsMovementCompact())
+	{
+		//in 5 Hz steps, the replication graph doesn't need to hear about every bump
+		const float alpha = FMath::Clamp(GetVelocity().Size() / fastMovementSpeed, 0.f, 1.f);
+		frequency = FMath::Clamp(FMath::RoundToFloat(FMath::Lerp(minNetUpdateFrequency, maxNetUpdateFrequency, alpha) / 5.f) * 5.f,
+			minNetUpdateFrequency, maxNetUpdateFrequency);
+	}
+
+	if (frequency != NetUpdateFrequency)
+	{
+		NetUpdateFrequency = frequency;
+		OnNetUpdateFrequencyChanged.Broadcast(this);
+	}
+}
+
+void ABaseItem::RegisterWithWorld()
+{
+	if (bRegisteredWithWorld)
+		return;
+
+	bRegisteredWithWorld = true;
+
+	if (UItemGridSubsystem* grid = UItemGridSubsystem::Get(this))
+	{
+		grid->RegisterItem(this);
+		grid->SetItemAwake(this, meshComp->IsAnyRigidBodyAwake());
+	}
+
+	if (Role == ROLE_Authority)
+	{
+		INC_DWORD_STAT(STAT_LlamaAwakeItems);
+		SetDormant(carrier != nullptr || !meshComp->IsAnyRigidBodyAwake());
+	}
+}
+
+void ABaseItem::UnregisterFromWorld()
+{
+	if (!bRegisteredWithWorld)
+		return;
+
+	bRegisteredWithWorld = false;
+
+	if (UItemGridSubsystem* grid = UItemGridSubsystem::Get(this))
+	{
+		grid->UnregisterItem(this);
+	}
+
+	if (Role == ROLE_Authority)
+	{
+		if (NetDormancy > DORM_Awake)
+		{
+			DEC_DWORD_STAT(STAT_LlamaDormantItems);
+		}
+		else
+		{
+			DEC_DWORD_STAT(STAT_LlamaAwakeItems);
+		}
+	}
+}
+
+void ABaseItem::Launch(const FVector& velocity, AActor* thrower)
 {
 	if (Role < ROLE_Authority)
+		return;
+
+	if (carrier)
 	{
-		//is client
-		Server_OnPickUp(invoker);
+		Drop();
 	}
-	else if (Role == ROLE_Authority)
+
+	//the server flies the quantized launch too, so every machine starts from the same numbers
+	auto quantize = [](const FVector& v) { return FVector(FMath::RoundToFloat(v.X * 10.f), FMath::RoundToFloat(v.Y * 10.f), FMath::RoundToFloat(v.Z * 10.f)) / 10.f; };
+
+	AGameStateBase* gameState = GetWorld()->GetGameState();
+	launch.location = quantize(GetActorLocation());
+	launch.velocity = quantize(velocity);
+	launch.serverTime = gameState ? gameState->GetServerWorldTimeSeconds() : GetWorld()->GetTimeSeconds();
+	launch.thrower = thrower;
+	launch.launchCount++;
+
+	SetReplicateMovement(false);
+	StartFlight(0.f);
+	ForceNetUpdate();
+}
+
+void ABaseItem::OnRep_launch()
+{
+	//picked up again since, the launch is old news
+	if (carrier && carrier != launch.thrower)
+		return;
+
+	AGameStateBase* gameState = GetWorld()->GetGameState();
+	const float elapsed = gameState ? gameState->GetServerWorldTimeSeconds() - launch.serverTime : 0.f;
+
+	//became relevant long after the toss, it has landed and the replicated movement has it
+	if (elapsed > 5.f)
+		return;
+
+	//the launch can beat the inventory's removal here, they come through different channels
+	if (carrier)
 	{
-		//is server
-		meshComp->SetSimulatePhysics(false);
-		AttachToComponent(invoker->GetMesh(), FAttachmentTransformRules::SnapToTargetNotIncludingScale, FName("item_socket_R"));
-		carrier = Cast<ALlamaLlamaCharacter>(invoker);
+		carrier->ReleaseItem(this);
 	}
+	DetachFromActor(FDetachmentTransformRules::KeepWorldTransform);
+
+	StartFlight(FMath::Max(elapsed, 0.f));
 }
 
-bool ABaseItem::Server_OnPrimaryAction_Validate()
+void ABaseItem::OnRep_ReplicateMovement()
 {
-	return true;
+	Super::OnRep_ReplicateMovement();
+
+	if (bReplicateMovement && bInFlight)
+	{
+		EndFlight(launch.velocity + FVector(0.f, 0.f, GetWorld()->GetGravityZ() * flightTime));
+	}
 }
 
-void ABaseItem::Server_OnPrimaryAction_Implementation()
+void ABaseItem::StartFlight(float elapsed)
 {
-	OnPrimaryAction();
+	bInFlight = true;
+	flightTime = 0.f;
+
+	meshComp->SetSimulatePhysics(false);
+	if (launch.thrower)
+	{
+		meshComp->IgnoreActorWhenMoving(launch.thrower, true);
+	}
+	SetActorLocation(launch.location, false, nullptr, ETeleportType::TeleportPhysics);
+
+	//the grid ticks awake items, that is what moves the item along the arc
+	if (UItemGridSubsystem* grid = UItemGridSubsystem::Get(this))
+	{
+		grid->SetItemAwake(this, true);
+	}
+
+	if (elapsed > 0.f)
+	{
+		TickFlight(elapsed);
+	}
 }
 
-void ABaseItem::OnPrimaryAction_Implementation()
+FVector ABaseItem::GetFlightLocation(float time) const
+{
+	return launch.location + launch.velocity * time + FVector(0.f, 0.f, 0.5f * GetWorld()->GetGravityZ() * time * time);
+}
+
+void ABaseItem::TickFlight(float DeltaTime)
+{
+	float remaining = DeltaTime;
+	while (bInFlight && remaining > 0.f)
+	{
+		//fixed substeps so a fast item can't tunnel through a thin wall in one frame
+		const float step = FMath::Min(remaining, maxFlightSubstep);
+		remaining -= step;
+
+		FHitResult hit;
+		SetActorLocation(GetFlightLocation(flightTime + step), true, &hit);
+		if (hit.bBlockingHit)
+		{
+			const float hitTime = flightTime + step * hit.Time;
+			EndFlight(launch.velocity + FVector(0.f, 0.f, GetWorld()->GetGravityZ() * hitTime));
+			break;
+		}
+
+		flightTime += step;
+	}
+}
+
+void ABaseItem::EndFlight(const FVector& velocity)
+{
+	CancelFlight();
+
+	meshComp->SetSimulatePhysics(!bStreamedOut);
+	meshComp->SetPhysicsLinearVelocity(velocity);
+	if (velocity.SizeSquared() > FMath::Square(ccdSpeed))
+	{
+		meshComp->SetUseCCD(true);
+	}
+
+	if (Role == ROLE_Authority)
+	{
+		ForceNetUpdate();
+		LLAMA_COUNT(ItemFlightCorrections, 1);
+	}
+}
+
+void ABaseItem::CancelFlight()
 {
+	if (!bInFlight)
+		return;
+
+	bInFlight = false;
+	if (launch.thrower)
+	{
+		meshComp->IgnoreActorWhenMoving(launch.thrower, false);
+	}
+
+	if (Role == ROLE_Authority)
+	{
+		SetReplicateMovement(true);
+	}
+}
+
+void ABaseItem::OnAcquiredFromPool()
+{
+	meshComp->SetSimulatePhysics(true);
+	RegisterWithWorld();
+}
+
+void ABaseItem::OnReturnedToPool()
+{
+	CancelFlight();
+
+	if (ALlamaLlamaCharacter* oldCarrier = carrier)
+	{
+		Drop();
+		oldCarrier->OnItemRemoved(this);
+	}
+
+	meshComp->SetPhysicsLinearVelocity(FVector::ZeroVector);
+	meshComp->SetPhysicsAngularVelocityInDegrees(FVector::ZeroVector);
+	meshComp->SetSimulatePhysics(false);
+
+	//out of the grid and the stats until it is acquired again, the pool takes care of dormancy
+	UnregisterFromWorld();
+}
+
+void ABaseItem::OnMeshWake(UPrimitiveComponent* WakingComponent, FName BoneName)
+{
+	if (UItemGridSubsystem* grid = UItemGridSubsystem::Get(this))
+	{
+		grid->SetItemAwake(this, true);
+	}
+
+	//something knocked the item around, start replicating its movement again
+	if (carrier == nullptr)
+	{
+		SetDormant(false);
+	}
+}
+
+void ABaseItem::OnMeshSleep(UPrimitiveComponent* SleepingComponent, FName BoneName)
+{
+	if (UItemGridSubsystem* grid = UItemGridSubsystem::Get(this))
+	{
+		grid->SetItemAwake(this, false);
+	}
+
+	if (meshComp->BodyInstance.bUseCCD)
+	{
+		meshComp->SetUseCCD(false);
+	}
+
+	SetDormant(true);
+}
+
+void ABaseItem::ApplyDefinition()
+{
+	if (definition == nullptr)
+		return;
+
+	if (UStaticMesh* mesh = definition->mesh.Get())
+	{
+		meshComp->SetStaticMesh(mesh);
+	}
+}
+
+void ABaseItem::SetDormant(bool bDormant)
+{
+	if (Role != ROLE_Authority || !bRegisteredWithWorld)
+		return;
+
+	const bool bIsDormant = NetDormancy > DORM_Awake;
+	if (bIsDormant == bDormant)
+		return;
+
+	//the channel replicates the latest state one last time before it goes dormant
+	SetNetDormancy(bDormant ? DORM_DormantAll : DORM_Awake);
+
+	if (bDormant)
+	{
+		DEC_DWORD_STAT(STAT_LlamaAwakeItems);
+		INC_DWORD_STAT(STAT_LlamaDormantItems);
+	}
+	else
+	{
+		DEC_DWORD_STAT(STAT_LlamaDormantItems);
+		INC_DWORD_STAT(STAT_LlamaAwakeItems);
+	}
+}
+
+void ABaseItem::SetCarrier(ALlamaLlamaCharacter* newCarrier)
+{
+	ALlamaLlamaCharacter* oldCarrier = carrier;
+	carrier = newCarrier;
+
+	if (UItemGridSubsystem* grid = UItemGridSubsystem::Get(this))
+	{
+		grid->UpdateItem(this);
+	}
+
+	if (Role == ROLE_Authority && oldCarrier != newCarrier)
+	{
+		if (ALlamaLlamaGameState* gameState = GetWorld()->GetGameState<ALlamaLlamaGameState>())
+		{
+			gameState->SetItemCarrier(this, newCarrier);
+		}
+		OnCarrierChanged.Broadcast(this, newCarrier, oldCarrier);
+	}
+}
+
+void ABaseItem::Drop()
+{
+	LLAMA_SCOPE_CYCLE_COUNTER(STAT_LlamaItemDrop);
+
+	SetDormant(false);
+	DetachFromActor(FDetachmentTransformRules::KeepWorldTransform);
+	meshComp->SetSimulatePhysics(!bStreamedOut);
+	SetCarrier(nullptr);
+}
+
+void ABaseItem::ResetForRound(const FTransform& transform)
+{
+	if (Role < ROLE_Authority)
+		return;
+
+	CancelFlight();
+
+	if (carrier)
+	{
+		ALlamaLlamaCharacter* oldCarrier = carrier;
+		Drop();
+		oldCarrier->OnItemRemoved(this);
+	}
+
+	//awake for the teleport so clients get the new position, it goes dormant again when the body falls asleep
+	SetDormant(false);
+	SetActorTransform(transform, false, nullptr, ETeleportType::ResetPhysics);
+	meshComp->SetPhysicsLinearVelocity(FVector::ZeroVector);
+	meshComp->SetPhysicsAngularVelocityInDegrees(FVector::ZeroVector);
+	meshComp->PutRigidBodyToSleep();
+}
+
+void ABaseItem::SetStreamedIn(bool bStreamedIn)
+{
+	if (bStreamedOut != bStreamedIn || Role == ROLE_Authority)
+		return;
+
+	bStreamedOut = !bStreamedIn;
+
+	//replicated movement still moves a frozen item, it just doesn't simulate against the missing floor
+	meshComp->SetVisibility(bStreamedIn);
+	if (carrier == nullptr)
+	{
+		meshComp->SetSimulatePhysics(bStreamedIn);
+	}
+}
+
+void ABaseItem::OnPickUp(ACharacter* invoker)
+{
+	LLAMA_SCOPE_CYCLE_COUNTER(STAT_LlamaItemOnPickUp);
+
+	//caught mid air
+	CancelFlight();
+
+	meshComp->SetSimulatePhysics(false);
+	AttachToComponent(invoker->GetMesh(), FAttachmentTransformRules::SnapToTargetNotIncludingScale, FName("item_socket_R"));
+	SetCarrier(Cast<ALlamaLlamaCharacter>(invoker));
+
+	//the inventory, or the carrier on maps without one, attaches it on clients, there is nothing left to send until it's dropped
+	SetDormant(true);
+}
+
+void ABaseItem::PrimaryAction()
+{
+	LLAMA_SCOPE_CYCLE_COUNTER(STAT_LlamaItemOnPrimaryAction);
+
 	if (Role < ROLE_Authority)
+		return;
+
+	FLlamaEventJournal::Record(GetWorld(), ELlamaJournalEvent::ItemPrimaryAction, carrier, this, GetActorLocation());
+
+	if (bScriptPrimaryAction)
 	{
-		Server_OnPrimaryAction();
+		OnPrimaryAction();
 	}
-	else if (Role == ROLE_Authority)
+	else
 	{
-		//
+		NativePrimaryAction();
 	}
 }
 
-bool ABaseItem::Server_OnSecondaryAction_Validate()
+void ABaseItem::OnPrimaryAction_Implementation()
 {
-	return true;
+	NativePrimaryAction();
 }
 
-void ABaseItem::Server_OnSecondaryAction_Implementation()
+void ABaseItem::SecondaryAction()
 {
-	OnSecondaryAction();
+	LLAMA_SCOPE_CYCLE_COUNTER(STAT_LlamaItemOnSecondaryAction);
+
+	if (Role < ROLE_Authority)
+		return;
+
+	FLlamaEventJournal::Record(GetWorld(), ELlamaJournalEvent::ItemSecondaryAction, carrier, this, GetActorLocation());
+
+	if (bScriptSecondaryAction)
+	{
+		OnSecondaryAction();
+	}
+	else
+	{
+		NativeSecondaryAction();
+	}
 }
 
 void ABaseItem::OnSecondaryAction_Implementation()
+{
+	NativeSecondaryAction();
+}
+
+void ABaseItem::PlayUseEffects()
 {
 	if (Role < ROLE_Authority)
+		return;
+
+	//carried items are dormant, the multicast has to wake it for the one send
+	FlushNetDormancy();
+	LLAMA_COUNT_RPC(Sent_Multicast_PlayUseEffects);
+	Multicast_PlayUseEffects();
+}
+
+void ABaseItem::Multicast_PlayUseEffects_Implementation()
+{
+	if (IsRunningDedicatedServer() || definition == nullptr)
+		return;
+
+	LLAMA_COUNT_RPC(Received_Multicast_PlayUseEffects);
+
+	//the cosmetic bundle may still be loading, a missed sound isn't worth waiting for
+	if (USoundBase* sound = definition->useSound.Get())
 	{
-		Server_OnSecondaryAction();
+		UGameplayStatics::SpawnSoundAttached(sound, meshComp);
 	}
-	else if (Role == ROLE_Authority)
+	if (UParticleSystem* effect = definition->useEffect.Get())
 	{
-		//
+		UGameplayStatics::SpawnEmitterAttached(effect, meshComp);
 	}
 }
 
@@ -118,4 +682,120 @@ void ABaseItem::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetim
 	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
 
 	DOREPLIFETIME(ABaseItem, carrier);
-}
\ No newline at end of file
+	DOREPLIFETIME(ABaseItem, launch);
+	DOREPLIFETIME(ABaseItem, itemMovement);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Benchmark
+
+/**
+ * Times PrimaryAction per call for each native item and the blueprint it is measured against, and SecondaryAction for
+ * the revolver, the only item with one. Every call gets a freshly spawned item carried by a llama spawned for the run,
+ * so charges and cooldowns never cut a call short on either side. Only the actions are timed.
+ * The native items aren't what the item definitions spawn yet, the BP_ items still are.
+ * Meant for a headless server, e.g. -ExecCmds="Llama.BenchItemActions 1000".
+ * The shots, fuel and fire land in the world, Llama.ResetRound cleans up after it.
+ * Args: [calls per item]
+ */
+static void BenchItemActions(const TArray<FString>& Args, UWorld* World)
+{
+	AGameModeBase* gameMode = World ? World->GetAuthGameMode() : nullptr;
+	UClass* llamaClass = gameMode ? gameMode->DefaultPawnClass : nullptr;
+	if (llamaClass == nullptr || !llamaClass->IsChildOf(ALlamaLlamaCharacter::StaticClass()))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Llama.BenchItemActions needs a game world with authority"));
+		return;
+	}
+
+	const int32 calls = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 1000;
+
+	struct FItemPair
+	{
+		UClass* nativeClass;
+		const TCHAR* blueprintPath;
+		bool bSecondary;
+	};
+	const FItemPair pairs[] = {
+		{ ARevolverItem::StaticClass(), TEXT("/Game/Items/Blueprint/BP_Revolver.BP_Revolver_C"), true },
+		{ AExtinguisherItem::StaticClass(), TEXT("/Game/Items/Blueprint/BP_Fire-Extinguisher.BP_Fire-Extinguisher_C"), false },
+		{ AGasCanItem::StaticClass(), TEXT("/Game/Items/Blueprint/BP_GasCan.BP_GasCan_C"), false },
+		{ AMatchesItem::StaticClass(), TEXT("/Game/Items/Blueprint/BP_Matches.BP_Matches_C"), false },
+	};
+
+	FActorSpawnParameters spawnParams;
+	spawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	const FTransform transform(FVector(0.f, 0.f, 200.f));
+
+	ALlamaLlamaCharacter* llama = World->SpawnActor<ALlamaLlamaCharacter>(llamaClass, transform, spawnParams);
+	if (llama == nullptr)
+		return;
+
+	//the secondary follows a shot, so the revolver reloads instead of failing on a full cylinder
+	auto timeActions = [&](UClass* itemClass, bool bSecondary, double& outPrimaryUs, double& outSecondaryUs)
+	{
+		uint64 primaryCycles = 0;
+		uint64 secondaryCycles = 0;
+		for (int32 i = 0; i < calls; ++i)
+		{
+			ABaseItem* item = World->SpawnActor<ABaseItem>(itemClass, transform, spawnParams);
+			if (item == nullptr)
+				return false;
+
+			llama->CarryItem(item);
+
+			uint64 start = FPlatformTime::Cycles64();
+			item->PrimaryAction();
+			primaryCycles += FPlatformTime::Cycles64() - start;
+
+			if (bSecondary)
+			{
+				start = FPlatformTime::Cycles64();
+				item->SecondaryAction();
+				secondaryCycles += FPlatformTime::Cycles64() - start;
+			}
+
+			llama->ReleaseItem(item);
+			item->Destroy();
+		}
+		outPrimaryUs = FPlatformTime::ToMilliseconds64(primaryCycles) * 1000.0 / calls;
+		outSecondaryUs = FPlatformTime::ToMilliseconds64(secondaryCycles) * 1000.0 / calls;
+		return true;
+	};
+
+	for (const FItemPair& pair : pairs)
+	{
+		double nativePrimaryUs = 0.0;
+		double nativeSecondaryUs = 0.0;
+		if (!timeActions(pair.nativeClass, pair.bSecondary, nativePrimaryUs, nativeSecondaryUs))
+			continue;
+
+		const FString nativeTimes = pair.bSecondary
+			? FString::Printf(TEXT("native primary %.3f us secondary %.3f us"), nativePrimaryUs, nativeSecondaryUs)
+			: FString::Printf(TEXT("native primary %.3f us"), nativePrimaryUs);
+
+		double blueprintPrimaryUs = 0.0;
+		double blueprintSecondaryUs = 0.0;
+		UClass* blueprintClass = FSoftClassPath(pair.blueprintPath).TryLoadClass<ABaseItem>();
+		if (blueprintClass && timeActions(blueprintClass, pair.bSecondary, blueprintPrimaryUs, blueprintSecondaryUs))
+		{
+			const FString blueprintTimes = pair.bSecondary
+				? FString::Printf(TEXT("primary %.3f us secondary %.3f us"), blueprintPrimaryUs, blueprintSecondaryUs)
+				: FString::Printf(TEXT("primary %.3f us"), blueprintPrimaryUs);
+			UE_LOG(LogTemp, Log, TEXT("Llama.BenchItemActions %s: %s, %s %s"),
+				*pair.nativeClass->GetName(), *nativeTimes, *blueprintClass->GetName(), *blueprintTimes);
+		}
+		else
+		{
+			UE_LOG(LogTemp, Log, TEXT("Llama.BenchItemActions %s: %s, couldn't load %s"),
+				*pair.nativeClass->GetName(), *nativeTimes, pair.blueprintPath);
+		}
+	}
+
+	llama->Destroy();
+}
+
+static FAutoConsoleCommandWithWorldAndArgs BenchItemActionsCommand(
+	TEXT("Llama.BenchItemActions"),
+	TEXT("Times item actions per call, native items against the BP_ items. Optional arg: calls per item (1000)"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&BenchItemActions));
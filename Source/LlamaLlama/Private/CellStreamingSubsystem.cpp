@@ -0,0 +1,255 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "../Public/CellStreamingSubsystem.h"
+#include "../Public/BaseItem.h"
+#include "../LlamaLlama.h"
+
+#include "Engine/LevelStreaming.h"
+#include "Engine/GameInstance.h"
+#include "Engine/Engine.h"
+#include "GameFramework/PlayerController.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformMemory.h"
+#include "Misc/PackageName.h"
+
+DECLARE_CYCLE_STAT(TEXT("Cell streaming update"), STAT_LlamaCellStreamingUpdate, STATGROUP_Llama);
+
+UCellStreamingSubsystem* UCellStreamingSubsystem::Get(const UObject* worldContext)
+{
+	UWorld* world = GEngine ? GEngine->GetWorldFromContextObject(worldContext, EGetWorldErrorMode::ReturnNull) : nullptr;
+	UGameInstance* gameInstance = world ? world->GetGameInstance() : nullptr;
+	return gameInstance ? gameInstance->GetSubsystem<UCellStreamingSubsystem>() : nullptr;
+}
+
+void UCellStreamingSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	postWorldInitHandle = FWorldDelegates::OnPostWorldInitialization.AddUObject(this, &UCellStreamingSubsystem::OnPostWorldInitialization);
+	worldCleanupHandle = FWorldDelegates::OnWorldCleanup.AddUObject(this, &UCellStreamingSubsystem::OnWorldCleanup);
+}
+
+void UCellStreamingSubsystem::Deinitialize()
+{
+	FWorldDelegates::OnPostWorldInitialization.Remove(postWorldInitHandle);
+	FWorldDelegates::OnWorldCleanup.Remove(worldCleanupHandle);
+
+	cells.Empty();
+	cellIndices.Empty();
+
+	Super::Deinitialize();
+}
+
+void UCellStreamingSubsystem::OnPostWorldInitialization(UWorld* world, const UWorld::InitializationValues initValues)
+{
+	if (world && world->IsGameWorld() && world->GetGameInstance() == GetGameInstance())
+	{
+		GatherCells(world);
+	}
+}
+
+void UCellStreamingSubsystem::OnWorldCleanup(UWorld* world, bool bSessionEnded, bool bCleanupResources)
+{
+	if (world && world == cellWorld.Get())
+	{
+		cellWorld.Reset();
+		cells.Reset();
+		cellIndices.Reset();
+	}
+}
+
+void UCellStreamingSubsystem::GatherCells(UWorld* world)
+{
+	cellWorld = world;
+	cells.Reset();
+	cellIndices.Reset();
+	cellLoadSeconds.Reset();
+	updateElapsed = updateInterval;
+	bFirstUpdate = true;
+
+	//servers own the item physics and every llama's movement, they need collision everywhere
+	const ENetMode netMode = world->GetNetMode();
+	bLoadEverything = netMode == NM_DedicatedServer || netMode == NM_ListenServer;
+
+	for (ULevelStreaming* level : world->GetStreamingLevels())
+	{
+		if (level == nullptr)
+			continue;
+
+		//<Map>_Cell_<x>_<y>
+		const FString name = FPackageName::GetShortName(level->GetWorldAssetPackageName());
+		const int32 cellTag = name.Find(TEXT("_Cell_"), ESearchCase::IgnoreCase, ESearchDir::FromEnd);
+		if (cellTag == INDEX_NONE)
+			continue;
+
+		FString xString, yString;
+		if (!name.Mid(cellTag + 6).Split(TEXT("_"), &xString, &yString) || !xString.IsNumeric() || !yString.IsNumeric())
+			continue;
+
+		FStreamingCell& cell = cells.AddDefaulted_GetRef();
+		cell.level = level;
+		cell.coord = FIntPoint(FCString::Atoi(*xString), FCString::Atoi(*yString));
+		const FVector2D min = cellOrigin + FVector2D(cell.coord) * cellSize;
+		cell.bounds = FBox2D(min, min + FVector2D(cellSize, cellSize));
+		cellIndices.Add(cell.coord, cells.Num() - 1);
+	}
+
+	UE_CLOG(cells.Num() > 0, LogTemp, Log, TEXT("Cell streaming: %d cells in %s, %s"),
+		cells.Num(), *world->GetMapName(), bLoadEverything ? TEXT("loading all of them") : TEXT("streaming around the local llama"));
+}
+
+bool UCellStreamingSubsystem::IsLocationStreamedIn(const FVector& location) const
+{
+	const FIntPoint coord(FMath::FloorToInt((location.X - cellOrigin.X) / cellSize), FMath::FloorToInt((location.Y - cellOrigin.Y) / cellSize));
+	const int32* index = cellIndices.Find(coord);
+	if (index == nullptr)
+		return true;
+
+	const ULevelStreaming* level = cells[*index].level.Get();
+	return level && level->IsLevelVisible();
+}
+
+void UCellStreamingSubsystem::Tick(float DeltaTime)
+{
+	UWorld* world = cellWorld.Get();
+	if (world == nullptr)
+		return;
+
+	//finished loads, checked every frame so the times are accurate
+	const double now = FPlatformTime::Seconds();
+	for (FStreamingCell& cell : cells)
+	{
+		if (cell.loadRequestTime > 0.0 && cell.level.IsValid() && cell.level->IsLevelVisible())
+		{
+			cellLoadSeconds.Add(cell.coord, now - cell.loadRequestTime);
+			cell.loadRequestTime = 0.0;
+		}
+	}
+
+	updateElapsed += DeltaTime;
+	if (updateElapsed < updateInterval)
+		return;
+	updateElapsed = 0.f;
+
+	LLAMA_SCOPE_CYCLE_COUNTER(STAT_LlamaCellStreamingUpdate);
+
+	UpdateWantedCells();
+	UpdateItems();
+}
+
+void UCellStreamingSubsystem::UpdateWantedCells()
+{
+	UWorld* world = cellWorld.Get();
+
+	TArray<FVector2D, TInlineAllocator<4>> viewLocations;
+	if (!bLoadEverything)
+	{
+		for (FConstPlayerControllerIterator It = world->GetPlayerControllerIterator(); It; ++It)
+		{
+			APlayerController* controller = It->Get();
+			if (controller && controller->IsLocalController() && controller->GetPawn())
+			{
+				viewLocations.Add(FVector2D(controller->GetPawn()->GetActorLocation()));
+			}
+		}
+
+		//nothing to stream around yet, keep whatever is there
+		if (viewLocations.Num() == 0)
+			return;
+	}
+
+	const float loadRadiusSquared = FMath::Square(loadRadius);
+	const float unloadRadiusSquared = FMath::Square(unloadRadius);
+
+	int32 requested = 0;
+	for (FStreamingCell& cell : cells)
+	{
+		ULevelStreaming* level = cell.level.Get();
+		if (level == nullptr)
+			continue;
+
+		bool bWanted = bLoadEverything;
+		for (const FVector2D& viewLocation : viewLocations)
+		{
+			const float distanceSquared = cell.bounds.ComputeSquaredDistanceToPoint(viewLocation);
+			if (distanceSquared < (cell.bWanted ? unloadRadiusSquared : loadRadiusSquared))
+			{
+				bWanted = true;
+				break;
+			}
+		}
+
+		if (bWanted == cell.bWanted)
+			continue;
+
+		cell.bWanted = bWanted;
+		level->SetShouldBeLoaded(bWanted);
+		level->SetShouldBeVisible(bWanted);
+		cell.loadRequestTime = bWanted && !level->IsLevelVisible() ? FPlatformTime::Seconds() : 0.0;
+		requested += bWanted ? 1 : 0;
+	}
+
+	//the first cells go in before anything moves, nobody should fall through the floor while they stream
+	if (bFirstUpdate && requested > 0)
+	{
+		world->FlushLevelStreaming(EFlushLevelStreamingType::Full);
+	}
+	bFirstUpdate = false;
+}
+
+void UCellStreamingSubsystem::UpdateItems()
+{
+	//servers have every cell, only clients can have items over a hole
+	if (bLoadEverything)
+		return;
+
+	for (TActorIterator<ABaseItem> It(cellWorld.Get()); It; ++It)
+	{
+		It->SetStreamedIn(IsLocationStreamedIn(It->GetActorLocation()));
+	}
+}
+
+void UCellStreamingSubsystem::LogStreamingStats() const
+{
+	int32 loaded = 0;
+	for (const FStreamingCell& cell : cells)
+	{
+		const ULevelStreaming* level = cell.level.Get();
+		if (level && level->IsLevelVisible())
+		{
+			++loaded;
+			const float* seconds = cellLoadSeconds.Find(cell.coord);
+			UE_LOG(LogTemp, Log, TEXT("  cell %d_%d loaded%s"), cell.coord.X, cell.coord.Y,
+				seconds ? *FString::Printf(TEXT(" in %.1f ms"), *seconds * 1000.f) : TEXT(""));
+		}
+	}
+
+	const FPlatformMemoryStats memory = FPlatformMemory::GetStats();
+	UE_LOG(LogTemp, Log, TEXT("Cell streaming: %d/%d cells loaded, %.1f MB resident, %.1f MB peak"),
+		loaded, cells.Num(), memory.UsedPhysical / (1024.0 * 1024.0), memory.PeakUsedPhysical / (1024.0 * 1024.0));
+}
+
+TStatId UCellStreamingSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UCellStreamingSubsystem, STATGROUP_Tickables);
+}
+
+UWorld* UCellStreamingSubsystem::GetTickableGameObjectWorld() const
+{
+	return cellWorld.Get();
+}
+
+static void LogCellStreaming(const TArray<FString>& Args, UWorld* World)
+{
+	if (UCellStreamingSubsystem* streaming = UCellStreamingSubsystem::Get(World))
+	{
+		streaming->LogStreamingStats();
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs CellStreamingCommand(
+	TEXT("Llama.Streaming"),
+	TEXT("Logs the loaded cells with their load times and the resident and peak memory"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&LogCellStreaming));
@@ -0,0 +1,308 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "../Public/EventJournal.h"
+
+#include "HAL/PlatformFilemanager.h"
+#include "HAL/FileManager.h"
+#include "HAL/RunnableThread.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/CommandLine.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Engine/World.h"
+#include "Engine/GameInstance.h"
+#include "Engine/Engine.h"
+
+int32 FLlamaEventJournal::numRecording = 0;
+
+void FLlamaJournalRecord::Serialize(uint8* out) const
+{
+	out[0] = (uint8)type;
+	FMemory::Memcpy(out + 1, &serverTime, 4);
+	FMemory::Memcpy(out + 5, &actorId, 4);
+	FMemory::Memcpy(out + 9, &otherId, 4);
+	FMemory::Memcpy(out + 13, &location.X, 4);
+	FMemory::Memcpy(out + 17, &location.Y, 4);
+	FMemory::Memcpy(out + 21, &location.Z, 4);
+}
+
+bool FLlamaJournalRecord::Deserialize(const uint8* in, int32 size, FLlamaJournalRecord& outRecord)
+{
+	//newer versions may append fields, older readers skip what they don't know
+	if (size < SerializedSize)
+		return false;
+
+	outRecord.type = (ELlamaJournalEvent)in[0];
+	FMemory::Memcpy(&outRecord.serverTime, in + 1, 4);
+	FMemory::Memcpy(&outRecord.actorId, in + 5, 4);
+	FMemory::Memcpy(&outRecord.otherId, in + 9, 4);
+	FMemory::Memcpy(&outRecord.location.X, in + 13, 4);
+	FMemory::Memcpy(&outRecord.location.Y, in + 17, 4);
+	FMemory::Memcpy(&outRecord.location.Z, in + 21, 4);
+	return true;
+}
+
+const TCHAR* FLlamaJournalRecord::GetTypeName(ELlamaJournalEvent type)
+{
+	switch (type)
+	{
+	case ELlamaJournalEvent::PickUp:				return TEXT("PickUp");
+	case ELlamaJournalEvent::Toss:					return TEXT("Toss");
+	case ELlamaJournalEvent::Push:					return TEXT("Push");
+	case ELlamaJournalEvent::PushHit:				return TEXT("PushHit");
+	case ELlamaJournalEvent::Stun:					return TEXT("Stun");
+	case ELlamaJournalEvent::ItemPrimaryAction:		return TEXT("ItemPrimaryAction");
+	case ELlamaJournalEvent::ItemSecondaryAction:	return TEXT("ItemSecondaryAction");
+	default:										return TEXT("Unknown");
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+// FLlamaEventJournal
+
+FLlamaEventJournal* FLlamaEventJournal::StartRecording(const FString& path)
+{
+	FLlamaEventJournal* journal = new FLlamaEventJournal(path, 16384);
+	journal->thread = FRunnableThread::Create(journal, TEXT("LlamaEventJournal"), 0, TPri_BelowNormal);
+	if (journal->thread == nullptr)
+	{
+		delete journal;
+		return nullptr;
+	}
+
+	++numRecording;
+	return journal;
+}
+
+void FLlamaEventJournal::StopRecording(FLlamaEventJournal* journal)
+{
+	if (journal == nullptr)
+		return;
+
+	--numRecording;
+
+	//the thread drains what's left before it returns
+	journal->thread->Kill(true);
+	UE_CLOG(journal->GetDroppedCount() > 0, LogTemp, Warning, TEXT("Event journal dropped %d events, the writer couldn't keep up"), journal->GetDroppedCount());
+	delete journal;
+}
+
+void FLlamaEventJournal::RecordInWorld(const UWorld* world, ELlamaJournalEvent type, const AActor* actor, const AActor* other, const FVector& location)
+{
+	//clients replaying predicted actions must never end up in a server's journal
+	if (world == nullptr || world->IsNetMode(NM_Client))
+		return;
+
+	UGameInstance* gameInstance = world->GetGameInstance();
+	UEventJournalSubsystem* journalSubsystem = gameInstance ? gameInstance->GetSubsystem<UEventJournalSubsystem>() : nullptr;
+	if (FLlamaEventJournal* journal = journalSubsystem ? journalSubsystem->GetJournal() : nullptr)
+	{
+		journal->Push(type, world->GetTimeSeconds(), actor, other, location);
+	}
+}
+
+FLlamaEventJournal::FLlamaEventJournal(const FString& inPath, uint32 capacity)
+	: path(inPath)
+	, queue(capacity)
+{
+}
+
+FLlamaEventJournal::~FLlamaEventJournal()
+{
+	delete thread;
+	delete file;
+}
+
+void FLlamaEventJournal::Push(ELlamaJournalEvent type, float serverTime, const AActor* actor, const AActor* other, const FVector& location)
+{
+	FLlamaJournalRecord record;
+	record.type = type;
+	record.serverTime = serverTime;
+	record.actorId = actor ? actor->GetUniqueID() : 0;
+	record.otherId = other ? other->GetUniqueID() : 0;
+	record.location = location;
+
+	if (!queue.Enqueue(record))
+	{
+		droppedCount.Increment();
+	}
+}
+
+int32 FLlamaEventJournal::Drain(TArray<uint8>& buffer)
+{
+	int32 drained = 0;
+	FLlamaJournalRecord record;
+	while (queue.Dequeue(record))
+	{
+		const int32 offset = buffer.AddUninitialized(1 + FLlamaJournalRecord::SerializedSize);
+		buffer[offset] = (uint8)FLlamaJournalRecord::SerializedSize;
+		record.Serialize(buffer.GetData() + offset + 1);
+		++drained;
+	}
+	return drained;
+}
+
+bool FLlamaEventJournal::Init()
+{
+	file = FPlatformFileManager::Get().GetPlatformFile().OpenWrite(*path);
+	if (file == nullptr)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Event journal couldn't open %s"), *path);
+		return false;
+	}
+
+	file->Write((const uint8*)&FileMagic, sizeof(FileMagic));
+	return true;
+}
+
+uint32 FLlamaEventJournal::Run()
+{
+	const double flushInterval = 1.0;
+	double lastFlush = FPlatformTime::Seconds();
+
+	TArray<uint8> buffer;
+	while (!bStopping)
+	{
+		buffer.Reset();
+		if (Drain(buffer) > 0)
+		{
+			file->Write(buffer.GetData(), buffer.Num());
+		}
+		else
+		{
+			FPlatformProcess::Sleep(0.01f);
+		}
+
+		if (FPlatformTime::Seconds() - lastFlush >= flushInterval)
+		{
+			file->Flush();
+			lastFlush = FPlatformTime::Seconds();
+		}
+	}
+
+	buffer.Reset();
+	if (Drain(buffer) > 0)
+	{
+		file->Write(buffer.GetData(), buffer.Num());
+	}
+	file->Flush();
+
+	return 0;
+}
+
+void FLlamaEventJournal::Stop()
+{
+	bStopping = true;
+}
+
+bool FLlamaEventJournal::ReadFile(const FString& path, TArray<FLlamaJournalRecord>& outRecords)
+{
+	TArray<uint8> data;
+	if (!FFileHelper::LoadFileToArray(data, *path))
+		return false;
+
+	uint32 magic = 0;
+	if (data.Num() < (int32)sizeof(magic))
+		return false;
+	FMemory::Memcpy(&magic, data.GetData(), sizeof(magic));
+	if (magic != FileMagic)
+		return false;
+
+	//a crash can leave a partial record at the end, stop there
+	int32 offset = sizeof(magic);
+	while (offset < data.Num())
+	{
+		const int32 size = data[offset];
+		if (offset + 1 + size > data.Num())
+			break;
+
+		FLlamaJournalRecord record;
+		if (FLlamaJournalRecord::Deserialize(data.GetData() + offset + 1, size, record))
+		{
+			outRecords.Add(record);
+		}
+		offset += 1 + size;
+	}
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// UEventJournalSubsystem
+
+void UEventJournalSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	FString path;
+	const bool bEnabled = FParse::Value(FCommandLine::Get(), TEXT("LlamaJournal="), path) || FParse::Param(FCommandLine::Get(), TEXT("LlamaJournal"));
+	if (!bEnabled)
+		return;
+
+	if (path.IsEmpty())
+	{
+		path = FString::Printf(TEXT("Journal/%s.lljournal"), *FDateTime::Now().ToString());
+	}
+	if (FPaths::IsRelative(path))
+	{
+		path = FPaths::ProjectSavedDir() / path;
+	}
+
+
+	//PIE instances share the command line, give each its own file
+	const FWorldContext* worldContext = GetGameInstance()->GetWorldContext();
+	if (worldContext && worldContext->PIEInstance != INDEX_NONE)
+	{
+		path = FPaths::GetPath(path) / FString::Printf(TEXT("%s_PIE%d%s"), *FPaths::GetBaseFilename(path), worldContext->PIEInstance, *FPaths::GetExtension(path, true));
+	}
+
+	IFileManager::Get().MakeDirectory(*FPaths::GetPath(path), true);
+	journal = FLlamaEventJournal::StartRecording(path);
+	UE_CLOG(journal, LogTemp, Log, TEXT("Event journal recording to %s"), *path);
+}
+
+void UEventJournalSubsystem::Deinitialize()
+{
+	FLlamaEventJournal::StopRecording(journal);
+	journal = nullptr;
+
+	Super::Deinitialize();
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Benchmark
+
+/** Times Record on the game thread with a consumer draining on the side. Optional arg: events (100000) */
+static void BenchJournal(const TArray<FString>& Args)
+{
+	const int32 events = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 100000;
+
+	FLlamaEventJournal journal(FString(), 16384);
+	TArray<uint8> buffer;
+
+	//batches smaller than the ring, drained outside the timing like the writer thread would
+	const int32 batchSize = 1024;
+	double pushSeconds = 0.0;
+	for (int32 first = 0; first < events; first += batchSize)
+	{
+		const int32 last = FMath::Min(first + batchSize, events);
+
+		const double start = FPlatformTime::Seconds();
+		for (int32 i = first; i < last; ++i)
+		{
+			journal.Push(ELlamaJournalEvent::PickUp, i * 0.016f, nullptr, nullptr, FVector(i, i, i));
+		}
+		pushSeconds += FPlatformTime::Seconds() - start;
+
+		buffer.Reset();
+		journal.Drain(buffer);
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("Llama.BenchJournal %d events: %.1f ns per event, %d dropped"),
+		events, pushSeconds * 1000000000.0 / events, journal.GetDroppedCount());
+}
+
+static FAutoConsoleCommandWithArgs BenchJournalCommand(
+	TEXT("Llama.BenchJournal"),
+	TEXT("Times recording a journal event on the calling thread. Optional arg: events (100000)"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BenchJournal));
@@ -0,0 +1,40 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "../Public/ExtinguisherItem.h"
+#include "../Public/FireFieldSubsystem.h"
+#include "../LlamaLlamaCharacter.h"
+
+#include "Engine/World.h"
+
+AExtinguisherItem::AExtinguisherItem()
+{
+	sprayLength = 400.f;
+	sprayRadius = 100.f;
+	extinguishAmount = 1.f;
+	sprayCooldown = 0.5f;
+	sprayMontage = nullptr;
+}
+
+void AExtinguisherItem::NativePrimaryAction()
+{
+	const float now = GetWorld()->GetTimeSeconds();
+	if (carrier == nullptr || now < nextSprayTime)
+		return;
+
+	nextSprayTime = now + sprayCooldown;
+	carrier->PlayReplicatedMontage(sprayMontage);
+	PlayUseEffects();
+
+	UFireFieldSubsystem* fireField = UFireFieldSubsystem::Get(this);
+	if (fireField == nullptr || !fireField->HasField())
+		return;
+
+	const FVector start = carrier->GetActorLocation();
+	const FVector forward = carrier->GetActorForwardVector();
+	const float step = FMath::Max(sprayRadius, 1.f);
+	for (float distance = step; distance <= sprayLength; distance += step)
+	{
+		fireField->Extinguish(start + forward * distance, sprayRadius, extinguishAmount);
+	}
+}
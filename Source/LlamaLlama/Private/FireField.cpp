@@ -0,0 +1,434 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "../Public/FireField.h"
+
+#include "Math/VectorRegister.h"
+#include "Async/ParallelFor.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/AutomationTest.h"
+
+void FFireField::Init(int32 inWidth, int32 inHeight)
+{
+	width = FMath::Max(inWidth, 1);
+	height = FMath::Max(inHeight, 1);
+	pitch = Align(width, 4) + 2;
+
+	const int32 numCells = pitch * (height + 2);
+	fuel.SetNumZeroed(numCells);
+	heat.SetNumZeroed(numCells);
+	burning.SetNumZeroed(numCells);
+	heatScratch.SetNumZeroed(numCells);
+
+	columnMask.SetNumUninitialized(pitch - 2);
+	for (int32 x = 0; x < columnMask.Num(); ++x)
+	{
+		columnMask[x] = x < width ? 1.f : 0.f;
+	}
+
+	netStates.SetNumZeroed(width * height);
+	dirtyMinX.Init(width, height);
+	dirtyMaxX.Init(-1, height);
+}
+
+void FFireField::Reset()
+{
+	FMemory::Memzero(fuel.GetData(), fuel.Num() * sizeof(float));
+	FMemory::Memzero(heat.GetData(), heat.Num() * sizeof(float));
+	FMemory::Memzero(burning.GetData(), burning.Num() * sizeof(float));
+	FMemory::Memzero(heatScratch.GetData(), heatScratch.Num() * sizeof(float));
+
+	for (int32 y = 0; y < height; ++y)
+	{
+		UpdateNetStates(y, 0, width - 1);
+	}
+}
+
+void FFireField::AddFuel(int32 x, int32 y, float amount)
+{
+	if (IsValidCell(x, y))
+	{
+		float& cellFuel = fuel[Index(x, y)];
+		cellFuel = FMath::Clamp(cellFuel + amount, 0.f, params.maxFuel);
+		UpdateNetStates(y, x, x);
+	}
+}
+
+void FFireField::AddHeat(int32 x, int32 y, float amount)
+{
+	if (IsValidCell(x, y))
+	{
+		float& cellHeat = heat[Index(x, y)];
+		cellHeat = FMath::Clamp(cellHeat + amount, 0.f, params.maxHeat);
+	}
+}
+
+void FFireField::Extinguish(int32 x, int32 y, float amount)
+{
+	if (IsValidCell(x, y))
+	{
+		const int32 index = Index(x, y);
+		heat[index] = FMath::Max(heat[index] - amount, 0.f);
+		burning[index] = 0.f;
+		UpdateNetStates(y, x, x);
+	}
+}
+
+void FFireField::Step(float deltaTime, bool bParallel)
+{
+	//above 1 the diffusion overshoots and the field oscillates
+	const float diffuseDt = FMath::Min(params.diffusion * deltaTime, 1.f);
+	const float coolDt = params.cooling * deltaTime;
+	const float burnHeatDt = params.burnHeat * deltaTime;
+	const float burnRateDt = params.burnRate * deltaTime;
+
+	const float* heatIn = heat.GetData();
+	float* heatOut = heatScratch.GetData();
+
+	//rows only write their own cells and read heat from the previous step, so they can run in any order
+	ParallelFor(height, [&](int32 y)
+	{
+		StepRow(y, heatIn, heatOut, diffuseDt, coolDt, burnHeatDt, burnRateDt);
+	}, !bParallel);
+
+	//the ghost border is never written so it stays cold in both buffers
+	Swap(heat, heatScratch);
+}
+
+void FFireField::StepRow(int32 y, const float* heatIn, float* heatOut, float diffuseDt, float coolDt, float burnHeatDt, float burnRateDt)
+{
+	const VectorRegister zero = VectorZero();
+	const VectorRegister one = VectorOne();
+	const VectorRegister quarter = VectorSetFloat1(0.25f);
+	const VectorRegister diffuse = VectorSetFloat1(diffuseDt);
+	const VectorRegister cool = VectorSetFloat1(coolDt);
+	const VectorRegister burnHeat = VectorSetFloat1(burnHeatDt);
+	const VectorRegister burnRate = VectorSetFloat1(burnRateDt);
+	const VectorRegister ignition = VectorSetFloat1(params.ignitionHeat);
+	const VectorRegister maxHeat = VectorSetFloat1(params.maxHeat);
+
+	float* rowFuel = fuel.GetData();
+	float* rowBurning = burning.GetData();
+	const float* mask = columnMask.GetData();
+
+	const int32 paddedWidth = pitch - 2;
+	for (int32 x = 0; x < paddedWidth; x += 4)
+	{
+		const int32 index = Index(x, y);
+
+		const VectorRegister columnsInField = VectorLoad(mask + x);
+		const VectorRegister cellHeat = VectorLoad(heatIn + index);
+		const VectorRegister left = VectorLoad(heatIn + index - 1);
+		const VectorRegister right = VectorLoad(heatIn + index + 1);
+		const VectorRegister up = VectorLoad(heatIn + index - pitch);
+		const VectorRegister down = VectorLoad(heatIn + index + pitch);
+		const VectorRegister neighborAverage = VectorMultiply(VectorAdd(VectorAdd(left, right), VectorAdd(up, down)), quarter);
+
+		const VectorRegister cellFuel = VectorLoad(rowFuel + index);
+		const VectorRegister cellBurning = VectorLoad(rowBurning + index);
+
+		VectorRegister newHeat = VectorAdd(cellHeat, VectorMultiply(VectorSubtract(neighborAverage, cellHeat), diffuse));
+		newHeat = VectorSubtract(newHeat, VectorMultiply(cellHeat, cool));
+		newHeat = VectorAdd(newHeat, VectorMultiply(cellBurning, burnHeat));
+		newHeat = VectorMin(VectorMax(newHeat, zero), maxHeat);
+
+		//padding columns never get fuel, zeroing their heat keeps them from storing heat and leaking it back
+		newHeat = VectorMultiply(newHeat, columnsInField);
+
+		const VectorRegister newFuel = VectorMax(VectorSubtract(cellFuel, VectorMultiply(cellBurning, burnRate)), zero);
+
+		const VectorRegister ignites = VectorBitwiseAnd(VectorCompareGE(newHeat, ignition), VectorCompareGT(newFuel, zero));
+		const VectorRegister newBurning = VectorSelect(ignites, columnsInField, zero);
+
+		VectorStore(newHeat, heatOut + index);
+		VectorStore(newFuel, rowFuel + index);
+		VectorStore(newBurning, rowBurning + index);
+	}
+
+	UpdateNetStates(y, 0, width - 1);
+}
+
+void FFireField::StepScalar(float deltaTime)
+{
+	const float diffuseDt = FMath::Min(params.diffusion * deltaTime, 1.f);
+	const float coolDt = params.cooling * deltaTime;
+	const float burnHeatDt = params.burnHeat * deltaTime;
+	const float burnRateDt = params.burnRate * deltaTime;
+
+	for (int32 y = 0; y < height; ++y)
+	{
+		for (int32 x = 0; x < width; ++x)
+		{
+			const int32 index = Index(x, y);
+			const float cellHeat = heat[index];
+			const float neighborAverage = (heat[index - 1] + heat[index + 1] + heat[index - pitch] + heat[index + pitch]) * 0.25f;
+
+			float newHeat = cellHeat + (neighborAverage - cellHeat) * diffuseDt;
+			newHeat -= cellHeat * coolDt;
+			newHeat += burning[index] * burnHeatDt;
+			newHeat = FMath::Clamp(newHeat, 0.f, params.maxHeat);
+
+			const float newFuel = FMath::Max(fuel[index] - burning[index] * burnRateDt, 0.f);
+
+			heatScratch[index] = newHeat;
+			fuel[index] = newFuel;
+			burning[index] = newHeat >= params.ignitionHeat && newFuel > 0.f ? 1.f : 0.f;
+		}
+
+		UpdateNetStates(y, 0, width - 1);
+	}
+
+	Swap(heat, heatScratch);
+}
+
+int32 FFireField::CountBurning() const
+{
+	int32 count = 0;
+	for (int32 y = 0; y < height; ++y)
+	{
+		for (int32 x = 0; x < width; ++x)
+		{
+			count += burning[Index(x, y)] > 0.f ? 1 : 0;
+		}
+	}
+	return count;
+}
+
+uint8 FFireField::ComputeNetState(int32 x, int32 y) const
+{
+	const int32 index = Index(x, y);
+	const uint8 quantizedFuel = (uint8)FMath::Clamp(FMath::RoundToInt(fuel[index] / params.maxFuel * 127.f), 0, 127);
+	return quantizedFuel | (burning[index] > 0.f ? BurningBit : 0);
+}
+
+void FFireField::UpdateNetStates(int32 y, int32 minX, int32 maxX)
+{
+	uint8* rowStates = netStates.GetData() + y * width;
+	int32& rowDirtyMin = dirtyMinX[y];
+	int32& rowDirtyMax = dirtyMaxX[y];
+
+	for (int32 x = minX; x <= maxX; ++x)
+	{
+		const uint8 state = ComputeNetState(x, y);
+		if (state != rowStates[x])
+		{
+			rowStates[x] = state;
+			rowDirtyMin = FMath::Min(rowDirtyMin, x);
+			rowDirtyMax = FMath::Max(rowDirtyMax, x);
+		}
+	}
+}
+
+bool FFireField::GetNetDirtyRect(FIntRect& outRect) const
+{
+	outRect = FIntRect(width, height, -1, -1);
+	for (int32 y = 0; y < height; ++y)
+	{
+		if (dirtyMinX[y] <= dirtyMaxX[y])
+		{
+			outRect.Min.X = FMath::Min(outRect.Min.X, dirtyMinX[y]);
+			outRect.Max.X = FMath::Max(outRect.Max.X, dirtyMaxX[y]);
+			outRect.Min.Y = FMath::Min(outRect.Min.Y, y);
+			outRect.Max.Y = y;
+		}
+	}
+	return outRect.Max.Y >= 0;
+}
+
+void FFireField::ClearNetDirty()
+{
+	for (int32 y = 0; y < height; ++y)
+	{
+		dirtyMinX[y] = width;
+		dirtyMaxX[y] = -1;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Helpers
+
+/** Fuel everywhere, a handful of lit cells, roughly what a map looks like mid fire */
+static void SeedFireField(FFireField& field, int32 seed)
+{
+	FRandomStream random(seed);
+	for (int32 y = 0; y < field.GetHeight(); ++y)
+	{
+		for (int32 x = 0; x < field.GetWidth(); ++x)
+		{
+			field.AddFuel(x, y, random.FRandRange(0.2f, 1.f));
+		}
+	}
+
+	for (int32 i = 0; i < field.GetWidth() * field.GetHeight() / 200; ++i)
+	{
+		field.AddHeat(random.RandRange(0, field.GetWidth() - 1), random.RandRange(0, field.GetHeight() - 1), 1.f);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Tests
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLlamaFireFieldTest, "LlamaLlama.FireField",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+/**
+ * Checks the rules and the vector kernel without a world: fire spreads through fuel, stays put without fuel,
+ * goes out when extinguished, the padding columns don't leak heat, the vector and scalar kernels agree on an
+ * odd sized random field and the dirty rectangle covers exactly the cells that changed.
+ */
+bool FLlamaFireFieldTest::RunTest(const FString& Parameters)
+{
+	const float dt = 0.1f;
+
+	{
+		FFireField field;
+		field.Init(16, 16);
+		for (int32 x = 0; x < 16; ++x)
+		{
+			field.AddFuel(x, 8, 1.f);
+		}
+		field.AddHeat(0, 8, 1.f);
+		for (int32 i = 0; i < 100; ++i)
+		{
+			field.Step(dt);
+		}
+		TestTrue(TEXT("Fire spreads along a fuel line"), field.IsBurning(8, 8));
+		TestFalse(TEXT("Cells without fuel never burn"), field.IsBurning(8, 2));
+	}
+
+	{
+		FFireField field;
+		field.Init(8, 8);
+		field.AddFuel(4, 4, 1.f);
+		field.AddHeat(4, 4, 1.f);
+		field.Step(dt);
+		TestTrue(TEXT("A hot fueled cell ignites"), field.IsBurning(4, 4));
+		field.Extinguish(4, 4, 1.f);
+		field.Step(dt);
+		TestFalse(TEXT("An extinguished cell stops burning"), field.IsBurning(4, 4));
+	}
+
+	{
+		FFireField field;
+		field.Init(4, 4);
+		field.AddFuel(1, 1, 0.05f);
+		field.AddHeat(1, 1, 1.f);
+		for (int32 i = 0; i < 50; ++i)
+		{
+			field.Step(dt);
+		}
+		TestFalse(TEXT("A cell burns out when its fuel runs out"), field.IsBurning(1, 1));
+		TestEqual(TEXT("Fuel of a burnt out cell"), field.GetFuel(1, 1), 0.f);
+	}
+
+	//5 wide is padded to 8, the right edge must lose heat to the padding like the left edge does to the ghost border
+	for (int32 parallel = 0; parallel < 2; ++parallel)
+	{
+		FFireField field;
+		field.Init(5, 5);
+		field.params.cooling = 0.f;
+		field.AddHeat(2, 2, 1.f);
+		for (int32 i = 0; i < 20; ++i)
+		{
+			field.Step(dt, parallel != 0);
+		}
+		TestEqual(TEXT("Heat at the padded edge matches the ghost edge"), field.GetHeat(4, 2), field.GetHeat(0, 2), 1e-5f);
+	}
+
+	{
+		FFireField vectorField;
+		FFireField scalarField;
+		vectorField.Init(37, 23);
+		scalarField.Init(37, 23);
+		SeedFireField(vectorField, 7);
+		SeedFireField(scalarField, 7);
+
+		for (int32 i = 0; i < 20; ++i)
+		{
+			vectorField.Step(dt);
+			scalarField.StepScalar(dt);
+		}
+
+		float maxError = 0.f;
+		int32 burningMismatches = 0;
+		for (int32 y = 0; y < 23; ++y)
+		{
+			for (int32 x = 0; x < 37; ++x)
+			{
+				maxError = FMath::Max(maxError, FMath::Abs(vectorField.GetHeat(x, y) - scalarField.GetHeat(x, y)));
+				maxError = FMath::Max(maxError, FMath::Abs(vectorField.GetFuel(x, y) - scalarField.GetFuel(x, y)));
+				burningMismatches += vectorField.IsBurning(x, y) != scalarField.IsBurning(x, y) ? 1 : 0;
+			}
+		}
+		TestTrue(*FString::Printf(TEXT("Vector kernel matches scalar kernel (max error %g)"), maxError), maxError < 1e-4f);
+		TestEqual(TEXT("Burning mismatches between vector and scalar kernels"), burningMismatches, 0);
+	}
+
+	{
+		FFireField field;
+		field.Init(16, 16);
+		FIntRect dirtyRect;
+		TestFalse(TEXT("A fresh field has nothing to send"), field.GetNetDirtyRect(dirtyRect));
+
+		field.AddFuel(3, 5, 1.f);
+		field.AddFuel(9, 2, 1.f);
+		TestTrue(TEXT("Fueled cells are dirty"), field.GetNetDirtyRect(dirtyRect));
+		TestTrue(TEXT("Dirty rectangle spans both cells"), dirtyRect == FIntRect(3, 2, 9, 5));
+
+		field.ClearNetDirty();
+		field.AddHeat(3, 5, 1.f);
+		TestFalse(TEXT("Heat alone doesn't change the net state"), field.GetNetDirtyRect(dirtyRect));
+
+		field.Step(dt);
+		TestTrue(TEXT("A cell catching fire is dirty"), field.GetNetDirtyRect(dirtyRect) && dirtyRect.Contains(FIntPoint(3, 5)));
+		TestEqual(TEXT("Net state of a burning cell"), field.GetNetState(3, 5) & FFireField::BurningBit, (int32)FFireField::BurningBit);
+	}
+
+	return true;
+}
+
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+// Benchmark
+
+/** Times a step of the scalar, vector and vector + ParallelFor kernels. Optional arg: grid size (256) */
+static void BenchFireField(const TArray<FString>& Args)
+{
+	const int32 size = Args.Num() > 0 ? FMath::Max(4, FCString::Atoi(*Args[0])) : 256;
+	const int32 steps = 50;
+	const float dt = 0.1f;
+
+	auto run = [&](const TCHAR* label, TFunctionRef<void(FFireField&)> step)
+	{
+		FFireField field;
+		field.Init(size, size);
+		SeedFireField(field, 1);
+
+		//let the fire take hold before timing
+		for (int32 i = 0; i < 10; ++i)
+		{
+			field.Step(dt);
+		}
+
+		const double start = FPlatformTime::Seconds();
+		for (int32 i = 0; i < steps; ++i)
+		{
+			step(field);
+		}
+		const double msPerStep = (FPlatformTime::Seconds() - start) * 1000.0 / steps;
+
+		UE_LOG(LogTemp, Log, TEXT("Llama.BenchFireField %dx%d %-16s %.3f ms/step, %d cells burning"), size, size, label, msPerStep, field.CountBurning());
+	};
+
+	run(TEXT("scalar"), [dt](FFireField& field) { field.StepScalar(dt); });
+	run(TEXT("vector"), [dt](FFireField& field) { field.Step(dt, false); });
+	run(TEXT("vector parallel"), [dt](FFireField& field) { field.Step(dt, true); });
+}
+
+static FAutoConsoleCommandWithArgs BenchFireFieldCommand(
+	TEXT("Llama.BenchFireField"),
+	TEXT("Times one fire field step with the scalar, vector and parallel vector kernels. Optional arg: grid size (256)"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BenchFireField));
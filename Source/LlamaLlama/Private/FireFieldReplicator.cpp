@@ -0,0 +1,174 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "../Public/FireFieldReplicator.h"
+#include "../Public/FireFieldSubsystem.h"
+#include "../Public/LoadTestSubsystem.h"
+#include "../LlamaLlama.h"
+
+void FFireFieldCells::Encode(const TArray<uint8>& states)
+{
+	runs.Reset();
+	for (int32 i = 0; i < states.Num();)
+	{
+		const uint8 state = states[i];
+		int32 run = 1;
+		while (i + run < states.Num() && run < 256 && states[i + run] == state)
+		{
+			++run;
+		}
+		runs.Add((uint8)(run - 1));
+		runs.Add(state);
+		i += run;
+	}
+}
+
+bool FFireFieldCells::Decode(TArray<uint8>& outStates) const
+{
+	outStates.Reset(width * height);
+	for (int32 i = 0; i + 1 < runs.Num(); i += 2)
+	{
+		const int32 run = runs[i] + 1;
+		for (int32 j = 0; j < run; ++j)
+		{
+			outStates.Add(runs[i + 1]);
+		}
+	}
+	return outStates.Num() == width * height;
+}
+
+AFireFieldReplicator::AFireFieldReplicator()
+{
+	PrimaryActorTick.bCanEverTick = true;
+
+	fieldBounds = FBox2D(FVector2D(-10000.f, -10000.f), FVector2D(10000.f, 10000.f));
+	cellSize = 100.f;
+	sendInterval = 0.1f;
+	keyframeRows = 8;
+
+	maxCellsPerMessage = 4096;
+
+	fieldWidth = 0;
+	nextKeyframeRow = 0;
+	sendAccumulator = 0.f;
+
+	bReplicates = true;
+	bAlwaysRelevant = true;
+
+	//nothing replicates as properties, the updates go out as RPCs and Tick forces a net update to flush each batch
+	NetUpdateFrequency = 1.f;
+}
+
+void AFireFieldReplicator::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (UFireFieldSubsystem* fireField = UFireFieldSubsystem::Get(this))
+	{
+		fireField->InitializeField(GetWorld(), fieldBounds, cellSize);
+
+		const FFireField& field = fireField->GetField();
+		fieldWidth = field.GetWidth();
+		sentStates.SetNumZeroed(field.GetWidth() * field.GetHeight());
+	}
+
+	SetActorTickEnabled(Role == ROLE_Authority);
+}
+
+void AFireFieldReplicator::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UFireFieldSubsystem* fireField = UFireFieldSubsystem::Get(this))
+	{
+		fireField->ReleaseField();
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AFireFieldReplicator::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	sendAccumulator += DeltaSeconds;
+	if (sendAccumulator < sendInterval)
+		return;
+	sendAccumulator = 0.f;
+
+	UFireFieldSubsystem* fireField = UFireFieldSubsystem::Get(this);
+	if (fireField == nullptr || !fireField->HasField())
+		return;
+
+	const int32 width = fireField->GetField().GetWidth();
+	const int32 height = fireField->GetField().GetHeight();
+	if (width != fieldWidth || sentStates.Num() != width * height)
+		return;
+
+	//the field tracks what changed while it stepped, no need to compare every cell here
+	FIntRect dirtyRect;
+	if (fireField->GetNetDirtyRect(dirtyRect))
+	{
+		for (int32 y = dirtyRect.Min.Y; y <= dirtyRect.Max.Y; ++y)
+		{
+			for (int32 x = dirtyRect.Min.X; x <= dirtyRect.Max.X; ++x)
+			{
+				sentStates[y * width + x] = fireField->GetCellState(x, y);
+			}
+		}
+		fireField->ClearNetDirty();
+
+		SendRect(dirtyRect.Min.X, dirtyRect.Min.Y, dirtyRect.Width() + 1, dirtyRect.Height() + 1);
+	}
+
+	const int32 bandRows = FMath::Clamp(keyframeRows, 1, height);
+	nextKeyframeRow = nextKeyframeRow < height ? nextKeyframeRow : 0;
+	SendRect(0, nextKeyframeRow, width, FMath::Min(bandRows, height - nextKeyframeRow));
+	nextKeyframeRow += bandRows;
+
+	//unreliable multicasts wait on the channel until the actor replicates, at NetUpdateFrequency that'd batch ten sends a second into one
+	ForceNetUpdate();
+}
+
+void AFireFieldReplicator::SendRect(int32 x, int32 y, int32 width, int32 height)
+{
+	//big rectangles go out in row chunks so no single message gets near the bunch size limit
+	const int32 rowsPerMessage = FMath::Max(1, maxCellsPerMessage / width);
+	for (int32 firstRow = y; firstRow < y + height; firstRow += rowsPerMessage)
+	{
+		const int32 rows = FMath::Min(rowsPerMessage, y + height - firstRow);
+
+		TArray<uint8> states;
+		states.Reserve(width * rows);
+		for (int32 row = firstRow; row < firstRow + rows; ++row)
+		{
+			for (int32 column = x; column < x + width; ++column)
+			{
+				states.Add(sentStates[row * fieldWidth + column]);
+			}
+		}
+
+		FFireFieldCells cells;
+		cells.x = (uint16)x;
+		cells.y = (uint16)firstRow;
+		cells.width = (uint16)width;
+		cells.height = (uint16)rows;
+		cells.Encode(states);
+
+		LLAMA_COUNT_RPC(Sent_Multicast_ApplyCells);
+		Multicast_ApplyCells(cells);
+	}
+}
+
+void AFireFieldReplicator::Multicast_ApplyCells_Implementation(const FFireFieldCells& cells)
+{
+	if (Role == ROLE_Authority)
+		return;
+
+	LLAMA_COUNT_RPC(Received_Multicast_ApplyCells);
+
+	UFireFieldSubsystem* fireField = UFireFieldSubsystem::Get(this);
+	TArray<uint8> states;
+	if (fireField && cells.Decode(states))
+	{
+		fireField->ApplyCellStates(cells.x, cells.y, cells.width, cells.height, states);
+	}
+}
@@ -0,0 +1,234 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "../Public/FireFieldSubsystem.h"
+#include "../Public/TimerWheelSubsystem.h"
+#include "../LlamaLlama.h"
+
+#include "Engine/World.h"
+#include "Engine/GameInstance.h"
+#include "Engine/Engine.h"
+
+DECLARE_CYCLE_STAT(TEXT("Fire field step"), STAT_LlamaFireFieldStep, STATGROUP_Llama);
+
+UFireFieldSubsystem* UFireFieldSubsystem::Get(const UObject* worldContext)
+{
+	UWorld* world = GEngine ? GEngine->GetWorldFromContextObject(worldContext, EGetWorldErrorMode::ReturnNull) : nullptr;
+	UGameInstance* gameInstance = world ? world->GetGameInstance() : nullptr;
+	return gameInstance ? gameInstance->GetSubsystem<UFireFieldSubsystem>() : nullptr;
+}
+
+void UFireFieldSubsystem::Deinitialize()
+{
+	ReleaseField();
+
+	Super::Deinitialize();
+}
+
+void UFireFieldSubsystem::InitializeField(UWorld* world, const FBox2D& bounds, float cellSize)
+{
+	if (world == nullptr || !bounds.bIsValid || cellSize <= 0.f)
+		return;
+
+	fieldWorld = world;
+	fieldBounds = bounds;
+	fieldCellSize = cellSize;
+
+	const FVector2D size = bounds.GetSize();
+	field.Init(FMath::CeilToInt(size.X / cellSize), FMath::CeilToInt(size.Y / cellSize));
+
+	field.params.diffusion = diffusion;
+	field.params.cooling = cooling;
+	field.params.burnHeat = burnHeat;
+	field.params.burnRate = burnRate;
+	field.params.ignitionHeat = ignitionHeat;
+
+	bSimulating = !world->IsNetMode(NM_Client);
+	stepAccumulator = 0.f;
+
+	clientStates.Reset();
+	if (!bSimulating)
+	{
+		clientStates.SetNumZeroed(field.GetWidth() * field.GetHeight());
+	}
+}
+
+void UFireFieldSubsystem::ReleaseField()
+{
+	ClearDampCells();
+	fieldWorld.Reset();
+	bSimulating = false;
+	field.Init(1, 1);
+	clientStates.Empty();
+}
+
+void UFireFieldSubsystem::ResetField()
+{
+	if (bSimulating)
+	{
+		field.Reset();
+		stepAccumulator = 0.f;
+		ClearDampCells();
+	}
+}
+
+bool UFireFieldSubsystem::WorldToCell(const FVector& location, int32& outX, int32& outY) const
+{
+	if (!HasField())
+		return false;
+
+	outX = FMath::FloorToInt((location.X - fieldBounds.Min.X) / fieldCellSize);
+	outY = FMath::FloorToInt((location.Y - fieldBounds.Min.Y) / fieldCellSize);
+	return field.IsValidCell(outX, outY);
+}
+
+void UFireFieldSubsystem::ForEachCellInRadius(const FVector& location, float radius, TFunctionRef<void(int32, int32)> visit)
+{
+	if (!HasField())
+		return;
+
+	const int32 minX = FMath::Max(FMath::FloorToInt((location.X - radius - fieldBounds.Min.X) / fieldCellSize), 0);
+	const int32 minY = FMath::Max(FMath::FloorToInt((location.Y - radius - fieldBounds.Min.Y) / fieldCellSize), 0);
+	const int32 maxX = FMath::Min(FMath::FloorToInt((location.X + radius - fieldBounds.Min.X) / fieldCellSize), field.GetWidth() - 1);
+	const int32 maxY = FMath::Min(FMath::FloorToInt((location.Y + radius - fieldBounds.Min.Y) / fieldCellSize), field.GetHeight() - 1);
+
+	//always touch the cell the location is in, even for a radius smaller than a cell
+	const float radiusSq = FMath::Square(FMath::Max(radius, fieldCellSize * 0.5f));
+	for (int32 y = minY; y <= maxY; ++y)
+	{
+		for (int32 x = minX; x <= maxX; ++x)
+		{
+			const FVector2D center = fieldBounds.Min + FVector2D(x + 0.5f, y + 0.5f) * fieldCellSize;
+			if (FVector2D::DistSquared(center, FVector2D(location)) <= radiusSq)
+			{
+				visit(x, y);
+			}
+		}
+	}
+}
+
+void UFireFieldSubsystem::PourFuel(const FVector& location, float radius, float amount)
+{
+	if (CanWrite())
+	{
+		ForEachCellInRadius(location, radius, [this, amount](int32 x, int32 y) { field.AddFuel(x, y, amount); });
+	}
+}
+
+void UFireFieldSubsystem::Ignite(const FVector& location, float radius)
+{
+	if (CanWrite())
+	{
+		ForEachCellInRadius(location, radius, [this](int32 x, int32 y)
+		{
+			if (!dampCells.Contains(y * field.GetWidth() + x))
+			{
+				field.AddHeat(x, y, field.params.maxHeat);
+			}
+		});
+	}
+}
+
+void UFireFieldSubsystem::Extinguish(const FVector& location, float radius, float amount)
+{
+	if (CanWrite())
+	{
+		UTimerWheelSubsystem* timers = UTimerWheelSubsystem::Get(fieldWorld.Get());
+		ForEachCellInRadius(location, radius, [this, amount, timers](int32 x, int32 y)
+		{
+			field.Extinguish(x, y, amount);
+
+			//dousing a damp cell again starts its cooldown over
+			if (timers && reigniteCooldown > 0.f)
+			{
+				const int32 cellIndex = y * field.GetWidth() + x;
+				FLlamaTimerHandle& dryTimer = dampCells.FindOrAdd(cellIndex);
+				timers->ClearTimer(dryTimer);
+				dryTimer = timers->SetTimer(reigniteCooldown, FSimpleDelegate::CreateUObject(this, &UFireFieldSubsystem::DryCell, cellIndex));
+			}
+		});
+	}
+}
+
+void UFireFieldSubsystem::DryCell(int32 cellIndex)
+{
+	dampCells.Remove(cellIndex);
+}
+
+void UFireFieldSubsystem::ClearDampCells()
+{
+	if (UTimerWheelSubsystem* timers = UTimerWheelSubsystem::Get(fieldWorld.Get()))
+	{
+		for (auto& damp : dampCells)
+		{
+			timers->ClearTimer(damp.Value);
+		}
+	}
+	dampCells.Reset();
+}
+
+bool UFireFieldSubsystem::IsBurningAt(const FVector& location) const
+{
+	int32 x, y;
+	return WorldToCell(location, x, y) && (GetCellState(x, y) & FFireField::BurningBit) != 0;
+}
+
+uint8 UFireFieldSubsystem::GetCellState(int32 x, int32 y) const
+{
+	if (bSimulating)
+		return field.GetNetState(x, y);
+
+	return clientStates.IsValidIndex(y * field.GetWidth() + x) ? clientStates[y * field.GetWidth() + x] : 0;
+}
+
+void UFireFieldSubsystem::ApplyCellStates(int32 x, int32 y, int32 width, int32 height, const TArray<uint8>& states)
+{
+	if (bSimulating || !HasField() || states.Num() != width * height)
+		return;
+
+	for (int32 row = 0; row < height; ++row)
+	{
+		for (int32 column = 0; column < width; ++column)
+		{
+			if (field.IsValidCell(x + column, y + row))
+			{
+				clientStates[(y + row) * field.GetWidth() + x + column] = states[row * width + column];
+			}
+		}
+	}
+}
+
+void UFireFieldSubsystem::Tick(float DeltaTime)
+{
+	if (!fieldWorld.IsValid())
+	{
+		ReleaseField();
+		return;
+	}
+
+	const float stepTime = 1.f / FMath::Max(stepRate, 1.f);
+	stepAccumulator = FMath::Min(stepAccumulator + DeltaTime, stepTime * 4.f);
+
+	while (stepAccumulator >= stepTime)
+	{
+		SCOPE_CYCLE_COUNTER(STAT_LlamaFireFieldStep);
+		field.Step(stepTime);
+		stepAccumulator -= stepTime;
+
+		//the kernel doesn't know about damp cells, put out whatever spread into them
+		for (const auto& damp : dampCells)
+		{
+			field.Extinguish(damp.Key % field.GetWidth(), damp.Key / field.GetWidth(), field.params.maxHeat);
+		}
+	}
+}
+
+TStatId UFireFieldSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UFireFieldSubsystem, STATGROUP_Tickables);
+}
+
+UWorld* UFireFieldSubsystem::GetTickableGameObjectWorld() const
+{
+	return fieldWorld.Get();
+}
@@ -0,0 +1,68 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "../Public/GasCanItem.h"
+#include "../Public/FireFieldSubsystem.h"
+#include "../LlamaLlamaCharacter.h"
+
+AGasCanItem::AGasCanItem()
+{
+	capacity = 5;
+	pourDistance = 150.f;
+	pourRadius = 150.f;
+	pourAmount = 1.f;
+	pourMontage = nullptr;
+	emptyMontage = nullptr;
+	pours = 0;
+}
+
+void AGasCanItem::BeginPlay()
+{
+	Super::BeginPlay();
+
+	pours = capacity;
+}
+
+void AGasCanItem::Refill()
+{
+	if (Role < ROLE_Authority)
+		return;
+
+	pours = capacity;
+}
+
+void AGasCanItem::ResetForRound(const FTransform& transform)
+{
+	Super::ResetForRound(transform);
+
+	Refill();
+}
+
+void AGasCanItem::OnAcquiredFromPool()
+{
+	Super::OnAcquiredFromPool();
+
+	Refill();
+}
+
+void AGasCanItem::NativePrimaryAction()
+{
+	if (carrier == nullptr)
+		return;
+
+	if (pours <= 0)
+	{
+		carrier->PlayReplicatedMontage(emptyMontage);
+		return;
+	}
+
+	pours--;
+	carrier->PlayReplicatedMontage(pourMontage);
+	PlayUseEffects();
+
+	UFireFieldSubsystem* fireField = UFireFieldSubsystem::Get(this);
+	if (fireField && fireField->HasField())
+	{
+		fireField->PourFuel(carrier->GetActorLocation() + carrier->GetActorForwardVector() * pourDistance, pourRadius, pourAmount);
+	}
+}
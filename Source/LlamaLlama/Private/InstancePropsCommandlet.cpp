@@ -0,0 +1,304 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "../Public/InstancePropsCommandlet.h"
+#include "../Public/InstancedPropsActor.h"
+
+#include "Engine/World.h"
+#include "Engine/Level.h"
+#include "GameFramework/WorldSettings.h"
+#include "Engine/StaticMeshActor.h"
+#include "Engine/DecalActor.h"
+#include "Engine/LevelScriptActor.h"
+#include "Engine/CollisionProfile.h"
+#include "Particles/Emitter.h"
+#include "Components/StaticMeshComponent.h"
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
+#include "Components/DecalComponent.h"
+#include "Particles/ParticleSystemComponent.h"
+#include "UObject/GarbageCollection.h"
+#include "Misc/PackageName.h"
+
+namespace
+{
+	struct FLevelCounts
+	{
+		int32 actors = 0;
+		int32 components = 0;
+		int32 bodies = 0;
+		SIZE_T bytes = 0;
+	};
+
+	void CountObject(UObject* object, FLevelCounts& counts)
+	{
+		counts.bytes += object->GetResourceSizeBytes(EResourceSizeMode::Exclusive);
+	}
+
+	/** Counts everything in level, and separately what a dedicated server loads of it */
+	void CountLevel(ULevel* level, FLevelCounts& outAll, FLevelCounts& outServer)
+	{
+		outAll = FLevelCounts();
+		outServer = FLevelCounts();
+
+		for (AActor* actor : level->Actors)
+		{
+			if (actor == nullptr || actor->IsPendingKill())
+				continue;
+
+			const bool bServer = actor->NeedsLoadForServer();
+			FLevelCounts* targets[] = { &outAll, bServer ? &outServer : nullptr };
+			for (FLevelCounts* counts : targets)
+			{
+				if (counts == nullptr)
+					continue;
+
+				++counts->actors;
+				CountObject(actor, *counts);
+
+				for (UActorComponent* component : actor->GetComponents())
+				{
+					++counts->components;
+					CountObject(component, *counts);
+
+					UPrimitiveComponent* primitive = Cast<UPrimitiveComponent>(component);
+					if (primitive && primitive->GetCollisionEnabled() != ECollisionEnabled::NoCollision)
+					{
+						UInstancedStaticMeshComponent* instanced = Cast<UInstancedStaticMeshComponent>(primitive);
+						counts->bodies += instanced ? instanced->GetInstanceCount() : 1;
+					}
+				}
+			}
+		}
+	}
+
+	void LogCounts(const TCHAR* label, const FLevelCounts& all, const FLevelCounts& server)
+	{
+		UE_LOG(LogTemp, Display, TEXT("%-6s full:   %6d actors %7d components %7d bodies %8.2f MB"),
+			label, all.actors, all.components, all.bodies, all.bytes / (1024.f * 1024.f));
+		UE_LOG(LogTemp, Display, TEXT("%-6s server: %6d actors %7d components %7d bodies %8.2f MB"),
+			label, server.actors, server.components, server.bodies, server.bytes / (1024.f * 1024.f));
+	}
+
+	/** Actors some other actor or the level blueprint points at, those have to stay actors */
+	void FindReferencedActors(ULevel* level, TSet<AActor*>& outReferenced)
+	{
+		TArray<AActor*> referencers(level->Actors);
+		referencers.Add(level->GetLevelScriptActor());
+
+		for (AActor* referencer : referencers)
+		{
+			if (referencer == nullptr)
+				continue;
+
+			TArray<UObject*> references;
+			FReferenceFinder finder(references, nullptr, false, true, false, false);
+			finder.FindReferences(referencer);
+
+			for (UObject* reference : references)
+			{
+				AActor* actor = Cast<AActor>(reference);
+				if (actor && actor != referencer)
+				{
+					outReferenced.Add(actor);
+				}
+			}
+		}
+	}
+
+	bool IsLooseActor(AActor* actor, const TSet<AActor*>& referenced)
+	{
+		if (actor->Tags.Num() > 0 || actor->bHidden || referenced.Contains(actor))
+			return false;
+
+		TArray<AActor*> attached;
+		actor->GetAttachedActors(attached);
+		return actor->GetAttachParentActor() == nullptr && attached.Num() == 0;
+	}
+}
+
+UInstancePropsCommandlet::UInstancePropsCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = true;
+	LogToConsole = true;
+}
+
+int32 UInstancePropsCommandlet::Main(const FString& Params)
+{
+#if WITH_EDITOR
+	FString mapName;
+	if (!FParse::Value(*Params, TEXT("map="), mapName))
+	{
+		UE_LOG(LogTemp, Error, TEXT("usage: -run=InstanceProps -map=<long package name> [-MinInstances=2] [-save]"));
+		return 1;
+	}
+
+	int32 minInstances = 2;
+	FParse::Value(*Params, TEXT("MinInstances="), minInstances);
+	const bool bSave = FParse::Param(*Params, TEXT("save"));
+
+	UPackage* package = LoadPackage(nullptr, *mapName, LOAD_None);
+	UWorld* world = package ? UWorld::FindWorldInPackage(package) : nullptr;
+	if (world == nullptr)
+	{
+		UE_LOG(LogTemp, Error, TEXT("%s is not a map"), *mapName);
+		return 1;
+	}
+
+	world->WorldType = EWorldType::Editor;
+	world->AddToRoot();
+	if (!world->bIsWorldInitialized)
+	{
+		UWorld::InitializationValues ivs;
+		ivs.RequiresHitProxies(false)
+			.ShouldSimulatePhysics(false)
+			.EnableTraceCollision(false)
+			.CreateNavigation(false)
+			.CreateAISystem(false)
+			.AllowAudioPlayback(false)
+			.CreatePhysicsScene(true);
+		world->InitWorld(ivs);
+		world->PersistentLevel->UpdateModelComponents();
+		world->UpdateWorldComponents(true, false);
+	}
+
+	ULevel* level = world->PersistentLevel;
+
+	FLevelCounts allBefore, serverBefore;
+	CountLevel(level, allBefore, serverBefore);
+
+	TSet<AActor*> referenced;
+	FindReferencedActors(level, referenced);
+
+	//gather first, the holders are spawned into the same actor list
+	TArray<AStaticMeshActor*> props;
+	TMap<UStaticMesh*, int32> meshUses;
+	TArray<AActor*> visualActors;
+	for (AActor* actor : level->Actors)
+	{
+		if (actor == nullptr || actor->IsPendingKill() || !IsLooseActor(actor, referenced))
+			continue;
+
+		//exact classes only, subclasses can carry logic
+		if (actor->GetClass() == AStaticMeshActor::StaticClass())
+		{
+			UStaticMeshComponent* meshComponent = CastChecked<AStaticMeshActor>(actor)->GetStaticMeshComponent();
+			if (meshComponent->Mobility != EComponentMobility::Static || meshComponent->GetStaticMesh() == nullptr || meshComponent->ComponentTags.Num() > 0)
+				continue;
+
+			//custom responses don't survive the merge, the component only keeps the profile name
+			if (meshComponent->GetCollisionProfileName() == UCollisionProfile::CustomCollisionProfileName)
+				continue;
+
+			props.Add(CastChecked<AStaticMeshActor>(actor));
+			meshUses.FindOrAdd(meshComponent->GetStaticMesh())++;
+		}
+		else if (actor->GetClass() == ADecalActor::StaticClass() || actor->GetClass() == AEmitter::StaticClass())
+		{
+			visualActors.Add(actor);
+		}
+	}
+
+	FActorSpawnParameters spawnParams;
+	spawnParams.OverrideLevel = level;
+	spawnParams.Name = TEXT("InstancedProps");
+	AInstancedPropsActor* serverProps = world->SpawnActor<AInstancedPropsActor>(spawnParams);
+	spawnParams.Name = TEXT("InstancedProps_VisualOnly");
+	AInstancedPropsActor* visualProps = world->SpawnActor<AInstancedPropsActor>(spawnParams);
+	visualProps->bVisualOnly = true;
+
+	int32 merged = 0;
+	int32 moved = 0;
+	for (AStaticMeshActor* prop : props)
+	{
+		UStaticMeshComponent* meshComponent = prop->GetStaticMeshComponent();
+		if (meshUses[meshComponent->GetStaticMesh()] < minInstances)
+			continue;
+
+		AInstancedPropsActor* holder = meshComponent->GetCollisionEnabled() == ECollisionEnabled::NoCollision ? visualProps : serverProps;
+		holder->AddInstance(meshComponent->GetStaticMesh(), meshComponent->OverrideMaterials, meshComponent->GetCollisionProfileName(), meshComponent->GetComponentTransform());
+		world->EditorDestroyActor(prop, true);
+		++merged;
+	}
+
+	for (AActor* actor : visualActors)
+	{
+		USceneComponent* component = nullptr;
+		if (ADecalActor* decal = Cast<ADecalActor>(actor))
+		{
+			component = decal->GetDecal();
+		}
+		else if (AEmitter* emitter = Cast<AEmitter>(actor))
+		{
+			component = emitter->GetParticleSystemComponent();
+		}
+
+		if (component)
+		{
+			visualProps->AdoptComponent(component);
+			world->EditorDestroyActor(actor, true);
+			++moved;
+		}
+	}
+
+	if (serverProps->GetInstanceComponents().Num() == 0)
+	{
+		world->EditorDestroyActor(serverProps, true);
+		serverProps = nullptr;
+	}
+	if (visualProps->GetInstanceComponents().Num() == 0 && moved == 0)
+	{
+		world->EditorDestroyActor(visualProps, true);
+		visualProps = nullptr;
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("Merged %d of %d static mesh actors into %d + %d instanced components, moved %d decals and emitters to the visual only holder"),
+		merged, props.Num(), serverProps ? serverProps->GetInstanceComponents().Num() : 0, visualProps ? visualProps->GetInstanceComponents().Num() : 0, moved);
+
+	//the instances don't inherit the merged actors' lightmaps, the props render unbuilt until lighting is rebuilt
+	if (merged > 0 && !world->GetWorldSettings()->bForceNoPrecomputedLighting)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("The %d merged props lost their baked lighting, rebuild lighting for %s before shipping it"), merged, *mapName);
+	}
+
+	for (AInstancedPropsActor* holder : { serverProps, visualProps })
+	{
+		if (holder == nullptr)
+			continue;
+
+		for (UHierarchicalInstancedStaticMeshComponent* component : holder->GetInstanceComponents())
+		{
+			component->BuildTreeIfOutdated(false, true);
+		}
+	}
+
+	FLevelCounts allAfter, serverAfter;
+	CountLevel(level, allAfter, serverAfter);
+	LogCounts(TEXT("before"), allBefore, serverBefore);
+	LogCounts(TEXT("after"), allAfter, serverAfter);
+
+	int32 result = 0;
+	if (bSave)
+	{
+		const FString filename = FPackageName::LongPackageNameToFilename(package->GetName(), FPackageName::GetMapPackageExtension());
+		package->MarkPackageDirty();
+		if (UPackage::SavePackage(package, world, RF_NoFlags, *filename, GError, nullptr, false, true, SAVE_NoError))
+		{
+			UE_LOG(LogTemp, Display, TEXT("Saved %s"), *filename);
+		}
+		else
+		{
+			UE_LOG(LogTemp, Error, TEXT("Couldn't save %s"), *filename);
+			result = 1;
+		}
+	}
+
+	world->CleanupWorld();
+	world->RemoveFromRoot();
+	return result;
+#else
+	UE_LOG(LogTemp, Error, TEXT("InstanceProps needs an editor build"));
+	return 1;
+#endif
+}
@@ -0,0 +1,62 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "../Public/InstancedPropsActor.h"
+
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
+
+AInstancedPropsActor::AInstancedPropsActor()
+{
+	PrimaryActorTick.bCanEverTick = false;
+	bVisualOnly = false;
+
+	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
+	RootComponent->SetMobility(EComponentMobility::Static);
+}
+
+bool AInstancedPropsActor::NeedsLoadForServer() const
+{
+	//the cook checks the outer chain, so the components and their instances go with the actor
+	return !bVisualOnly && Super::NeedsLoadForServer();
+}
+
+void AInstancedPropsActor::AddInstance(UStaticMesh* mesh, const TArray<UMaterialInterface*>& materials, FName collisionProfile, const FTransform& worldTransform)
+{
+	UHierarchicalInstancedStaticMeshComponent* target = nullptr;
+	for (UHierarchicalInstancedStaticMeshComponent* component : instanceComponents)
+	{
+		if (component->GetStaticMesh() == mesh && component->GetCollisionProfileName() == collisionProfile && component->OverrideMaterials == materials)
+		{
+			target = component;
+			break;
+		}
+	}
+
+	if (target == nullptr)
+	{
+		target = NewObject<UHierarchicalInstancedStaticMeshComponent>(this, NAME_None, RF_Transactional);
+		target->CreationMethod = EComponentCreationMethod::Instance;
+		target->SetMobility(EComponentMobility::Static);
+		target->SetStaticMesh(mesh);
+		target->OverrideMaterials = materials;
+		target->SetCollisionProfileName(collisionProfile);
+		target->SetupAttachment(RootComponent);
+		AddInstanceComponent(target);
+		target->RegisterComponent();
+		instanceComponents.Add(target);
+	}
+
+	target->AddInstanceWorldSpace(worldTransform);
+}
+
+void AInstancedPropsActor::AdoptComponent(USceneComponent* source)
+{
+	const FTransform worldTransform = source->GetComponentTransform();
+
+	USceneComponent* copy = DuplicateObject<USceneComponent>(source, this);
+	copy->CreationMethod = EComponentCreationMethod::Instance;
+	copy->SetupAttachment(RootComponent);
+	copy->SetWorldTransform(worldTransform);
+	AddInstanceComponent(copy);
+	copy->RegisterComponent();
+}
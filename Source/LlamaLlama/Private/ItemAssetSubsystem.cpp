@@ -0,0 +1,204 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "../Public/ItemAssetSubsystem.h"
+#include "../Public/ItemDefinition.h"
+#include "../Public/BaseItem.h"
+
+#include "Engine/AssetManager.h"
+#include "Engine/GameInstance.h"
+#include "Engine/Engine.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformMemory.h"
+
+UItemAssetSubsystem* UItemAssetSubsystem::Get(const UObject* worldContext)
+{
+	UWorld* world = GEngine ? GEngine->GetWorldFromContextObject(worldContext, EGetWorldErrorMode::ReturnNull) : nullptr;
+	UGameInstance* gameInstance = world ? world->GetGameInstance() : nullptr;
+	return gameInstance ? gameInstance->GetSubsystem<UItemAssetSubsystem>() : nullptr;
+}
+
+void UItemAssetSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	postWorldInitHandle = FWorldDelegates::OnPostWorldInitialization.AddUObject(this, &UItemAssetSubsystem::OnPostWorldInitialization);
+	worldCleanupHandle = FWorldDelegates::OnWorldCleanup.AddUObject(this, &UItemAssetSubsystem::OnWorldCleanup);
+}
+
+void UItemAssetSubsystem::Deinitialize()
+{
+	FWorldDelegates::OnPostWorldInitialization.Remove(postWorldInitHandle);
+	FWorldDelegates::OnWorldCleanup.Remove(worldCleanupHandle);
+
+	ReleaseItemDefinitions();
+
+	Super::Deinitialize();
+}
+
+void UItemAssetSubsystem::OnPostWorldInitialization(UWorld* world, const UWorld::InitializationValues initValues)
+{
+	if (world && world->IsGameWorld() && world->GetGameInstance() == GetGameInstance())
+	{
+		LoadItemDefinitions(world);
+	}
+}
+
+void UItemAssetSubsystem::OnWorldCleanup(UWorld* world, bool bSessionEnded, bool bCleanupResources)
+{
+	if (world && world->IsGameWorld() && world->GetGameInstance() == GetGameInstance())
+	{
+		ReleaseItemDefinitions();
+	}
+}
+
+void UItemAssetSubsystem::LoadItemDefinitions(UWorld* world)
+{
+	TArray<FPrimaryAssetId> ids;
+
+	for (TActorIterator<ABaseItem> it(world); it; ++it)
+	{
+		if (it->definition)
+		{
+			ids.AddUnique(it->definition->GetPrimaryAssetId());
+		}
+	}
+
+	const FString mapName = UWorld::RemovePIEPrefix(world->GetMapName());
+	for (const FMapItemDefinitions& entry : mapItemDefinitions)
+	{
+		if (entry.map == mapName)
+		{
+			for (const FPrimaryAssetId& id : entry.definitions)
+			{
+				ids.AddUnique(id);
+			}
+		}
+	}
+
+	loadStartTime = FPlatformTime::Seconds();
+	RequestItemDefinitions(ids);
+}
+
+void UItemAssetSubsystem::LoadItemDefinition(const UItemDefinition* definition)
+{
+	if (definition == nullptr)
+		return;
+
+	TArray<FPrimaryAssetId> ids;
+	ids.Add(definition->GetPrimaryAssetId());
+	RequestItemDefinitions(ids);
+}
+
+bool UItemAssetSubsystem::IsItemDefinitionLoaded(const UItemDefinition* definition) const
+{
+	return definition && pendingLoads == 0 && requestedIds.Contains(definition->GetPrimaryAssetId());
+}
+
+void UItemAssetSubsystem::RequestItemDefinitions(const TArray<FPrimaryAssetId>& ids)
+{
+	UAssetManager* assetManager = UAssetManager::GetIfValid();
+	if (assetManager == nullptr)
+		return;
+
+	TArray<FPrimaryAssetId> newIds;
+	for (const FPrimaryAssetId& id : ids)
+	{
+		if (id.IsValid() && !requestedIds.Contains(id))
+		{
+			requestedIds.Add(id);
+			newIds.Add(id);
+		}
+	}
+
+	if (newIds.Num() == 0)
+		return;
+
+	//sounds and effects are of no use to a server nobody looks at, the mesh is in Gameplay since it is the item's body
+	TArray<FName> bundles;
+	bundles.Add(UItemDefinition::GameplayBundle);
+	if (!IsRunningDedicatedServer())
+	{
+		bundles.Add(UItemDefinition::CosmeticBundle);
+	}
+
+	++pendingLoads;
+	TSharedPtr<FStreamableHandle> handle = assetManager->LoadPrimaryAssets(newIds, bundles,
+		FStreamableDelegate::CreateUObject(this, &UItemAssetSubsystem::OnLoadCompleted));
+
+	//no handle when there was nothing left to load
+	if (handle.IsValid())
+	{
+		loadHandles.Add(handle);
+	}
+	else
+	{
+		OnLoadCompleted();
+	}
+}
+
+void UItemAssetSubsystem::ReleaseItemDefinitions()
+{
+	for (const TSharedPtr<FStreamableHandle>& handle : loadHandles)
+	{
+		handle->CancelHandle();
+	}
+	loadHandles.Empty();
+
+	UAssetManager* assetManager = UAssetManager::GetIfValid();
+	if (assetManager && requestedIds.Num() > 0)
+	{
+		assetManager->UnloadPrimaryAssets(requestedIds.Array());
+	}
+
+	requestedIds.Empty();
+	definitions.Empty();
+	pendingLoads = 0;
+}
+
+void UItemAssetSubsystem::OnLoadCompleted()
+{
+	pendingLoads = FMath::Max(pendingLoads - 1, 0);
+	if (pendingLoads > 0)
+		return;
+
+	definitions.Empty();
+
+	if (UAssetManager* assetManager = UAssetManager::GetIfValid())
+	{
+		for (const FPrimaryAssetId& id : requestedIds)
+		{
+			if (UItemDefinition* definition = Cast<UItemDefinition>(assetManager->GetPrimaryAssetObject(id)))
+			{
+				definitions.Add(definition);
+			}
+		}
+	}
+
+	loadSeconds = FPlatformTime::Seconds() - loadStartTime;
+	usedPhysicalAfterLoad = FPlatformMemory::GetStats().UsedPhysical;
+
+	LogLoadStats();
+	OnItemDefinitionsLoaded.Broadcast();
+}
+
+void UItemAssetSubsystem::LogLoadStats() const
+{
+	UE_LOG(LogTemp, Log, TEXT("Item definitions: %d loaded (%s) in %.1f ms, %.1f MB resident after load"),
+		definitions.Num(), IsRunningDedicatedServer() ? TEXT("Gameplay") : TEXT("Gameplay + Cosmetic"),
+		loadSeconds * 1000.0, usedPhysicalAfterLoad / (1024.0 * 1024.0));
+}
+
+static void LogItemAssets(const TArray<FString>& Args, UWorld* World)
+{
+	if (UItemAssetSubsystem* itemAssets = UItemAssetSubsystem::Get(World))
+	{
+		itemAssets->LogLoadStats();
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs ItemAssetsCommand(
+	TEXT("Llama.ItemAssets"),
+	TEXT("Logs how long the item definitions took to load and the resident memory right after"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&LogItemAssets));
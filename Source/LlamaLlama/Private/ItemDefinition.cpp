@@ -0,0 +1,13 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "../Public/ItemDefinition.h"
+
+const FPrimaryAssetType UItemDefinition::ItemDefinitionType = TEXT("ItemDefinition");
+const FName UItemDefinition::GameplayBundle = TEXT("Gameplay");
+const FName UItemDefinition::CosmeticBundle = TEXT("Cosmetic");
+
+FPrimaryAssetId UItemDefinition::GetPrimaryAssetId() const
+{
+	return FPrimaryAssetId(ItemDefinitionType, GetFName());
+}
@@ -0,0 +1,265 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "../Public/ItemGridSubsystem.h"
+#include "../Public/BaseItem.h"
+#include "../LlamaLlamaCharacter.h"
+#include "../LlamaLlama.h"
+
+#include "Engine/World.h"
+#include "Engine/GameInstance.h"
+#include "Engine/Engine.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+
+UItemGridSubsystem* UItemGridSubsystem::Get(const UObject* worldContext)
+{
+	UWorld* world = GEngine ? GEngine->GetWorldFromContextObject(worldContext, EGetWorldErrorMode::ReturnNull) : nullptr;
+	UGameInstance* gameInstance = world ? world->GetGameInstance() : nullptr;
+	return gameInstance ? gameInstance->GetSubsystem<UItemGridSubsystem>() : nullptr;
+}
+
+void UItemGridSubsystem::Deinitialize()
+{
+	registeredItems.Empty();
+	cells.Empty();
+	itemCells.Empty();
+	awakeItems.Empty();
+
+	Super::Deinitialize();
+}
+
+void UItemGridSubsystem::RegisterItem(ABaseItem* item)
+{
+	if (item)
+	{
+		registeredItems.Add(item);
+		bCountsDirty = true;
+		UpdateItem(item);
+	}
+}
+
+void UItemGridSubsystem::UnregisterItem(ABaseItem* item)
+{
+	RemoveFromGrid(item);
+	awakeItems.RemoveSwap(item);
+	registeredItems.Remove(item);
+	bCountsDirty = true;
+}
+
+void UItemGridSubsystem::UpdateItem(ABaseItem* item)
+{
+	if (!registeredItems.Contains(item))
+		return;
+
+	if (item->carrier)
+	{
+		RemoveFromGrid(item);
+		bCountsDirty = true;
+		return;
+	}
+
+	const FIntPoint cell = GetCell(item->GetActorLocation());
+	if (FIntPoint* currentCell = itemCells.Find(item))
+	{
+		if (*currentCell == cell)
+			return;
+
+		RemoveFromGrid(item);
+	}
+
+	cells.FindOrAdd(cell).Add(item);
+	itemCells.Add(item, cell);
+	bCountsDirty = true;
+}
+
+void UItemGridSubsystem::SetItemAwake(ABaseItem* item, bool bAwake)
+{
+	if (!registeredItems.Contains(item))
+		return;
+
+	if (bAwake)
+	{
+		awakeItems.AddUnique(item);
+	}
+	else
+	{
+		awakeItems.RemoveSwap(item);
+	}
+	bCountsDirty = true;
+
+	//the item either starts moving or settled down, either way its cell may have changed
+	UpdateItem(item);
+}
+
+ABaseItem* UItemGridSubsystem::FindNearestFreeItem(const FVector& origin, float radius) const
+{
+	const FIntPoint minCell = GetCell(origin - FVector(radius));
+	const FIntPoint maxCell = GetCell(origin + FVector(radius));
+
+	ABaseItem* closestItem = nullptr;
+	float closestDistSq = FMath::Square(radius);
+
+	for (int32 x = minCell.X; x <= maxCell.X; ++x)
+	{
+		for (int32 y = minCell.Y; y <= maxCell.Y; ++y)
+		{
+			const TArray<ABaseItem*>* cellItems = cells.Find(FIntPoint(x, y));
+			if (!cellItems)
+				continue;
+
+			for (ABaseItem* item : *cellItems)
+			{
+				if (item->carrier != nullptr || item->bHidden)
+					continue;
+
+				const float distSq = FVector::DistSquared(origin, item->GetActorLocation());
+				if (distSq <= closestDistSq)
+				{
+					closestDistSq = distSq;
+					closestItem = item;
+				}
+			}
+		}
+	}
+
+	return closestItem;
+}
+
+void UItemGridSubsystem::Tick(float DeltaTime)
+{
+	int32 itemsInFlight = 0;
+	int32 itemsOnArc = 0;
+
+	//by index, landing wakes the body and that can add to awakeItems
+	for (int32 i = 0; i < awakeItems.Num(); ++i)
+	{
+		ABaseItem* item = awakeItems[i];
+		if (item->IsInFlight())
+		{
+			item->TickFlight(DeltaTime);
+			++itemsOnArc;
+		}
+
+		UpdateItem(item);
+		item->UpdateNetUpdateFrequency();
+		itemsInFlight += item->carrier == nullptr ? 1 : 0;
+	}
+	numItemsInFlight = itemsInFlight;
+
+	//carried items are the registered ones that were taken out of the grid
+	LLAMA_SET_COUNT(ItemsHeld, registeredItems.Num() - itemCells.Num());
+	LLAMA_SET_COUNT(ItemsInFlight, itemsInFlight);
+	LLAMA_SET_COUNT(ItemsOnArc, itemsOnArc);
+	bCountsDirty = false;
+}
+
+TStatId UItemGridSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UItemGridSubsystem, STATGROUP_Tickables);
+}
+
+UWorld* UItemGridSubsystem::GetTickableGameObjectWorld() const
+{
+	UGameInstance* gameInstance = GetGameInstance();
+	return gameInstance ? gameInstance->GetWorld() : nullptr;
+}
+
+FIntPoint UItemGridSubsystem::GetCell(const FVector& location) const
+{
+	return FIntPoint(FMath::FloorToInt(location.X / cellSize), FMath::FloorToInt(location.Y / cellSize));
+}
+
+void UItemGridSubsystem::RemoveFromGrid(ABaseItem* item)
+{
+	FIntPoint cell;
+	if (itemCells.RemoveAndCopyValue(item, cell))
+	{
+		TArray<ABaseItem*>& cellItems = cells.FindChecked(cell);
+		cellItems.RemoveSwap(item);
+		if (cellItems.Num() == 0)
+		{
+			cells.Remove(cell);
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Benchmark
+
+static void BenchItemGrid(const TArray<FString>& Args, UWorld* World)
+{
+	UItemGridSubsystem* grid = UItemGridSubsystem::Get(World);
+	TActorIterator<ALlamaLlamaCharacter> llamaIt(World);
+	if (!grid || !llamaIt)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Llama.BenchItemGrid needs a world with a llama in it"));
+		return;
+	}
+
+	ALlamaLlamaCharacter* llama = *llamaIt;
+	const FVector origin = llama->GetActorLocation();
+	const int32 iterations = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 1000;
+	const int32 itemCounts[] = { 10, 100, 1000 };
+
+	for (int32 itemCount : itemCounts)
+	{
+		//scatter the items in a disc around the llama, a few of them end up inside pick up range
+		TArray<ABaseItem*> spawnedItems;
+		FActorSpawnParameters spawnParams;
+		spawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+		for (int32 i = 0; i < itemCount; ++i)
+		{
+			const FVector2D offset = FMath::RandPointInCircle(3000.f);
+			const FVector location = origin + FVector(offset.X, offset.Y, 0.f);
+			if (ABaseItem* item = World->SpawnActor<ABaseItem>(ABaseItem::StaticClass(), location, FRotator::ZeroRotator, spawnParams))
+			{
+				spawnedItems.Add(item);
+			}
+		}
+
+		double start = FPlatformTime::Seconds();
+		int32 overlapHits = 0;
+		for (int32 i = 0; i < iterations; ++i)
+		{
+			TArray<AActor*> actors;
+			llama->GetOverlappingActors(actors);
+			for (auto& actor : actors)
+			{
+				if (ABaseItem * overlappingItem = Cast<ABaseItem>(actor))
+				{
+					if (overlappingItem->carrier == nullptr)
+					{
+						++overlapHits;
+						break;
+					}
+				}
+			}
+		}
+		const double overlapUs = (FPlatformTime::Seconds() - start) * 1000000.0 / iterations;
+
+		start = FPlatformTime::Seconds();
+		int32 gridHits = 0;
+		for (int32 i = 0; i < iterations; ++i)
+		{
+			if (grid->FindNearestFreeItem(origin, llama->pickUpRadius))
+			{
+				++gridHits;
+			}
+		}
+		const double gridUs = (FPlatformTime::Seconds() - start) * 1000000.0 / iterations;
+
+		UE_LOG(LogTemp, Log, TEXT("Llama.BenchItemGrid %4d items: overlap scan %.3f us (%d hits), grid query %.3f us (%d hits)"),
+			itemCount, overlapUs, overlapHits, gridUs, gridHits);
+
+		for (ABaseItem* item : spawnedItems)
+		{
+			item->Destroy();
+		}
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs BenchItemGridCommand(
+	TEXT("Llama.BenchItemGrid"),
+	TEXT("Compares the overlap scan against the item grid query at 10, 100 and 1000 items. Optional arg: iterations per run"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&BenchItemGrid));
@@ -0,0 +1,594 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "../Public/ItemRepMovement.h"
+#include "../LlamaLlama.h"
+#include "../Public/LoadTestSubsystem.h"
+
+#include "Engine/EngineTypes.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/AutomationTest.h"
+#include "Serialization/BitReader.h"
+#include "Serialization/BitWriter.h"
+
+const int32 FItemMovementState::LocationBits[3] = { 20, 20, 18 };
+
+namespace
+{
+	const int32 SequenceBits = 8;
+	const int32 BaseOffsetBits = 4;
+	const uint32 MaxBaseOffset = (1u << BaseOffsetBits) - 1;
+
+	/** Locations that moved less than this many steps on every axis send the offset instead */
+	const int32 LocationOffsetBits = 10;
+
+	const int32 RotationComponentBits = 10;
+	const float RotationComponentMax = (1 << RotationComponentBits) - 1;
+
+	/** The three smallest components of a unit quaternion are within +-1/sqrt(2) */
+	const float SmallestComponentRange = 0.70710678f;
+
+	/** What the connection was last sent, kept by the engine per connection and rolled back when the packet is lost */
+	class FItemMovementBaseState : public INetDeltaBaseState
+	{
+	public:
+		virtual bool IsStateEqual(INetDeltaBaseState* otherState) override
+		{
+			return state == static_cast<FItemMovementBaseState*>(otherState)->state;
+		}
+
+		FItemMovementState state;
+		uint8 sequence = 0;
+
+		/** Shared by every state sent over the same channel, so a sequence isn't reused after a roll back */
+		TSharedPtr<uint8> nextSequence;
+	};
+
+	bool SerializeFlag(FArchive& Ar, bool bValue)
+	{
+		uint8 bit = bValue ? 1 : 0;
+		Ar.SerializeBits(&bit, 1);
+		return bit != 0;
+	}
+
+	void SerializeUnsigned(FArchive& Ar, uint32& value, int32 numBits)
+	{
+		value &= (1u << numBits) - 1;
+		Ar.SerializeInt(value, 1u << numBits);
+	}
+
+	void SerializeSigned(FArchive& Ar, int32& value, int32 numBits)
+	{
+		const int32 half = 1 << (numBits - 1);
+		uint32 biased = (uint32)(FMath::Clamp(value, -half, half - 1) + half);
+		SerializeUnsigned(Ar, biased, numBits);
+		value = (int32)biased - half;
+	}
+
+	void SerializeSignedVector(FArchive& Ar, FIntVector& value, int32 numBits)
+	{
+		for (int32 axis = 0; axis < 3; ++axis)
+		{
+			SerializeSigned(Ar, value[axis], numBits);
+		}
+	}
+
+	bool FitsSigned(const FIntVector& value, int32 numBits)
+	{
+		const int32 half = 1 << (numBits - 1);
+		return value.X >= -half && value.X < half && value.Y >= -half && value.Y < half && value.Z >= -half && value.Z < half;
+	}
+
+	bool IsWithin(const FIntVector& a, const FIntVector& b, int32 threshold)
+	{
+		return FMath::Abs(a.X - b.X) <= threshold && FMath::Abs(a.Y - b.Y) <= threshold && FMath::Abs(a.Z - b.Z) <= threshold;
+	}
+
+	/** Writes state as the changes from base, or reads them into a state that starts out as base */
+	void SerializeState(FArchive& Ar, FItemMovementState& state, const FItemMovementState& base)
+	{
+		state.bSimulatingPhysics = SerializeFlag(Ar, state.bSimulatingPhysics);
+		state.bSleeping = SerializeFlag(Ar, state.bSleeping);
+
+		if (SerializeFlag(Ar, state.location != base.location))
+		{
+			FIntVector offset = state.location - base.location;
+			if (SerializeFlag(Ar, FitsSigned(offset, LocationOffsetBits)))
+			{
+				SerializeSignedVector(Ar, offset, LocationOffsetBits);
+				state.location = base.location + offset;
+			}
+			else
+			{
+				for (int32 axis = 0; axis < 3; ++axis)
+				{
+					uint32 value = (uint32)state.location[axis];
+					SerializeUnsigned(Ar, value, FItemMovementState::LocationBits[axis]);
+					state.location[axis] = (int32)value;
+				}
+			}
+		}
+
+		if (SerializeFlag(Ar, state.rotation != base.rotation))
+		{
+			uint32 dropped = state.rotation >> 30;
+			uint32 components = state.rotation & ((1u << 30) - 1);
+			SerializeUnsigned(Ar, dropped, 2);
+			SerializeUnsigned(Ar, components, 30);
+			state.rotation = (dropped << 30) | components;
+		}
+
+		if (SerializeFlag(Ar, state.linearVelocity != base.linearVelocity))
+		{
+			SerializeSignedVector(Ar, state.linearVelocity, FItemMovementState::VelocityBits);
+		}
+
+		if (SerializeFlag(Ar, state.angularVelocity != base.angularVelocity))
+		{
+			SerializeSignedVector(Ar, state.angularVelocity, FItemMovementState::VelocityBits);
+		}
+	}
+
+	float GetLocationStep(const FBox& bounds, int32 axis)
+	{
+		return FMath::Max((bounds.Max[axis] - bounds.Min[axis]) / ((1 << FItemMovementState::LocationBits[axis]) - 1), KINDA_SMALL_NUMBER);
+	}
+
+	FIntVector QuantizeVelocity(const FVector& velocity)
+	{
+		const int32 limit = (1 << (FItemMovementState::VelocityBits - 1)) - 1;
+		return FIntVector(
+			FMath::Clamp(FMath::RoundToInt(velocity.X), -limit, limit),
+			FMath::Clamp(FMath::RoundToInt(velocity.Y), -limit, limit),
+			FMath::Clamp(FMath::RoundToInt(velocity.Z), -limit, limit));
+	}
+}
+
+void FItemMovementState::FromMovement(const FRepMovement& movement, const FBox& bounds)
+{
+	for (int32 axis = 0; axis < 3; ++axis)
+	{
+		const int32 maxStep = (1 << LocationBits[axis]) - 1;
+		location[axis] = FMath::Clamp(FMath::RoundToInt((movement.Location[axis] - bounds.Min[axis]) / GetLocationStep(bounds, axis)), 0, maxStep);
+	}
+
+	rotation = PackRotation(movement.Rotation.Quaternion());
+	linearVelocity = QuantizeVelocity(movement.LinearVelocity);
+	angularVelocity = QuantizeVelocity(movement.AngularVelocity);
+	bSimulatingPhysics = movement.bRepPhysics;
+	bSleeping = movement.bSimulatedPhysicSleep;
+}
+
+void FItemMovementState::ToMovement(FRepMovement& movement, const FBox& bounds) const
+{
+	for (int32 axis = 0; axis < 3; ++axis)
+	{
+		movement.Location[axis] = bounds.Min[axis] + location[axis] * GetLocationStep(bounds, axis);
+	}
+
+	movement.Rotation = UnpackRotation(rotation).Rotator();
+	movement.LinearVelocity = FVector(linearVelocity);
+	movement.AngularVelocity = FVector(angularVelocity);
+	movement.bRepPhysics = bSimulatingPhysics;
+	movement.bSimulatedPhysicSleep = bSleeping;
+}
+
+uint32 FItemMovementState::PackRotation(const FQuat& quat)
+{
+	const FQuat normalized = quat.GetNormalized();
+	const float components[4] = { normalized.X, normalized.Y, normalized.Z, normalized.W };
+
+	int32 dropped = 0;
+	for (int32 i = 1; i < 4; ++i)
+	{
+		if (FMath::Abs(components[i]) > FMath::Abs(components[dropped]))
+		{
+			dropped = i;
+		}
+	}
+
+	//q and -q are the same rotation, flip it so the dropped component is positive and comes back from the other three
+	const float sign = components[dropped] < 0.f ? -1.f : 1.f;
+
+	uint32 packed = (uint32)dropped << 30;
+	int32 shift = 2 * RotationComponentBits;
+	for (int32 i = 0; i < 4; ++i)
+	{
+		if (i == dropped)
+			continue;
+
+		const float unit = FMath::Clamp(components[i] * sign / SmallestComponentRange, -1.f, 1.f);
+		packed |= (uint32)FMath::RoundToInt((unit * 0.5f + 0.5f) * RotationComponentMax) << shift;
+		shift -= RotationComponentBits;
+	}
+
+	return packed;
+}
+
+FQuat FItemMovementState::UnpackRotation(uint32 packed)
+{
+	const int32 dropped = packed >> 30;
+
+	float components[4];
+	float sumSquared = 0.f;
+	int32 shift = 2 * RotationComponentBits;
+	for (int32 i = 0; i < 4; ++i)
+	{
+		if (i == dropped)
+			continue;
+
+		const uint32 value = (packed >> shift) & ((1u << RotationComponentBits) - 1);
+		components[i] = (value / RotationComponentMax * 2.f - 1.f) * SmallestComponentRange;
+		sumSquared += components[i] * components[i];
+		shift -= RotationComponentBits;
+	}
+	components[dropped] = FMath::Sqrt(FMath::Max(1.f - sumSquared, 0.f));
+
+	return FQuat(components[0], components[1], components[2], components[3]).GetNormalized();
+}
+
+bool FItemRepMovement::NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms)
+{
+	//no object references in here
+	if (DeltaParms.GatherGuidReferences)
+		return true;
+
+	if (DeltaParms.MoveGuidToUnmapped)
+		return false;
+
+	if (DeltaParms.bUpdateUnmappedObjects)
+	{
+		DeltaParms.bOutHasMoreUnmapped = false;
+		return true;
+	}
+
+	if (DeltaParms.Writer)
+		return Write(DeltaParms);
+
+	if (DeltaParms.Reader)
+	{
+		Read(*DeltaParms.Reader);
+	}
+
+	return true;
+}
+
+bool FItemRepMovement::Write(FNetDeltaSerializeInfo& DeltaParms)
+{
+	const FItemMovementBaseState* base = static_cast<const FItemMovementBaseState*>(DeltaParms.OldState);
+
+	TSharedPtr<FItemMovementBaseState> newState = MakeShared<FItemMovementBaseState>();
+	newState->state = state;
+
+	if (base)
+	{
+		//small velocity changes keep what the connection already has, a body coming to rest always sends its zeros
+		if (!state.bSleeping)
+		{
+			if (IsWithin(state.linearVelocity, base->state.linearVelocity, linearVelocityThreshold))
+			{
+				newState->state.linearVelocity = base->state.linearVelocity;
+			}
+			if (IsWithin(state.angularVelocity, base->state.angularVelocity, angularVelocityThreshold))
+			{
+				newState->state.angularVelocity = base->state.angularVelocity;
+			}
+		}
+
+		if (newState->state == base->state)
+			return false;
+	}
+
+	newState->nextSequence = base ? base->nextSequence : MakeShared<uint8>(0);
+	newState->sequence = (*newState->nextSequence)++;
+
+	uint32 baseOffset = base ? (uint8)(newState->sequence - base->sequence) : 0;
+	const bool bHasBase = baseOffset >= 1 && baseOffset <= MaxBaseOffset;
+
+	FBitWriter& writer = *DeltaParms.Writer;
+	const int64 startBits = writer.GetNumBits();
+
+	uint32 sequence = newState->sequence;
+	SerializeUnsigned(writer, sequence, SequenceBits);
+	if (SerializeFlag(writer, bHasBase))
+	{
+		SerializeUnsigned(writer, baseOffset, BaseOffsetBits);
+	}
+	SerializeState(writer, newState->state, bHasBase ? base->state : FItemMovementState());
+
+	const int32 bits = (int32)(writer.GetNumBits() - startBits);
+	LLAMA_COUNT(ItemMovementBits, bits);
+	ULoadTestSubsystem::CountItemMovementBits(bits);
+
+	*DeltaParms.NewState = newState;
+	return true;
+}
+
+void FItemRepMovement::Read(FBitReader& reader)
+{
+	uint32 sequence = 0;
+	SerializeUnsigned(reader, sequence, SequenceBits);
+
+	uint32 baseOffset = 0;
+	const bool bHasBase = SerializeFlag(reader, false);
+	if (bHasBase)
+	{
+		SerializeUnsigned(reader, baseOffset, BaseOffsetBits);
+	}
+	else
+	{
+		//the server's channel started over, nothing it sends from now on is built on the old states
+		numReceivedStates = 0;
+	}
+
+	const FItemMovementState* base = nullptr;
+	for (int32 i = 0; bHasBase && i < numReceivedStates; ++i)
+	{
+		if (receivedStates[i].sequence == (uint8)(sequence - baseOffset))
+		{
+			base = &receivedStates[i].state;
+			break;
+		}
+	}
+
+	const FItemMovementState zeroState;
+	FItemMovementState received = base ? *base : zeroState;
+	SerializeState(reader, received, base ? *base : zeroState);
+
+	if (reader.IsError())
+		return;
+
+	//built on an update that was lost, the server rolls back to a base we have once it hears about the loss
+	if (bHasBase && base == nullptr)
+	{
+		LLAMA_COUNT(ItemMovementSkipped, 1);
+		return;
+	}
+
+	state = received;
+	RememberReceived((uint8)sequence, received);
+}
+
+void FItemRepMovement::RememberReceived(uint8 sequence, const FItemMovementState& receivedState)
+{
+	int32 last = FMath::Min(numReceivedStates, NumReceivedStates - 1);
+	for (int32 i = 0; i < numReceivedStates; ++i)
+	{
+		//sent again after a roll back, the older copy goes
+		if (receivedStates[i].sequence == sequence)
+		{
+			last = i;
+			break;
+		}
+	}
+
+	for (int32 i = last; i > 0; --i)
+	{
+		receivedStates[i] = receivedStates[i - 1];
+	}
+
+	receivedStates[0].sequence = sequence;
+	receivedStates[0].state = receivedState;
+	numReceivedStates = FMath::Max(numReceivedStates, last + 1);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Helpers
+
+namespace
+{
+	/** Sends item's state through a fresh writer against base, delivers it to receiver unless it is lost */
+	TSharedPtr<INetDeltaBaseState> SendItemMovement(FItemRepMovement& item, INetDeltaBaseState* base, FItemRepMovement* receiver, int64& outBits)
+	{
+		FBitWriter writer(1024, true);
+		TSharedPtr<INetDeltaBaseState> newState;
+
+		FNetDeltaSerializeInfo writeParms;
+		writeParms.Writer = &writer;
+		writeParms.OldState = base;
+		writeParms.NewState = &newState;
+
+		outBits = 0;
+		if (!item.NetDeltaSerialize(writeParms))
+			return nullptr;
+
+		outBits = writer.GetNumBits();
+		if (receiver)
+		{
+			FBitReader reader(writer.GetData(), writer.GetNumBits());
+			FNetDeltaSerializeInfo readParms;
+			readParms.Reader = &reader;
+			receiver->NetDeltaSerialize(readParms);
+		}
+
+		return newState;
+	}
+
+	/** An item thrown across the floor: bounces, slides and tumbles to a stop, sampled at 30 Hz */
+	TArray<FRepMovement> SimulateTumble(int32 seed)
+	{
+		FRandomStream random(seed);
+		FVector location(random.FRandRange(-100000.f, 100000.f), random.FRandRange(-100000.f, 100000.f), 200.f);
+		FVector velocity(random.FRandRange(-800.f, 800.f), random.FRandRange(-800.f, 800.f), random.FRandRange(300.f, 700.f));
+		FVector angularVelocity = random.GetUnitVector() * random.FRandRange(180.f, 720.f);
+		FQuat rotation(random.GetUnitVector(), random.FRandRange(0.f, PI));
+
+		TArray<FRepMovement> samples;
+		const float dt = 1.f / 30.f;
+		for (int32 frame = 0; frame < 30 * 6; ++frame)
+		{
+			velocity.Z -= 980.f * dt;
+			location += velocity * dt;
+			if (location.Z < 0.f)
+			{
+				location.Z = 0.f;
+				velocity.Z = -velocity.Z * 0.4f;
+				velocity *= 0.8f;
+				angularVelocity *= 0.7f;
+			}
+			if (location.Z == 0.f)
+			{
+				velocity.X *= 0.97f;
+				velocity.Y *= 0.97f;
+			}
+			rotation = FQuat(angularVelocity.GetSafeNormal(), FMath::DegreesToRadians(angularVelocity.Size()) * dt) * rotation;
+
+			FRepMovement sample;
+			sample.Location = location;
+			sample.Rotation = rotation.Rotator();
+			sample.LinearVelocity = velocity;
+			sample.AngularVelocity = angularVelocity;
+			sample.bRepPhysics = true;
+			sample.bSimulatedPhysicSleep = velocity.Size() < 5.f && angularVelocity.Size() < 5.f;
+			samples.Add(sample);
+		}
+
+		return samples;
+	}
+
+	const FBox TestBounds(FVector(-150000.f, -150000.f, -20000.f), FVector(150000.f, 150000.f, 45536.f));
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Tests
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLlamaItemMovementTest, "LlamaLlama.ItemMovement",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+/**
+ * Checks the packing without a world: quantization error stays within a step, deltas decode to the sender's state,
+ * and an update built on a lost one is skipped until the sender rolls back to a base the receiver has.
+ */
+bool FLlamaItemMovementTest::RunTest(const FString& Parameters)
+{
+	{
+		FRandomStream random(1);
+		float worstDegrees = 0.f;
+		for (int32 i = 0; i < 10000; ++i)
+		{
+			const FQuat quat(random.GetUnitVector(), random.FRandRange(-PI, PI));
+			const FQuat unpacked = FItemMovementState::UnpackRotation(FItemMovementState::PackRotation(quat));
+			worstDegrees = FMath::Max(worstDegrees, FMath::RadiansToDegrees(quat.AngularDistance(unpacked)));
+		}
+		TestTrue(*FString::Printf(TEXT("Smallest three rotations are within a quarter degree (worst %.3f)"), worstDegrees), worstDegrees < 0.25f);
+	}
+
+	{
+		FRandomStream random(2);
+		float worstError = 0.f;
+		for (int32 i = 0; i < 10000; ++i)
+		{
+			FRepMovement movement;
+			movement.Location = FVector(
+				random.FRandRange(TestBounds.Min.X, TestBounds.Max.X),
+				random.FRandRange(TestBounds.Min.Y, TestBounds.Max.Y),
+				random.FRandRange(TestBounds.Min.Z, TestBounds.Max.Z));
+			FItemMovementState state;
+			state.FromMovement(movement, TestBounds);
+			FRepMovement unpacked;
+			state.ToMovement(unpacked, TestBounds);
+			worstError = FMath::Max(worstError, (unpacked.Location - movement.Location).GetAbsMax());
+		}
+		TestTrue(*FString::Printf(TEXT("Locations are within half a step of the bounds (worst %.3f)"), worstError),
+			worstError <= 0.5f * GetLocationStep(TestBounds, 0) + KINDA_SMALL_NUMBER);
+	}
+
+	{
+		FItemRepMovement server;
+		FItemRepMovement client;
+		int64 bits = 0;
+		int32 mismatches = 0;
+
+		TSharedPtr<INetDeltaBaseState> base;
+		for (const FRepMovement& sample : SimulateTumble(3))
+		{
+			server.state.FromMovement(sample, TestBounds);
+			if (TSharedPtr<INetDeltaBaseState> sent = SendItemMovement(server, base.Get(), &client, bits))
+			{
+				base = sent;
+			}
+			mismatches += client.state == server.state ? 0 : 1;
+		}
+		TestEqual(TEXT("Deltas that didn't decode to the sender's state"), mismatches, 0);
+	}
+
+	{
+		FItemRepMovement server;
+		FItemRepMovement client;
+		int64 bits = 0;
+		TArray<FRepMovement> samples = SimulateTumble(4);
+
+		server.state.FromMovement(samples[0], TestBounds);
+		TSharedPtr<INetDeltaBaseState> acked = SendItemMovement(server, nullptr, &client, bits);
+
+		server.state.FromMovement(samples[10], TestBounds);
+		TSharedPtr<INetDeltaBaseState> lost = SendItemMovement(server, acked.Get(), nullptr, bits);
+
+		server.state.FromMovement(samples[20], TestBounds);
+		SendItemMovement(server, lost.Get(), &client, bits);
+		TestTrue(TEXT("An update built on a lost one is skipped"), client.state != server.state);
+
+		//the engine hands the base of the lost packet back
+		server.state.FromMovement(samples[30], TestBounds);
+		SendItemMovement(server, acked.Get(), &client, bits);
+		TestTrue(TEXT("The update after the roll back decodes"), client.state == server.state);
+	}
+
+	return true;
+}
+
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+// Benchmark
+
+/** Compares the bits of FRepMovement and FItemRepMovement over tumbling items, every update sent. Optional arg: item count (100) */
+static void BenchItemMovement(const TArray<FString>& Args)
+{
+	const int32 count = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 100;
+
+	int64 stockBits = 0;
+	int64 compactBits = 0;
+	int32 updates = 0;
+	double compactSeconds = 0.0;
+
+	for (int32 item = 0; item < count; ++item)
+	{
+		FItemRepMovement server;
+		server.linearVelocityThreshold = 8;
+		server.angularVelocityThreshold = 15;
+		TSharedPtr<INetDeltaBaseState> base;
+
+		for (const FRepMovement& sample : SimulateTumble(100 + item))
+		{
+			FBitWriter stockWriter(1024, true);
+			FRepMovement stock = sample;
+			bool bSuccess = true;
+			stock.NetSerialize(stockWriter, nullptr, bSuccess);
+			stockBits += stockWriter.GetNumBits();
+
+			const double start = FPlatformTime::Seconds();
+			server.state.FromMovement(sample, TestBounds);
+			int64 bits = 0;
+			if (TSharedPtr<INetDeltaBaseState> sent = SendItemMovement(server, base.Get(), nullptr, bits))
+			{
+				base = sent;
+			}
+			compactSeconds += FPlatformTime::Seconds() - start;
+			compactBits += bits;
+			++updates;
+		}
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("Llama.BenchItemMovement %d items, %d updates: FRepMovement %.1f bits, FItemRepMovement %.1f bits per update (%.0f%%), %.0f ns to pack"),
+		count, updates, (double)stockBits / updates, (double)compactBits / updates,
+		stockBits > 0 ? 100.0 * compactBits / stockBits : 0.0, compactSeconds * 1e9 / updates);
+}
+
+static FAutoConsoleCommandWithArgs BenchItemMovementCommand(
+	TEXT("Llama.BenchItemMovement"),
+	TEXT("Compares FRepMovement and FItemRepMovement bits per update over tumbling items. Optional arg: item count (100)"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BenchItemMovement));
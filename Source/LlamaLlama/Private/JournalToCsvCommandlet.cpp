@@ -0,0 +1,58 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "../Public/JournalToCsvCommandlet.h"
+#include "../Public/EventJournal.h"
+
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+UJournalToCsvCommandlet::UJournalToCsvCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+int32 UJournalToCsvCommandlet::Main(const FString& Params)
+{
+	FString inPath;
+	if (!FParse::Value(*Params, TEXT("in="), inPath))
+	{
+		UE_LOG(LogTemp, Error, TEXT("usage: -run=JournalToCsv -in=<journal> [-out=<csv>]"));
+		return 1;
+	}
+
+	FString outPath;
+	if (!FParse::Value(*Params, TEXT("out="), outPath))
+	{
+		outPath = FPaths::ChangeExtension(inPath, TEXT("csv"));
+	}
+
+	TArray<FLlamaJournalRecord> records;
+	if (!FLlamaEventJournal::ReadFile(inPath, records))
+	{
+		UE_LOG(LogTemp, Error, TEXT("%s is not an event journal"), *inPath);
+		return 1;
+	}
+
+	TArray<FString> lines;
+	lines.Reserve(records.Num() + 1);
+	lines.Add(TEXT("server_time,event,actor,other,x,y,z"));
+	for (const FLlamaJournalRecord& record : records)
+	{
+		lines.Add(FString::Printf(TEXT("%.3f,%s,%u,%u,%.1f,%.1f,%.1f"),
+			record.serverTime, FLlamaJournalRecord::GetTypeName(record.type), record.actorId, record.otherId,
+			record.location.X, record.location.Y, record.location.Z));
+	}
+
+	if (!FFileHelper::SaveStringArrayToFile(lines, *outPath))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Couldn't write %s"), *outPath);
+		return 1;
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("Wrote %d events to %s"), records.Num(), *outPath);
+	return 0;
+}
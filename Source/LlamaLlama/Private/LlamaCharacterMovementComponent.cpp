@@ -0,0 +1,216 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "../Public/LlamaCharacterMovementComponent.h"
+#include "../LlamaLlamaCharacter.h"
+#include "../Public/LoadTestSubsystem.h"
+#include "../LlamaLlama.h"
+
+#include "HAL/IConsoleManager.h"
+
+static TAutoConsoleVariable<int32> CVarPredictMoveState(
+	TEXT("Llama.PredictMoveState"),
+	1,
+	TEXT("1 predicts the carry, stun and push speeds with the saved moves.\n")
+	TEXT("0 sets MaxWalkSpeed when the item replicates, for comparing correction counts. Has to match on server and clients."));
+
+namespace
+{
+	// Action bits sit in the custom compressed flags, right after the engine's jump and crouch bits
+	uint8 ActionsToFlags(uint8 actions)
+	{
+		uint8 flags = 0;
+		if (actions & ELlamaMoveAction::PickUp)
+			flags |= FSavedMove_Character::FLAG_Custom_0;
+		if (actions & ELlamaMoveAction::PrimaryAction)
+			flags |= FSavedMove_Character::FLAG_Custom_1;
+		if (actions & ELlamaMoveAction::SecondaryAction)
+			flags |= FSavedMove_Character::FLAG_Custom_2;
+		return flags;
+	}
+
+	uint8 FlagsToActions(uint8 flags)
+	{
+		uint8 actions = 0;
+		if (flags & FSavedMove_Character::FLAG_Custom_0)
+			actions |= ELlamaMoveAction::PickUp;
+		if (flags & FSavedMove_Character::FLAG_Custom_1)
+			actions |= ELlamaMoveAction::PrimaryAction;
+		if (flags & FSavedMove_Character::FLAG_Custom_2)
+			actions |= ELlamaMoveAction::SecondaryAction;
+		return actions;
+	}
+}
+
+void ULlamaCharacterMovementComponent::QueueAction(ELlamaMoveAction::Type action)
+{
+	pendingActions |= action;
+}
+
+bool ULlamaCharacterMovementComponent::IsMoveStatePredicted()
+{
+	return CVarPredictMoveState.GetValueOnGameThread() != 0;
+}
+
+float ULlamaCharacterMovementComponent::GetMaxSpeed() const
+{
+	if (!IsMoveStatePredicted() || (MovementMode != MOVE_Walking && MovementMode != MOVE_NavWalking && MovementMode != MOVE_Falling))
+		return Super::GetMaxSpeed();
+
+	if (moveState & ELlamaMoveState::Stunned)
+		return stunnedSpeed;
+
+	const float speed = (moveState & ELlamaMoveState::Carrying) ? carrySpeed : MaxWalkSpeed;
+	return (moveState & ELlamaMoveState::Pushing) ? speed * pushSpeedScale : speed;
+}
+
+float ULlamaCharacterMovementComponent::GetMaxAcceleration() const
+{
+	//a stunned llama only brakes
+	if (IsMoveStatePredicted() && (moveState & ELlamaMoveState::Stunned) && stunnedSpeed <= 0.f)
+		return 0.f;
+
+	return Super::GetMaxAcceleration();
+}
+
+bool ULlamaCharacterMovementComponent::CanAttemptJump() const
+{
+	if (IsMoveStatePredicted() && (moveState & ELlamaMoveState::Stunned))
+		return false;
+
+	return Super::CanAttemptJump();
+}
+
+void ULlamaCharacterMovementComponent::UpdateFromCompressedFlags(uint8 Flags)
+{
+	Super::UpdateFromCompressedFlags(Flags);
+
+	//clients run this again when they replay their saved moves, the actions were already predicted then
+	if (!CharacterOwner || CharacterOwner->Role < ROLE_Authority)
+		return;
+
+	//moves, not RPCs, several can arrive in one ServerMove so they stay out of the rpc breakdown
+	LLAMA_COUNT(ReceivedMoves, 1);
+
+	const uint8 actions = FlagsToActions(Flags);
+	if (actions != 0)
+	{
+		LLAMA_COUNT(ReceivedActionPresses, 1);
+		if (ALlamaLlamaCharacter* llama = Cast<ALlamaLlamaCharacter>(CharacterOwner))
+		{
+			llama->HandleMoveActions(actions);
+		}
+	}
+}
+
+bool ULlamaCharacterMovementComponent::ClientUpdatePositionAfterServerUpdate()
+{
+	//the replay leaves the last saved move's state behind, a change that replicated since then hasn't been simulated yet
+	const uint8 currentState = moveState;
+	const bool bResult = Super::ClientUpdatePositionAfterServerUpdate();
+	moveState = currentState;
+	return bResult;
+}
+
+void ULlamaCharacterMovementComponent::SendClientAdjustment()
+{
+	//counted here rather than in ServerMoveHandleClientError, several bad moves in one frame still make one correction
+	const FNetworkPredictionData_Server_Character* serverData = HasPredictionData_Server() ? GetPredictionData_Server_Character() : nullptr;
+	if (serverData && serverData->PendingAdjustment.TimeStamp > 0.f && !serverData->PendingAdjustment.bAckGoodMove)
+	{
+		LLAMA_COUNT_RPC(Sent_ClientAdjustPosition);
+	}
+
+	Super::SendClientAdjustment();
+}
+
+void ULlamaCharacterMovementComponent::ClientAdjustPosition_Implementation(float TimeStamp, FVector NewLoc, FVector NewVel, UPrimitiveComponent* NewBase, FName NewBaseBoneName, bool bHasBase, bool bBaseRelativePosition, uint8 ServerMovementMode)
+{
+	//the very short variant ends up in here too
+	++numCorrections;
+	LLAMA_COUNT_RPC(Received_ClientAdjustPosition);
+
+	Super::ClientAdjustPosition_Implementation(TimeStamp, NewLoc, NewVel, NewBase, NewBaseBoneName, bHasBase, bBaseRelativePosition, ServerMovementMode);
+}
+
+FNetworkPredictionData_Client* ULlamaCharacterMovementComponent::GetPredictionData_Client() const
+{
+	if (ClientPredictionData == nullptr)
+	{
+		ULlamaCharacterMovementComponent* MutableThis = const_cast<ULlamaCharacterMovementComponent*>(this);
+		MutableThis->ClientPredictionData = new FNetworkPredictionData_Client_Llama(*this);
+	}
+
+	return ClientPredictionData;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// FSavedMove_Llama
+
+void FSavedMove_Llama::Clear()
+{
+	Super::Clear();
+
+	savedActions = 0;
+	savedMoveState = 0;
+}
+
+uint8 FSavedMove_Llama::GetCompressedFlags() const
+{
+	return Super::GetCompressedFlags() | ActionsToFlags(savedActions);
+}
+
+bool FSavedMove_Llama::CanCombineWith(const FSavedMovePtr& NewMove, ACharacter* InCharacter, float MaxDelta) const
+{
+	//a press has to keep its own timestamp
+	const FSavedMove_Llama* newLlamaMove = (FSavedMove_Llama*)NewMove.Get();
+	if (savedActions != 0 || newLlamaMove->savedActions != 0)
+		return false;
+
+	//moves with different speeds can't be replayed as one
+	if (savedMoveState != newLlamaMove->savedMoveState)
+		return false;
+
+	return Super::CanCombineWith(NewMove, InCharacter, MaxDelta);
+}
+
+bool FSavedMove_Llama::IsImportantMove(const FSavedMovePtr& LastAckedMove) const
+{
+	//resent with the next move if the packet carrying it gets lost
+	return savedActions != 0 || Super::IsImportantMove(LastAckedMove);
+}
+
+void FSavedMove_Llama::SetMoveFor(ACharacter* C, float InDeltaTime, FVector const& NewAccel, FNetworkPredictionData_Client_Character& ClientData)
+{
+	Super::SetMoveFor(C, InDeltaTime, NewAccel, ClientData);
+
+	if (ULlamaCharacterMovementComponent* movement = Cast<ULlamaCharacterMovementComponent>(C->GetCharacterMovement()))
+	{
+		savedActions = movement->pendingActions;
+		savedMoveState = movement->moveState;
+		movement->pendingActions = 0;
+	}
+}
+
+void FSavedMove_Llama::PrepMoveFor(ACharacter* C)
+{
+	Super::PrepMoveFor(C);
+
+	if (ULlamaCharacterMovementComponent* movement = Cast<ULlamaCharacterMovementComponent>(C->GetCharacterMovement()))
+	{
+		movement->moveState = savedMoveState;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+// FNetworkPredictionData_Client_Llama
+
+FNetworkPredictionData_Client_Llama::FNetworkPredictionData_Client_Llama(const UCharacterMovementComponent& ClientMovement)
+	: Super(ClientMovement)
+{
+}
+
+FSavedMovePtr FNetworkPredictionData_Client_Llama::AllocateNewMove()
+{
+	return FSavedMovePtr(new FSavedMove_Llama());
+}
@@ -0,0 +1,115 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "../Public/LlamaLlamaGameState.h"
+#include "../Public/BaseItem.h"
+#include "../LlamaLlamaCharacter.h"
+#include "../LlamaLlama.h"
+
+#include "Net/UnrealNetwork.h"
+
+void FLlamaInventoryEntry::PreReplicatedRemove(const FLlamaInventory& inventory)
+{
+	Release();
+}
+
+void FLlamaInventoryEntry::PostReplicatedAdd(const FLlamaInventory& inventory)
+{
+	Apply();
+}
+
+void FLlamaInventoryEntry::PostReplicatedChange(const FLlamaInventory& inventory)
+{
+	//handed to another llama, or a reference that was missing on arrival resolved
+	Apply();
+}
+
+void FLlamaInventoryEntry::Apply()
+{
+	if (appliedLlama.Get() == llama && appliedItem.Get() == item)
+		return;
+
+	Release();
+
+	if (llama && item)
+	{
+		llama->CarryItem(item);
+		appliedLlama = llama;
+		appliedItem = item;
+	}
+}
+
+void FLlamaInventoryEntry::Release()
+{
+	ALlamaLlamaCharacter* oldLlama = appliedLlama.Get();
+	ABaseItem* oldItem = appliedItem.Get();
+	appliedLlama.Reset();
+	appliedItem.Reset();
+
+	if (oldLlama && oldItem)
+	{
+		oldLlama->ReleaseItem(oldItem);
+	}
+}
+
+void ALlamaLlamaGameState::SetItemCarrier(ABaseItem* item, ALlamaLlamaCharacter* carrier)
+{
+	if (Role < ROLE_Authority || item == nullptr)
+		return;
+
+	//llamas and items that left play while carrying or carried
+	const int32 numRemoved = inventory.entries.RemoveAllSwap([](const FLlamaInventoryEntry& entry) { return !IsValid(entry.llama) || !IsValid(entry.item); });
+	if (numRemoved > 0)
+	{
+		inventory.MarkArrayDirty();
+	}
+
+	FLlamaInventoryEntry* itemEntry = inventory.entries.FindByPredicate([item](const FLlamaInventoryEntry& entry) { return entry.item == item; });
+
+	if (carrier == nullptr)
+	{
+		if (itemEntry)
+		{
+			inventory.entries.RemoveAtSwap(itemEntry - inventory.entries.GetData());
+			inventory.MarkArrayDirty();
+		}
+	}
+	else if (itemEntry)
+	{
+		itemEntry->llama = carrier;
+		inventory.MarkItemDirty(*itemEntry);
+	}
+	else
+	{
+		FLlamaInventoryEntry& entry = inventory.entries.AddDefaulted_GetRef();
+		entry.llama = carrier;
+		entry.item = item;
+		inventory.MarkItemDirty(entry);
+	}
+
+	LLAMA_COUNT(InventoryChanges, 1);
+
+	//a pick up or a drop shouldn't wait for the game state's slow update rate
+	ForceNetUpdate();
+}
+
+void ALlamaLlamaGameState::RemoveLlama(ALlamaLlamaCharacter* llama)
+{
+	if (Role < ROLE_Authority || llama == nullptr)
+		return;
+
+	const int32 numRemoved = inventory.entries.RemoveAllSwap([llama](const FLlamaInventoryEntry& entry) { return entry.llama == llama; });
+	if (numRemoved > 0)
+	{
+		inventory.MarkArrayDirty();
+		LLAMA_COUNT(InventoryChanges, numRemoved);
+		ForceNetUpdate();
+	}
+}
+
+void ALlamaLlamaGameState::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(ALlamaLlamaGameState, inventory);
+}
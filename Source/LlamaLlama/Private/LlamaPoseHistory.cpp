@@ -0,0 +1,206 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "../Public/LlamaPoseHistory.h"
+
+#include "Misc/AutomationTest.h"
+
+FLlamaPoseSnapshot FLlamaPoseSnapshot::Lerp(const FLlamaPoseSnapshot& a, const FLlamaPoseSnapshot& b, float alpha)
+{
+	FLlamaPoseSnapshot result;
+	result.serverTime = FMath::Lerp(a.serverTime, b.serverTime, alpha);
+	result.capsuleLocation = FMath::Lerp(a.capsuleLocation, b.capsuleLocation, alpha);
+	result.leftHand = FMath::Lerp(a.leftHand, b.leftHand, alpha);
+	result.rightHand = FMath::Lerp(a.rightHand, b.rightHand, alpha);
+	return result;
+}
+
+void FLlamaPoseHistory::Record(const FLlamaPoseSnapshot& snapshot)
+{
+	snapshots[head] = snapshot;
+	head = (head + 1) % Capacity;
+	num = FMath::Min(num + 1, Capacity);
+}
+
+const FLlamaPoseSnapshot& FLlamaPoseHistory::Get(int32 indexFromOldest) const
+{
+	return snapshots[(head - num + indexFromOldest + Capacity) % Capacity];
+}
+
+bool FLlamaPoseHistory::Sample(float time, FLlamaPoseSnapshot& outSnapshot) const
+{
+	if (num == 0)
+		return false;
+
+	const FLlamaPoseSnapshot& newest = Get(num - 1);
+	if (time >= newest.serverTime)
+	{
+		outSnapshot = newest;
+		return true;
+	}
+
+	//walk back from the newest, rewinds are short so this rarely goes far
+	for (int32 i = num - 2; i >= 0; --i)
+	{
+		const FLlamaPoseSnapshot& older = Get(i);
+		if (older.serverTime <= time)
+		{
+			const FLlamaPoseSnapshot& newer = Get(i + 1);
+			const float span = newer.serverTime - older.serverTime;
+			const float alpha = span > KINDA_SMALL_NUMBER ? (time - older.serverTime) / span : 0.f;
+			outSnapshot = FLlamaPoseSnapshot::Lerp(older, newer, alpha);
+			return true;
+		}
+	}
+
+	outSnapshot = Get(0);
+	return true;
+}
+
+bool FLlamaPoseHistory::TestPushHit(const FLlamaPoseSnapshot& previousPose, const FLlamaPoseSnapshot& currentPose, float handRadius, float rewindTime,
+	float capsuleRadius, float capsuleHalfHeight, FVector& outRewoundLocation) const
+{
+	FLlamaPoseSnapshot rewound;
+	if (!Sample(rewindTime, rewound))
+		return false;
+
+	outRewoundLocation = rewound.capsuleLocation;
+	return TestHandSweep(previousPose.leftHand, currentPose.leftHand, handRadius, rewound.capsuleLocation, capsuleRadius, capsuleHalfHeight)
+		|| TestHandSweep(previousPose.rightHand, currentPose.rightHand, handRadius, rewound.capsuleLocation, capsuleRadius, capsuleHalfHeight);
+}
+
+bool FLlamaPoseHistory::TestHandHit(const FVector& hand, float handRadius, const FVector& capsuleLocation, float capsuleRadius, float capsuleHalfHeight)
+{
+	//closest point on the capsule's inner segment
+	const float segmentHalfLength = FMath::Max(capsuleHalfHeight - capsuleRadius, 0.f);
+	const FVector closest(capsuleLocation.X, capsuleLocation.Y, FMath::Clamp(hand.Z, capsuleLocation.Z - segmentHalfLength, capsuleLocation.Z + segmentHalfLength));
+	return FVector::DistSquared(hand, closest) <= FMath::Square(handRadius + capsuleRadius);
+}
+
+bool FLlamaPoseHistory::TestHandSweep(const FVector& handStart, const FVector& handEnd, float handRadius, const FVector& capsuleLocation, float capsuleRadius, float capsuleHalfHeight)
+{
+	const float segmentHalfLength = FMath::Max(capsuleHalfHeight - capsuleRadius, 0.f);
+	const FVector capsuleBottom = capsuleLocation - FVector(0.f, 0.f, segmentHalfLength);
+	const FVector capsuleTop = capsuleLocation + FVector(0.f, 0.f, segmentHalfLength);
+
+	FVector closestOnHand;
+	FVector closestOnCapsule;
+	FMath::SegmentDistToSegmentSafe(handStart, handEnd, capsuleBottom, capsuleTop, closestOnHand, closestOnCapsule);
+	return FVector::DistSquared(closestOnHand, closestOnCapsule) <= FMath::Square(handRadius + capsuleRadius);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Tests
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLlamaPushRewindTest, "LlamaLlama.PushRewind",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+/**
+ * A victim walks through the attacker's reach between 0.5 and 0.7 s and is out of it before and after, recorded at
+ * 60 Hz like the server does. Pushes are checked the way ResolvePushHits does, at the last recorded time rewound by the
+ * attacker's ping and clamped to the rewind cap.
+ */
+bool FLlamaPushRewindTest::RunTest(const FString& Parameters)
+{
+	const float tickRate = 60.f;
+	const float handRadius = 5.f;
+	const float capsuleRadius = 42.f;
+	const float capsuleHalfHeight = 96.f;
+	const FVector inReach(100.f, 0.f, 0.f);
+	const FVector outOfReach(100.f, 500.f, 0.f);
+
+	FLlamaPoseHistory victim;
+	float now = 0.f;
+	for (int32 frame = 0; frame < 60; ++frame)
+	{
+		FLlamaPoseSnapshot snapshot;
+		snapshot.serverTime = frame / tickRate;
+		snapshot.capsuleLocation = (snapshot.serverTime >= 0.5f && snapshot.serverTime < 0.7f) ? inReach : outOfReach;
+		victim.Record(snapshot);
+		now = snapshot.serverTime;
+	}
+
+	//the left hand swings out to 60 units in front of the attacker, the right one stays well clear
+	FLlamaPoseSnapshot previousPose;
+	previousPose.leftHand = FVector(0.f, -30.f, 0.f);
+	previousPose.rightHand = FVector(-1000.f, 0.f, 0.f);
+	FLlamaPoseSnapshot currentPose = previousPose;
+	currentPose.leftHand = FVector(60.f, 0.f, 0.f);
+
+	auto testPush = [&](float ping, float maxRewind, FVector& outRewoundLocation)
+	{
+		const float rewindTime = now - FLlamaPoseHistory::GetPushRewind(ping, maxRewind);
+		return victim.TestPushHit(previousPose, currentPose, handRadius, rewindTime, capsuleRadius, capsuleHalfHeight, outRewoundLocation);
+	};
+
+	FVector rewound;
+	TestFalse(TEXT("Push without rewind misses the victim that walked out of reach"), testPush(0.f, 0.4f, rewound));
+	TestEqual(TEXT("Unrewound victim location"), rewound, outOfReach);
+
+	TestTrue(TEXT("Push at 400 ms hits the victim where the attacker saw it"), testPush(0.4f, 0.5f, rewound));
+	TestEqual(TEXT("Victim rewound 400 ms"), rewound, inReach);
+
+	TestFalse(TEXT("Push at 100 ms misses"), testPush(0.1f, 0.5f, rewound));
+
+	//800 ms of ping unclamped would rewind to before the victim walked in
+	TestFalse(TEXT("Unclamped 800 ms rewind misses"), testPush(0.8f, 1.f, rewound));
+	TestEqual(TEXT("Rewind is clamped to the cap"), FLlamaPoseHistory::GetPushRewind(0.8f, 0.45f), 0.45f);
+	TestTrue(TEXT("Push at 800 ms clamped to 450 ms hits"), testPush(0.8f, 0.45f, rewound));
+	TestEqual(TEXT("Negative ping doesn't rewind forward"), FLlamaPoseHistory::GetPushRewind(-0.1f, 0.45f), 0.f);
+
+	//at 50, 150 and 300 ms a victim in reach when the attacker saw it is hit, one that only walked in since is missed
+	for (const float latency : { 0.05f, 0.15f, 0.3f })
+	{
+		const float seenTime = now - latency;
+		FLlamaPoseHistory seenInReach;
+		FLlamaPoseHistory walkedInSince;
+		for (int32 frame = 0; frame < 60; ++frame)
+		{
+			FLlamaPoseSnapshot snapshot;
+			snapshot.serverTime = frame / tickRate;
+			snapshot.capsuleLocation = FMath::Abs(snapshot.serverTime - seenTime) < 0.04f ? inReach : outOfReach;
+			seenInReach.Record(snapshot);
+
+			snapshot.capsuleLocation = snapshot.serverTime > seenTime + 0.04f ? inReach : outOfReach;
+			walkedInSince.Record(snapshot);
+		}
+
+		const float rewindTime = now - FLlamaPoseHistory::GetPushRewind(latency, 0.5f);
+		const int32 ms = FMath::RoundToInt(latency * 1000.f);
+
+		TestTrue(FString::Printf(TEXT("Push at %d ms hits the victim where the attacker saw it"), ms),
+			seenInReach.TestPushHit(previousPose, currentPose, handRadius, rewindTime, capsuleRadius, capsuleHalfHeight, rewound));
+		TestEqual(FString::Printf(TEXT("Victim rewound %d ms into reach"), ms), rewound, inReach);
+
+		TestFalse(FString::Printf(TEXT("Push at %d ms misses the victim that walked in since"), ms),
+			walkedInSince.TestPushHit(previousPose, currentPose, handRadius, rewindTime, capsuleRadius, capsuleHalfHeight, rewound));
+		TestEqual(FString::Printf(TEXT("Victim rewound %d ms out of reach"), ms), rewound, outOfReach);
+	}
+
+	//rewinding past the ring buffer lands on the oldest snapshot it still has
+	FLlamaPoseHistory longHistory;
+	for (int32 frame = 0; frame < FLlamaPoseHistory::Capacity * 2; ++frame)
+	{
+		FLlamaPoseSnapshot snapshot;
+		snapshot.serverTime = frame / tickRate;
+		snapshot.capsuleLocation = FVector(frame, 0.f, 0.f);
+		longHistory.Record(snapshot);
+	}
+	FLlamaPoseSnapshot oldest;
+	TestTrue(TEXT("Sampling a full history"), longHistory.Sample(0.f, oldest));
+	TestEqual(TEXT("Sampling before the oldest snapshot clamps to it"), oldest.capsuleLocation, FVector(FLlamaPoseHistory::Capacity, 0.f, 0.f));
+
+	//between two snapshots the pose is interpolated
+	FLlamaPoseSnapshot between;
+	longHistory.Sample((FLlamaPoseHistory::Capacity + 10.5f) / tickRate, between);
+	TestEqual(TEXT("Sampling between snapshots interpolates"), between.capsuleLocation.X, FLlamaPoseHistory::Capacity + 10.5f, 0.01f);
+
+	FLlamaPoseHistory empty;
+	TestFalse(TEXT("An empty history can't be hit"), empty.TestPushHit(previousPose, currentPose, handRadius, 0.f, capsuleRadius, capsuleHalfHeight, rewound));
+
+	return true;
+}
+
+#endif
@@ -0,0 +1,273 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "../Public/LlamaReplicationGraph.h"
+#include "../Public/BaseItem.h"
+#include "../LlamaLlamaCharacter.h"
+
+#include "Engine/LevelScriptActor.h"
+#include "Engine/NetDriver.h"
+#include "GameFramework/Info.h"
+#include "GameFramework/PlayerController.h"
+#include "UObject/UObjectIterator.h"
+#include "Algo/AnyOf.h"
+
+int32 ULlamaReplicationGraph::ServerReplicateActors(float DeltaSeconds)
+{
+	const double start = FPlatformTime::Seconds();
+	const int32 result = Super::ServerReplicateActors(DeltaSeconds);
+	lastReplicateSeconds = FPlatformTime::Seconds() - start;
+	return result;
+}
+
+void ULlamaReplicationGraph::InitForNetDriver(UNetDriver* InNetDriver)
+{
+	Super::InitForNetDriver(InNetDriver);
+
+	carrierChangedHandle = ABaseItem::OnCarrierChanged.AddUObject(this, &ULlamaReplicationGraph::OnItemCarrierChanged);
+	netUpdateFrequencyChangedHandle = ABaseItem::OnNetUpdateFrequencyChanged.AddUObject(this, &ULlamaReplicationGraph::OnItemNetUpdateFrequencyChanged);
+}
+
+void ULlamaReplicationGraph::BeginDestroy()
+{
+	ABaseItem::OnCarrierChanged.Remove(carrierChangedHandle);
+	ABaseItem::OnNetUpdateFrequencyChanged.Remove(netUpdateFrequencyChangedHandle);
+
+	Super::BeginDestroy();
+}
+
+void ULlamaReplicationGraph::InitGlobalActorClassSettings()
+{
+	Super::InitGlobalActorClassSettings();
+
+	// Explicit routes, subclasses inherit them, everything else is derived from the class defaults below
+	const TPair<UClass*, ELlamaRepNodeMapping> explicitRoutes[] = {
+		{ AReplicationGraphDebugActor::StaticClass(), ELlamaRepNodeMapping::NotRouted },
+		{ ALevelScriptActor::StaticClass(), ELlamaRepNodeMapping::NotRouted },
+		{ APlayerController::StaticClass(), ELlamaRepNodeMapping::NotRouted },
+		{ AInfo::StaticClass(), ELlamaRepNodeMapping::RelevantAllConnections },
+		{ ALlamaLlamaCharacter::StaticClass(), ELlamaRepNodeMapping::Spatialize_Dynamic },
+		{ ABaseItem::StaticClass(), ELlamaRepNodeMapping::Spatialize_Dormancy },
+	};
+	for (const auto& route : explicitRoutes)
+	{
+		classRepNodePolicies.Set(route.Key, route.Value);
+	}
+
+	for (TObjectIterator<UClass> It; It; ++It)
+	{
+		UClass* Class = *It;
+		AActor* ActorCDO = Cast<AActor>(Class->GetDefaultObject());
+		if (!ActorCDO || !ActorCDO->GetIsReplicated())
+			continue;
+
+		// Skip blueprint compiler leftovers
+		if (Class->GetName().StartsWith(TEXT("SKEL_")) || Class->GetName().StartsWith(TEXT("REINST_")))
+			continue;
+
+		const bool bSpatialize = !(ActorCDO->bAlwaysRelevant || ActorCDO->bOnlyRelevantToOwner || ActorCDO->bNetUseOwnerRelevancy);
+
+		// Get walks up to the explicit route, a policy of its own would shadow it
+		const bool bExplicitRoute = Algo::AnyOf(explicitRoutes, [Class](const TPair<UClass*, ELlamaRepNodeMapping>& route) { return Class->IsChildOf(route.Key); });
+
+		if (!bExplicitRoute)
+		{
+			if (bSpatialize)
+			{
+				classRepNodePolicies.Set(Class, ActorCDO->GetRootComponent() && ActorCDO->GetRootComponent()->Mobility == EComponentMobility::Static
+					? ELlamaRepNodeMapping::Spatialize_Static
+					: ELlamaRepNodeMapping::Spatialize_Dynamic);
+			}
+			else if (ActorCDO->bAlwaysRelevant && !ActorCDO->bOnlyRelevantToOwner)
+			{
+				classRepNodePolicies.Set(Class, ELlamaRepNodeMapping::RelevantAllConnections);
+			}
+			else
+			{
+				classRepNodePolicies.Set(Class, ELlamaRepNodeMapping::NotRouted);
+			}
+		}
+
+		FClassReplicationInfo ClassInfo;
+		InitClassReplicationInfo(ClassInfo, Class, bSpatialize);
+		GlobalActorReplicationInfoMap.SetClassInfo(Class, ClassInfo);
+	}
+}
+
+void ULlamaReplicationGraph::InitGlobalGraphNodes()
+{
+	PreAllocateRepList(3, 12);
+	PreAllocateRepList(6, 12);
+	PreAllocateRepList(128, 64);
+	PreAllocateRepList(512, 16);
+
+	gridNode = CreateNewNode<UReplicationGraphNode_GridSpatialization2D>();
+	gridNode->CellSize = gridCellSize;
+	gridNode->SpatialBias = gridSpatialBias;
+	AddGlobalGraphNode(gridNode);
+
+	alwaysRelevantNode = CreateNewNode<UReplicationGraphNode_ActorList>();
+	AddGlobalGraphNode(alwaysRelevantNode);
+}
+
+void ULlamaReplicationGraph::InitConnectionGraphNodes(UNetReplicationGraphConnection* RepGraphConnection)
+{
+	Super::InitConnectionGraphNodes(RepGraphConnection);
+
+	// The connection's own player controller and view target
+	UReplicationGraphNode_AlwaysRelevant_ForConnection* alwaysRelevantForConnectionNode = CreateNewNode<UReplicationGraphNode_AlwaysRelevant_ForConnection>();
+	AddConnectionGraphNode(alwaysRelevantForConnectionNode, RepGraphConnection);
+}
+
+void ULlamaReplicationGraph::RouteAddNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& GlobalInfo)
+{
+	// Items spawned or loaded while already carried ride along with their carrier
+	if (ABaseItem* item = Cast<ABaseItem>(ActorInfo.Actor))
+	{
+		if (item->carrier)
+		{
+			AddDependentItem(item, item->carrier);
+			return;
+		}
+	}
+
+	AddToPolicyNode(ActorInfo, GlobalInfo);
+}
+
+void ULlamaReplicationGraph::RouteRemoveNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo)
+{
+	if (ABaseItem* item = Cast<ABaseItem>(ActorInfo.Actor))
+	{
+		if (item->carrier)
+		{
+			RemoveDependentItem(item, item->carrier);
+			return;
+		}
+	}
+
+	RemoveFromPolicyNode(ActorInfo);
+}
+
+void ULlamaReplicationGraph::AddToPolicyNode(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& GlobalInfo)
+{
+	switch (GetMappingPolicy(ActorInfo.Class))
+	{
+	case ELlamaRepNodeMapping::RelevantAllConnections:
+		alwaysRelevantNode->NotifyAddNetworkActor(ActorInfo);
+		break;
+	case ELlamaRepNodeMapping::Spatialize_Static:
+		gridNode->AddActor_Static(ActorInfo, GlobalInfo);
+		break;
+	case ELlamaRepNodeMapping::Spatialize_Dynamic:
+		gridNode->AddActor_Dynamic(ActorInfo, GlobalInfo);
+		break;
+	case ELlamaRepNodeMapping::Spatialize_Dormancy:
+		gridNode->AddActor_Dormancy(ActorInfo, GlobalInfo);
+		break;
+	default:
+		break;
+	}
+}
+
+void ULlamaReplicationGraph::RemoveFromPolicyNode(const FNewReplicatedActorInfo& ActorInfo)
+{
+	switch (GetMappingPolicy(ActorInfo.Class))
+	{
+	case ELlamaRepNodeMapping::RelevantAllConnections:
+		alwaysRelevantNode->NotifyRemoveNetworkActor(ActorInfo);
+		break;
+	case ELlamaRepNodeMapping::Spatialize_Static:
+		gridNode->RemoveActor_Static(ActorInfo);
+		break;
+	case ELlamaRepNodeMapping::Spatialize_Dynamic:
+		gridNode->RemoveActor_Dynamic(ActorInfo);
+		break;
+	case ELlamaRepNodeMapping::Spatialize_Dormancy:
+		gridNode->RemoveActor_Dormancy(ActorInfo);
+		break;
+	default:
+		break;
+	}
+}
+
+ELlamaRepNodeMapping ULlamaReplicationGraph::GetMappingPolicy(UClass* Class)
+{
+	ELlamaRepNodeMapping* PolicyPtr = classRepNodePolicies.Get(Class);
+	return PolicyPtr ? *PolicyPtr : ELlamaRepNodeMapping::NotRouted;
+}
+
+void ULlamaReplicationGraph::InitClassReplicationInfo(FClassReplicationInfo& Info, UClass* Class, bool bSpatialize) const
+{
+	AActor* CDO = Class->GetDefaultObject<AActor>();
+	if (bSpatialize)
+	{
+		Info.CullDistanceSquared = CDO->NetCullDistanceSquared;
+	}
+
+	Info.ReplicationPeriodFrame = GetReplicationPeriodFrame(CDO->NetUpdateFrequency);
+}
+
+uint32 ULlamaReplicationGraph::GetReplicationPeriodFrame(float netUpdateFrequency) const
+{
+	const float serverMaxTickRate = NetDriver ? NetDriver->NetServerMaxTickRate : 30.f;
+	return FMath::Max<uint32>((uint32)FMath::RoundToFloat(serverMaxTickRate / netUpdateFrequency), 1);
+}
+
+void ULlamaReplicationGraph::OnItemNetUpdateFrequencyChanged(ABaseItem* item)
+{
+	if (!IsGraphItem(item))
+		return;
+
+	if (FGlobalActorReplicationInfo* itemInfo = GlobalActorReplicationInfoMap.Find(item))
+	{
+		itemInfo->Settings.ReplicationPeriodFrame = GetReplicationPeriodFrame(item->NetUpdateFrequency);
+	}
+}
+
+bool ULlamaReplicationGraph::IsGraphItem(const ABaseItem* item) const
+{
+	return item && NetDriver && item->GetWorld() == NetDriver->GetWorld() && item->GetNetDriverName() == NetDriver->NetDriverName;
+}
+
+void ULlamaReplicationGraph::OnItemCarrierChanged(ABaseItem* item, ALlamaLlamaCharacter* newCarrier, ALlamaLlamaCharacter* oldCarrier)
+{
+	if (!IsGraphItem(item) || newCarrier == oldCarrier)
+		return;
+
+	FNewReplicatedActorInfo itemInfo(item);
+
+	if (oldCarrier)
+	{
+		RemoveDependentItem(item, oldCarrier);
+	}
+	else
+	{
+		RemoveFromPolicyNode(itemInfo);
+	}
+
+	if (newCarrier)
+	{
+		AddDependentItem(item, newCarrier);
+	}
+	else
+	{
+		AddToPolicyNode(itemInfo, GlobalActorReplicationInfoMap.Get(item));
+	}
+}
+
+void ULlamaReplicationGraph::AddDependentItem(ABaseItem* item, ALlamaLlamaCharacter* carrier)
+{
+	FGlobalActorReplicationInfo& carrierInfo = GlobalActorReplicationInfoMap.Get(carrier);
+	carrierInfo.DependentActorList.PrepareForWrite();
+	if (!carrierInfo.DependentActorList.Contains(item))
+	{
+		carrierInfo.DependentActorList.Add(item);
+	}
+}
+
+void ULlamaReplicationGraph::RemoveDependentItem(ABaseItem* item, ALlamaLlamaCharacter* carrier)
+{
+	FGlobalActorReplicationInfo& carrierInfo = GlobalActorReplicationInfoMap.Get(carrier);
+	carrierInfo.DependentActorList.PrepareForWrite();
+	carrierInfo.DependentActorList.Remove(item);
+}
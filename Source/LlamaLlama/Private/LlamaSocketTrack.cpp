@@ -0,0 +1,113 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "../Public/LlamaSocketTrack.h"
+
+#include "Animation/AnimMontage.h"
+#include "Animation/AnimSequence.h"
+#include "Animation/Skeleton.h"
+#include "Engine/SkeletalMesh.h"
+#include "Engine/SkeletalMeshSocket.h"
+#include "UObject/ObjectKey.h"
+
+const float FLlamaSocketTrack::SampleRate = 30.f;
+
+namespace
+{
+	typedef TPair<FObjectKey, FObjectKey> FSocketTrackKey;
+
+	TMap<FSocketTrackKey, TSharedPtr<const FLlamaSocketTrack>>& GetCache()
+	{
+		static TMap<FSocketTrackKey, TSharedPtr<const FLlamaSocketTrack>> cache;
+		return cache;
+	}
+}
+
+TSharedPtr<const FLlamaSocketTrack> FLlamaSocketTrack::FindOrBake(UAnimMontage* montage, USkeletalMesh* mesh, const TArray<FName>& sockets)
+{
+	if (montage == nullptr || mesh == nullptr)
+		return nullptr;
+
+	//misses are cached too, a montage that can't be baked shouldn't be retried every frame
+	const FSocketTrackKey key(montage, mesh);
+	if (const TSharedPtr<const FLlamaSocketTrack>* found = GetCache().Find(key))
+		return *found;
+
+	TSharedPtr<FLlamaSocketTrack> track = MakeShared<FLlamaSocketTrack>();
+	if (!track->Bake(montage, mesh, sockets))
+	{
+		track.Reset();
+	}
+
+	GetCache().Add(key, track);
+	return track;
+}
+
+FVector FLlamaSocketTrack::Sample(int32 socketIndex, float position) const
+{
+	const float frame = FMath::Clamp(position * SampleRate, 0.f, (float)(numFrames - 1));
+	const int32 frameA = FMath::FloorToInt(frame);
+	const int32 frameB = FMath::Min(frameA + 1, numFrames - 1);
+	return FMath::Lerp(samples[frameA * numSockets + socketIndex], samples[frameB * numSockets + socketIndex], frame - frameA);
+}
+
+bool FLlamaSocketTrack::Bake(UAnimMontage* montage, USkeletalMesh* mesh, const TArray<FName>& sockets)
+{
+	USkeleton* skeleton = mesh->Skeleton;
+	if (skeleton == nullptr || montage->SlotAnimTracks.Num() == 0)
+		return false;
+
+	const FReferenceSkeleton& refSkeleton = skeleton->GetReferenceSkeleton();
+	const TArray<FTransform>& refPose = refSkeleton.GetRefBonePose();
+
+	TArray<const USkeletalMeshSocket*> meshSockets;
+	TArray<int32> socketBones;
+	for (const FName& socketName : sockets)
+	{
+		const USkeletalMeshSocket* socket = mesh->FindSocket(socketName);
+		const int32 bone = socket ? refSkeleton.FindBoneIndex(socket->BoneName) : INDEX_NONE;
+		if (bone == INDEX_NONE)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Can't bake %s on %s, socket %s is missing"), *montage->GetName(), *mesh->GetName(), *socketName.ToString());
+			return false;
+		}
+
+		meshSockets.Add(socket);
+		socketBones.Add(bone);
+	}
+
+	const FAnimTrack& animTrack = montage->SlotAnimTracks[0].AnimTrack;
+	const float length = montage->GetPlayLength();
+
+	numSockets = sockets.Num();
+	numFrames = FMath::Max(FMath::CeilToInt(length * SampleRate), 0) + 1;
+	samples.SetNumUninitialized(numFrames * numSockets);
+
+	for (int32 frame = 0; frame < numFrames; ++frame)
+	{
+		const float trackPosition = FMath::Min(frame / SampleRate, length);
+		const FAnimSegment* segment = animTrack.GetSegmentAtTime(trackPosition);
+		UAnimSequence* sequence = segment ? Cast<UAnimSequence>(segment->AnimReference) : nullptr;
+		const float animPosition = segment ? segment->ConvertTrackPosToAnimPos(trackPosition) : 0.f;
+
+		for (int32 socketIndex = 0; socketIndex < numSockets; ++socketIndex)
+		{
+			//walk the chain up to the root, the root itself stays at the ref pose since root motion moves the capsule instead
+			FTransform componentSpace = FTransform::Identity;
+			for (int32 bone = socketBones[socketIndex]; bone != INDEX_NONE; bone = refSkeleton.GetParentIndex(bone))
+			{
+				FTransform local = refPose[bone];
+				const int32 animTrackIndex = (sequence && bone != 0) ? skeleton->GetAnimationTrackIndex(bone, sequence, false) : INDEX_NONE;
+				if (animTrackIndex != INDEX_NONE)
+				{
+					sequence->GetBoneTransform(local, animTrackIndex, animPosition, false);
+				}
+				componentSpace = componentSpace * local;
+			}
+
+			samples[frame * numSockets + socketIndex] = (meshSockets[socketIndex]->GetSocketLocalTransform() * componentSpace).GetLocation();
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,256 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "../Public/LoadTestSubsystem.h"
+#include "../Public/LlamaReplicationGraph.h"
+#include "../Public/LlamaCharacterMovementComponent.h"
+#include "../Public/ItemGridSubsystem.h"
+#include "../LlamaLlamaCharacter.h"
+
+#include "Engine/World.h"
+#include "Engine/GameInstance.h"
+#include "Engine/NetDriver.h"
+#include "Engine/NetConnection.h"
+#include "GameFramework/PlayerController.h"
+#include "CoreGlobals.h"
+#include "HAL/FileManager.h"
+#include "Misc/CommandLine.h"
+#include "UObject/UObjectGlobals.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "HAL/PlatformTime.h"
+#include "HAL/PlatformMemory.h"
+
+bool ULoadTestSubsystem::bRecording = false;
+TMap<FName, int32> ULoadTestSubsystem::rpcCounts;
+int64 ULoadTestSubsystem::itemMovementBits = 0;
+
+void ULoadTestSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	const TCHAR* commandLine = FCommandLine::Get();
+
+	if (FParse::Value(commandLine, TEXT("LlamaLoadTest="), csvPath))
+	{
+		FParse::Value(commandLine, TEXT("LoadTestDuration="), duration);
+
+		if (FPaths::IsRelative(csvPath))
+		{
+			csvPath = FPaths::ProjectSavedDir() / csvPath;
+		}
+
+		const FString header = TEXT("time_s,llamas,frame_ms_p50,frame_ms_p95,frame_ms_p99,frame_ms_max,out_bytes_per_conn_s,in_bytes_per_conn_s,replicate_ms_per_frame,rpcs_per_s,used_mb,peak_used_mb,items_in_flight,item_move_bytes_per_conn_item_s,rpc_breakdown\n");
+		bRecording = FFileHelper::SaveStringToFile(header, *csvPath);
+		UE_CLOG(!bRecording, LogTemp, Error, TEXT("Load test couldn't write %s"), *csvPath);
+	}
+
+	bBot = FParse::Param(commandLine, TEXT("LlamaBot"));
+	botRandom.Initialize(FPlatformTime::Cycles());
+
+	postLoadMapHandle = FCoreUObjectDelegates::PostLoadMapWithWorld.AddUObject(this, &ULoadTestSubsystem::OnPostLoadMap);
+}
+
+void ULoadTestSubsystem::Deinitialize()
+{
+	FCoreUObjectDelegates::PostLoadMapWithWorld.Remove(postLoadMapHandle);
+
+	bRecording = false;
+	rpcCounts.Empty();
+	itemMovementBits = 0;
+
+	Super::Deinitialize();
+}
+
+void ULoadTestSubsystem::Tick(float DeltaTime)
+{
+	UWorld* world = GetTickableGameObjectWorld();
+	if (world == nullptr || !world->HasBegunPlay())
+		return;
+
+	if (bRecording && !world->IsNetMode(NM_Client))
+	{
+		TickRecorder(DeltaTime);
+	}
+
+	if (bBot && world->IsNetMode(NM_Client))
+	{
+		TickBot(DeltaTime);
+	}
+}
+
+void ULoadTestSubsystem::OnPostLoadMap(UWorld* world)
+{
+	//LoadMap has the net driver listening by the time it broadcasts this, whatever game mode the map runs
+	if (world && world->GetGameInstance() == GetGameInstance() && IsRunningDedicatedServer() && world->GetNetDriver())
+	{
+		const FPlatformMemoryStats memory = FPlatformMemory::GetStats();
+		UE_LOG(LogTemp, Log, TEXT("Server ready: accepting connections %.2f s after launch, %.1f MB resident"),
+			FPlatformTime::Seconds() - GStartTime, memory.UsedPhysical / (1024.0 * 1024.0));
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Server recorder
+
+void ULoadTestSubsystem::TickRecorder(float DeltaTime)
+{
+	//game thread work only, the idle wait for the server tick rate isn't in here
+	frameTimes.Add(FPlatformTime::ToMilliseconds(GGameThreadTime));
+
+	UNetDriver* netDriver = GetTickableGameObjectWorld()->GetNetDriver();
+	if (ULlamaReplicationGraph* repGraph = netDriver ? Cast<ULlamaReplicationGraph>(netDriver->GetReplicationDriver()) : nullptr)
+	{
+		replicateSeconds += repGraph->lastReplicateSeconds;
+	}
+
+	if (UItemGridSubsystem* grid = UItemGridSubsystem::Get(GetTickableGameObjectWorld()))
+	{
+		itemSeconds += grid->GetNumItemsInFlight() * DeltaTime;
+	}
+
+	elapsed += DeltaTime;
+	rowElapsed += DeltaTime;
+	if (rowElapsed >= 1.f)
+	{
+		WriteRow();
+	}
+
+	if (elapsed >= duration)
+	{
+		UE_LOG(LogTemp, Log, TEXT("Load test finished, results in %s"), *csvPath);
+		bRecording = false;
+		FPlatformMisc::RequestExit(false);
+	}
+}
+
+void ULoadTestSubsystem::WriteRow()
+{
+	UWorld* world = GetTickableGameObjectWorld();
+
+	frameTimes.Sort();
+	auto percentile = [this](float p)
+	{
+		return frameTimes.Num() > 0 ? frameTimes[FMath::Min(FMath::FloorToInt(p * frameTimes.Num()), frameTimes.Num() - 1)] : 0.f;
+	};
+
+	int32 outBytes = 0;
+	int32 inBytes = 0;
+	int32 connections = 0;
+	if (UNetDriver* netDriver = world->GetNetDriver())
+	{
+		for (UNetConnection* connection : netDriver->ClientConnections)
+		{
+			if (connection)
+			{
+				outBytes += connection->OutBytesPerSecond;
+				inBytes += connection->InBytesPerSecond;
+				++connections;
+			}
+		}
+	}
+
+	int32 llamas = 0;
+	for (FConstPlayerControllerIterator It = world->GetPlayerControllerIterator(); It; ++It)
+	{
+		APlayerController* controller = It->Get();
+		llamas += (controller && Cast<ALlamaLlamaCharacter>(controller->GetPawn())) ? 1 : 0;
+	}
+
+	int32 totalRpcs = 0;
+	FString breakdown;
+	rpcCounts.KeySort([](const FName& a, const FName& b) { return a.LexicalLess(b); });
+	for (const auto& rpc : rpcCounts)
+	{
+		totalRpcs += rpc.Value;
+		breakdown += FString::Printf(TEXT("%s%s:%d"), breakdown.IsEmpty() ? TEXT("") : TEXT(";"), *rpc.Key.ToString(), rpc.Value);
+	}
+
+	const FPlatformMemoryStats memory = FPlatformMemory::GetStats();
+
+	const FString row = FString::Printf(TEXT("%.1f,%d,%.3f,%.3f,%.3f,%.3f,%.0f,%.0f,%.3f,%.0f,%.1f,%.1f,%.1f,%.1f,%s\n"),
+		elapsed, llamas,
+		percentile(0.5f), percentile(0.95f), percentile(0.99f), frameTimes.Num() > 0 ? frameTimes.Last() : 0.f,
+		connections > 0 ? (float)outBytes / connections : 0.f,
+		connections > 0 ? (float)inBytes / connections : 0.f,
+		frameTimes.Num() > 0 ? replicateSeconds * 1000.0 / frameTimes.Num() : 0.0,
+		totalRpcs / rowElapsed,
+		memory.UsedPhysical / (1024.0 * 1024.0), memory.PeakUsedPhysical / (1024.0 * 1024.0),
+		itemSeconds / rowElapsed,
+		itemSeconds > 0.f && connections > 0 ? itemMovementBits / 8.0 / itemSeconds / connections : 0.0,
+		*breakdown);
+
+	FFileHelper::SaveStringToFile(row, *csvPath, FFileHelper::EEncodingOptions::AutoDetect, &IFileManager::Get(), FILEWRITE_Append);
+
+	frameTimes.Reset();
+	replicateSeconds = 0.0;
+	rpcCounts.Reset();
+	itemMovementBits = 0;
+	itemSeconds = 0.f;
+	rowElapsed = 0.f;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Bot
+
+void ULoadTestSubsystem::TickBot(float DeltaTime)
+{
+	APlayerController* controller = GetGameInstance()->GetFirstLocalPlayerController(GetTickableGameObjectWorld());
+	ALlamaLlamaCharacter* llama = controller ? Cast<ALlamaLlamaCharacter>(controller->GetPawn()) : nullptr;
+	if (llama == nullptr)
+		return;
+
+	//wander in a new direction every couple of seconds
+	botMoveTimer -= DeltaTime;
+	if (botMoveTimer <= 0.f)
+	{
+		botMoveTimer = botRandom.FRandRange(1.f, 3.f);
+		botMoveInput = FVector2D(botRandom.GetUnitVector());
+	}
+	llama->AddMovementInput(FVector(botMoveInput, 0.f));
+	controller->AddYawInput(botMoveInput.Y * 30.f * DeltaTime);
+
+	//press something every second or so, picking up while holding an item tosses it and primary without one pushes
+	botActionTimer -= DeltaTime;
+	if (botActionTimer <= 0.f)
+	{
+		botActionTimer = botRandom.FRandRange(0.5f, 1.5f);
+
+		const float roll = botRandom.FRand();
+		if (roll < 0.5f)
+		{
+			llama->PickUp();
+		}
+		else if (roll < 0.8f)
+		{
+			llama->PrimaryAction();
+		}
+		else
+		{
+			llama->SecondaryAction();
+		}
+	}
+
+	//Scripts/LoadTest.sh collects these, run it with and without Llama.PredictMoveState under some PktLag to compare
+	const int32 corrections = llama->GetLlamaMovement()->GetNumCorrections();
+	botMinuteStartCorrections = FMath::Min(botMinuteStartCorrections, corrections);	//respawned, new component
+	botMinuteElapsed += DeltaTime;
+	if (botMinuteElapsed >= 60.f)
+	{
+		UE_LOG(LogTemp, Log, TEXT("Bot corrections: %d in the last minute, Llama.PredictMoveState %d"),
+			corrections - botMinuteStartCorrections, ULlamaCharacterMovementComponent::IsMoveStatePredicted() ? 1 : 0);
+		botMinuteElapsed = 0.f;
+		botMinuteStartCorrections = corrections;
+	}
+}
+
+TStatId ULoadTestSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(ULoadTestSubsystem, STATGROUP_Tickables);
+}
+
+UWorld* ULoadTestSubsystem::GetTickableGameObjectWorld() const
+{
+	UGameInstance* gameInstance = GetGameInstance();
+	return gameInstance ? gameInstance->GetWorld() : nullptr;
+}
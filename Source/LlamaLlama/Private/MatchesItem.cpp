@@ -0,0 +1,53 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "../Public/MatchesItem.h"
+#include "../Public/FireFieldSubsystem.h"
+#include "../LlamaLlamaCharacter.h"
+
+AMatchesItem::AMatchesItem()
+{
+	capacity = 3;
+	igniteDistance = 100.f;
+	igniteRadius = 100.f;
+	strikeMontage = nullptr;
+	matches = 0;
+}
+
+void AMatchesItem::BeginPlay()
+{
+	Super::BeginPlay();
+
+	matches = capacity;
+}
+
+void AMatchesItem::ResetForRound(const FTransform& transform)
+{
+	Super::ResetForRound(transform);
+
+	matches = capacity;
+}
+
+void AMatchesItem::OnAcquiredFromPool()
+{
+	Super::OnAcquiredFromPool();
+
+	matches = capacity;
+}
+
+void AMatchesItem::NativePrimaryAction()
+{
+	//burnt out, the box is just something to throw now
+	if (carrier == nullptr || matches <= 0)
+		return;
+
+	matches--;
+	carrier->PlayReplicatedMontage(strikeMontage);
+	PlayUseEffects();
+
+	UFireFieldSubsystem* fireField = UFireFieldSubsystem::Get(this);
+	if (fireField && fireField->HasField())
+	{
+		fireField->Ignite(carrier->GetActorLocation() + carrier->GetActorForwardVector() * igniteDistance, igniteRadius);
+	}
+}
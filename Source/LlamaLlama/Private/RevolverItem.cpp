@@ -0,0 +1,88 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "../Public/RevolverItem.h"
+#include "../LlamaLlamaCharacter.h"
+
+#include "Engine/World.h"
+#include "GameFramework/DamageType.h"
+#include "Kismet/GameplayStatics.h"
+
+ARevolverItem::ARevolverItem()
+{
+	range = 5000.f;
+	damage = 1.f;
+	damageType = UDamageType::StaticClass();
+	capacity = 6;
+	rounds = 0;
+
+	fireMontage = nullptr;
+	emptyMontage = nullptr;
+	reloadMontage = nullptr;
+	reloadFailMontage = nullptr;
+}
+
+void ARevolverItem::BeginPlay()
+{
+	Super::BeginPlay();
+
+	//the constructor only sees the C++ capacity, not a blueprint subclass's
+	rounds = capacity;
+}
+
+void ARevolverItem::ResetForRound(const FTransform& transform)
+{
+	Super::ResetForRound(transform);
+
+	rounds = capacity;
+}
+
+void ARevolverItem::OnAcquiredFromPool()
+{
+	Super::OnAcquiredFromPool();
+
+	rounds = capacity;
+}
+
+void ARevolverItem::NativePrimaryAction()
+{
+	if (carrier == nullptr)
+		return;
+
+	if (rounds <= 0)
+	{
+		carrier->PlayReplicatedMontage(emptyMontage);
+		return;
+	}
+
+	rounds--;
+	carrier->PlayReplicatedMontage(fireMontage);
+	PlayUseEffects();
+
+	const FVector start = GetActorLocation();
+	const FVector end = start + carrier->GetActorForwardVector() * range;
+
+	FCollisionQueryParams params(SCENE_QUERY_STAT(RevolverShot), false, this);
+	params.AddIgnoredActor(carrier);
+
+	FHitResult hit;
+	if (GetWorld()->LineTraceSingleByChannel(hit, start, end, ECC_Visibility, params) && hit.GetActor())
+	{
+		UGameplayStatics::ApplyDamage(hit.GetActor(), damage, carrier->GetController(), this, damageType);
+	}
+}
+
+void ARevolverItem::NativeSecondaryAction()
+{
+	if (carrier == nullptr)
+		return;
+
+	if (rounds >= capacity)
+	{
+		carrier->PlayReplicatedMontage(reloadFailMontage);
+		return;
+	}
+
+	rounds = capacity;
+	carrier->PlayReplicatedMontage(reloadMontage);
+}
@@ -0,0 +1,395 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "../Public/TimerWheel.h"
+
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/AutomationTest.h"
+
+FTimerWheel::FTimerWheel()
+{
+	Reset(0);
+}
+
+void FTimerWheel::Reset(uint64 tick)
+{
+	entries.Reset();
+	freeHead = INDEX_NONE;
+	numActive = 0;
+	currentTick = tick;
+
+	for (int32& head : slotHeads)
+	{
+		head = INDEX_NONE;
+	}
+	for (int32& levelCount : levelCounts)
+	{
+		levelCount = 0;
+	}
+}
+
+FLlamaTimerHandle FTimerWheel::Add(uint64 expireTick, const FSimpleDelegate& callback)
+{
+	int32 index = freeHead;
+	if (index != INDEX_NONE)
+	{
+		freeHead = entries[index].next;
+	}
+	else
+	{
+		index = entries.AddDefaulted();
+	}
+
+	FEntry& entry = entries[index];
+	entry.expireTick = FMath::Max(expireTick, currentTick + 1);
+	entry.callback = callback;
+	entry.serial = ++nextSerial;
+	Link(index);
+	++numActive;
+
+	FLlamaTimerHandle handle;
+	handle.index = index;
+	handle.serial = entry.serial;
+	return handle;
+}
+
+bool FTimerWheel::Cancel(FLlamaTimerHandle& handle)
+{
+	const bool bActive = IsActive(handle);
+	if (bActive)
+	{
+		Unlink(handle.index);
+		Free(handle.index);
+	}
+
+	handle.Invalidate();
+	return bActive;
+}
+
+bool FTimerWheel::IsActive(const FLlamaTimerHandle& handle) const
+{
+	return Find(handle) != nullptr;
+}
+
+uint64 FTimerWheel::GetExpireTick(const FLlamaTimerHandle& handle) const
+{
+	const FEntry* entry = Find(handle);
+	return entry ? entry->expireTick : 0;
+}
+
+void FTimerWheel::Advance(uint64 tick, TArray<FSimpleDelegate>& outExpired)
+{
+	while (currentTick < tick)
+	{
+		//nothing left to step through, jump straight there
+		if (numActive == 0)
+		{
+			currentTick = tick;
+			break;
+		}
+
+		//no timer can expire or cascade before the end of the turn of the lowest empty levels
+		int32 emptyBits = 0;
+		for (int32 level = 0; level < NumLevels - 1 && levelCounts[level] == 0; ++level)
+		{
+			emptyBits = Level0Bits + level * LevelBits;
+		}
+		if (emptyBits > 0)
+		{
+			const uint64 turnEnd = currentTick | ((uint64(1) << emptyBits) - 1);
+			currentTick = FMath::Min(turnEnd, tick - 1);
+		}
+
+		++currentTick;
+
+		//a level 0 turn is done, bring in the next coarse slot, and the one above that if that level turned over too
+		const int32 index0 = currentTick & (Level0Slots - 1);
+		if (index0 == 0)
+		{
+			for (int32 level = 1; level < NumLevels; ++level)
+			{
+				const int32 shift = Level0Bits + (level - 1) * LevelBits;
+				const int32 index = (currentTick >> shift) & (LevelSlots - 1);
+				Cascade(Level0Slots + (level - 1) * LevelSlots + index);
+				if (index != 0)
+					break;
+			}
+		}
+
+		//everything in a level 0 slot expires on the same tick
+		int32 index = slotHeads[index0];
+		slotHeads[index0] = INDEX_NONE;
+		while (index != INDEX_NONE)
+		{
+			FEntry& entry = entries[index];
+			const int32 next = entry.next;
+			--levelCounts[0];
+			outExpired.Add(MoveTemp(entry.callback));
+			Free(index);
+			index = next;
+		}
+	}
+}
+
+int32 FTimerWheel::GetSlot(uint64 expireTick) const
+{
+	const uint64 delta = expireTick - currentTick;
+	if (delta < Level0Slots)
+		return expireTick & (Level0Slots - 1);
+
+	for (int32 level = 1; level < NumLevels; ++level)
+	{
+		const int32 shift = Level0Bits + (level - 1) * LevelBits;
+		const bool bLastLevel = level == NumLevels - 1;
+		if (delta < (uint64(1) << (shift + LevelBits)) || bLastLevel)
+		{
+			//past the last level's reach, park it as far out as the wheel goes and sort it again when that comes around
+			const uint64 slotTick = bLastLevel ? FMath::Min(expireTick, currentTick + (uint64(1) << (shift + LevelBits)) - 1) : expireTick;
+			return Level0Slots + (level - 1) * LevelSlots + ((slotTick >> shift) & (LevelSlots - 1));
+		}
+	}
+
+	return INDEX_NONE;
+}
+
+void FTimerWheel::Link(int32 index)
+{
+	FEntry& entry = entries[index];
+	entry.slot = GetSlot(entry.expireTick);
+	entry.prev = INDEX_NONE;
+	entry.next = slotHeads[entry.slot];
+	if (entry.next != INDEX_NONE)
+	{
+		entries[entry.next].prev = index;
+	}
+	slotHeads[entry.slot] = index;
+	++levelCounts[GetLevel(entry.slot)];
+}
+
+void FTimerWheel::Unlink(int32 index)
+{
+	FEntry& entry = entries[index];
+	if (entry.prev != INDEX_NONE)
+	{
+		entries[entry.prev].next = entry.next;
+	}
+	else
+	{
+		slotHeads[entry.slot] = entry.next;
+	}
+
+	if (entry.next != INDEX_NONE)
+	{
+		entries[entry.next].prev = entry.prev;
+	}
+	--levelCounts[GetLevel(entry.slot)];
+}
+
+void FTimerWheel::Free(int32 index)
+{
+	FEntry& entry = entries[index];
+	entry.callback.Unbind();
+	entry.slot = INDEX_NONE;
+	entry.prev = INDEX_NONE;
+	entry.next = freeHead;
+	freeHead = index;
+	--numActive;
+}
+
+void FTimerWheel::Cascade(int32 slot)
+{
+	int32 index = slotHeads[slot];
+	slotHeads[slot] = INDEX_NONE;
+	while (index != INDEX_NONE)
+	{
+		const int32 next = entries[index].next;
+		--levelCounts[GetLevel(slot)];
+		Link(index);
+		index = next;
+	}
+}
+
+const FTimerWheel::FEntry* FTimerWheel::Find(const FLlamaTimerHandle& handle) const
+{
+	if (!entries.IsValidIndex(handle.index))
+		return nullptr;
+
+	const FEntry& entry = entries[handle.index];
+	return entry.slot != INDEX_NONE && entry.serial == handle.serial ? &entry : nullptr;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Tests
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLlamaTimerWheelTest, "LlamaLlama.TimerWheel",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+/** Fires whatever Advance returned */
+static void FireExpired(TArray<FSimpleDelegate>& expired)
+{
+	for (FSimpleDelegate& callback : expired)
+	{
+		callback.ExecuteIfBound();
+	}
+	expired.Reset();
+}
+
+/**
+ * Checks the wheel without a world: timers fire on their tick in order across every level, cancelled and stale
+ * handles never fire, handles held across a Reset stay stale, and delays past the wheel's reach still come back on time.
+ */
+bool FLlamaTimerWheelTest::RunTest(const FString& Parameters)
+{
+	{
+		FTimerWheel wheel;
+		wheel.Reset(1000);
+
+		//either side of each level boundary, and past the last level
+		const uint64 delays[] = { 1, 2, 255, 256, 257, 16383, 16384, 16385, 1048575, 1048576, 1048577, (uint64(1) << 26) + 5, uint64(1) << 28 };
+		uint64 previousTick = 1000;
+		uint64 tick = 1000;
+		int32 fires = 0;
+		int32 misses = 0;
+		uint64 lastFired = 0;
+		for (uint64 delay : delays)
+		{
+			const uint64 expireTick = 1000 + delay;
+			wheel.Add(expireTick, FSimpleDelegate::CreateLambda([&, expireTick]()
+			{
+				//has to fire in the advance that crossed its tick, and after everything that expires earlier
+				misses += (expireTick > previousTick && expireTick <= tick && expireTick >= lastFired) ? 0 : 1;
+				lastFired = expireTick;
+				++fires;
+			}));
+		}
+
+		//uneven steps, like frames
+		TArray<FSimpleDelegate> expired;
+		FRandomStream random(3);
+		while (wheel.Num() > 0)
+		{
+			previousTick = tick;
+			tick += random.RandRange(1, 4000);
+			wheel.Advance(tick, expired);
+			FireExpired(expired);
+		}
+
+		TestEqual(TEXT("Timers fired across every level"), fires, (int32)ARRAY_COUNT(delays));
+		TestEqual(TEXT("Timers fired late or out of order"), misses, 0);
+	}
+
+	{
+		FTimerWheel wheel;
+		int32 fires = 0;
+		FLlamaTimerHandle cancelled = wheel.Add(300, FSimpleDelegate::CreateLambda([&fires]() { ++fires; }));
+		FLlamaTimerHandle kept = wheel.Add(300, FSimpleDelegate::CreateLambda([&fires]() { fires += 10; }));
+		FLlamaTimerHandle stale = cancelled;
+
+		TestTrue(TEXT("Cancelling an active timer"), wheel.Cancel(cancelled));
+		TestFalse(TEXT("A cancelled timer is inactive"), wheel.IsActive(stale));
+
+		//reuses the cancelled entry, the stale handle must not reach it
+		FLlamaTimerHandle reused = wheel.Add(400, FSimpleDelegate::CreateLambda([&fires]() { fires += 100; }));
+		TestEqual(TEXT("The new timer reuses the cancelled entry"), reused.index, stale.index);
+		TestFalse(TEXT("A stale handle can't cancel the timer that reused its entry"), wheel.Cancel(stale));
+		TestTrue(TEXT("The timer that reused the entry is still active"), wheel.IsActive(reused));
+
+		TArray<FSimpleDelegate> expired;
+		wheel.Advance(500, expired);
+		FireExpired(expired);
+		TestEqual(TEXT("Only the timers still active fire"), fires, 110);
+		TestFalse(TEXT("A fired timer is inactive"), wheel.IsActive(kept));
+		TestEqual(TEXT("Timers left"), wheel.Num(), 0);
+	}
+
+	{
+		FTimerWheel wheel;
+		int32 fires = 0;
+		FLlamaTimerHandle beforeReset = wheel.Add(100, FSimpleDelegate::CreateLambda([&fires]() { ++fires; }));
+		wheel.Reset(0);
+
+		//a new round starts from an empty entry list, the first timer lands on the same entry
+		FLlamaTimerHandle afterReset = wheel.Add(100, FSimpleDelegate::CreateLambda([&fires]() { fires += 10; }));
+		TestEqual(TEXT("The timer after the reset reuses the entry"), afterReset.index, beforeReset.index);
+		TestFalse(TEXT("A handle from before a reset is stale"), wheel.IsActive(beforeReset));
+		TestFalse(TEXT("A handle from before a reset can't cancel a new timer"), wheel.Cancel(beforeReset));
+
+		TArray<FSimpleDelegate> expired;
+		wheel.Advance(200, expired);
+		FireExpired(expired);
+		TestEqual(TEXT("Only the timer added after the reset fires"), fires, 10);
+	}
+
+	{
+		FTimerWheel wheel;
+		wheel.Reset(50);
+		wheel.Add(10, FSimpleDelegate());
+		TArray<FSimpleDelegate> expired;
+		wheel.Advance(51, expired);
+		TestEqual(TEXT("A timer added in the past fires on the next tick"), expired.Num(), 1);
+	}
+
+	return true;
+}
+
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+// Benchmark
+
+/** Times adding, cancelling and expiring timers at 30 ticks per second with delays up to a minute. Optional arg: timer count (10000) */
+static void BenchTimerWheel(const TArray<FString>& Args)
+{
+	const int32 count = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 10000;
+	const int32 maxDelay = 60 * 30;
+
+	FTimerWheel wheel;
+	FRandomStream random(1);
+	int32 fires = 0;
+	const FSimpleDelegate callback = FSimpleDelegate::CreateLambda([&fires]() { ++fires; });
+
+	TArray<FLlamaTimerHandle> handles;
+	handles.Reserve(count);
+
+	double start = FPlatformTime::Seconds();
+	for (int32 i = 0; i < count; ++i)
+	{
+		handles.Add(wheel.Add(random.RandRange(1, maxDelay), callback));
+	}
+	const double addNs = (FPlatformTime::Seconds() - start) * 1e9 / count;
+
+	//every other one, like stuns cut short by a round reset
+	start = FPlatformTime::Seconds();
+	for (int32 i = 0; i < count; i += 2)
+	{
+		wheel.Cancel(handles[i]);
+	}
+	const double cancelNs = (FPlatformTime::Seconds() - start) * 1e9 / ((count + 1) / 2);
+
+	TArray<FSimpleDelegate> expired;
+	double worstFrameMs = 0.0;
+	start = FPlatformTime::Seconds();
+	for (int32 tick = 1; tick <= maxDelay; ++tick)
+	{
+		const double frameStart = FPlatformTime::Seconds();
+		wheel.Advance(tick, expired);
+		for (FSimpleDelegate& expiredCallback : expired)
+		{
+			expiredCallback.ExecuteIfBound();
+		}
+		expired.Reset();
+		worstFrameMs = FMath::Max(worstFrameMs, (FPlatformTime::Seconds() - frameStart) * 1000.0);
+	}
+	const double advanceMs = (FPlatformTime::Seconds() - start) * 1000.0;
+
+	UE_LOG(LogTemp, Log, TEXT("Llama.BenchTimerWheel %d timers: add %.1f ns, cancel %.1f ns, %d fired over %d ticks in %.2f ms (%.3f us per tick, worst %.3f ms)"),
+		count, addNs, cancelNs, fires, maxDelay, advanceMs, advanceMs * 1000.0 / maxDelay, worstFrameMs);
+}
+
+static FAutoConsoleCommandWithArgs BenchTimerWheelCommand(
+	TEXT("Llama.BenchTimerWheel"),
+	TEXT("Times timer wheel adds, cancels and a minute of expiry at 30 ticks per second. Optional arg: timer count (10000)"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BenchTimerWheel));
@@ -0,0 +1,122 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "../Public/TimerWheelSubsystem.h"
+#include "../LlamaLlama.h"
+
+#include "Engine/GameInstance.h"
+#include "Engine/Engine.h"
+#include "GameFramework/GameStateBase.h"
+
+DECLARE_CYCLE_STAT(TEXT("Timer wheel advance"), STAT_LlamaTimerWheelAdvance, STATGROUP_Llama);
+
+UTimerWheelSubsystem* UTimerWheelSubsystem::Get(const UObject* worldContext)
+{
+	UWorld* world = GEngine ? GEngine->GetWorldFromContextObject(worldContext, EGetWorldErrorMode::ReturnNull) : nullptr;
+	UGameInstance* gameInstance = world ? world->GetGameInstance() : nullptr;
+	return gameInstance ? gameInstance->GetSubsystem<UTimerWheelSubsystem>() : nullptr;
+}
+
+void UTimerWheelSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	postWorldInitHandle = FWorldDelegates::OnPostWorldInitialization.AddUObject(this, &UTimerWheelSubsystem::OnPostWorldInitialization);
+	worldCleanupHandle = FWorldDelegates::OnWorldCleanup.AddUObject(this, &UTimerWheelSubsystem::OnWorldCleanup);
+}
+
+void UTimerWheelSubsystem::Deinitialize()
+{
+	FWorldDelegates::OnPostWorldInitialization.Remove(postWorldInitHandle);
+	FWorldDelegates::OnWorldCleanup.Remove(worldCleanupHandle);
+
+	wheel.Reset(0);
+	wheelWorld.Reset();
+
+	Super::Deinitialize();
+}
+
+void UTimerWheelSubsystem::OnPostWorldInitialization(UWorld* world, const UWorld::InitializationValues initValues)
+{
+	if (world && world->IsGameWorld() && world->GetGameInstance() == GetGameInstance())
+	{
+		wheelWorld = world;
+		wheel.Reset(0);
+	}
+}
+
+void UTimerWheelSubsystem::OnWorldCleanup(UWorld* world, bool bSessionEnded, bool bCleanupResources)
+{
+	//nothing scheduled on the old map should fire on the next one
+	if (world && world == wheelWorld.Get())
+	{
+		wheelWorld.Reset();
+		wheel.Reset(0);
+	}
+}
+
+float UTimerWheelSubsystem::GetServerTime() const
+{
+	const UWorld* world = wheelWorld.Get();
+	if (world == nullptr)
+		return 0.f;
+
+	const AGameStateBase* gameState = world->GetGameState();
+	return gameState ? gameState->GetServerWorldTimeSeconds() : world->GetTimeSeconds();
+}
+
+FLlamaTimerHandle UTimerWheelSubsystem::SetTimerAt(float serverTime, const FSimpleDelegate& callback)
+{
+	//rounded up so a timer never fires before its time
+	const uint64 expireTick = (uint64)FMath::Max(FMath::CeilToInt(serverTime * ticksPerSecond), 0);
+	return wheel.Add(expireTick, callback);
+}
+
+FLlamaTimerHandle UTimerWheelSubsystem::SetTimerForEvent(const FLlamaTimerDynamicDelegate& event, float delay)
+{
+	UObject* object = event.GetUObject();
+	if (object == nullptr)
+		return FLlamaTimerHandle();
+
+	return SetTimer(delay, FSimpleDelegate::CreateUFunction(object, event.GetFunctionName()));
+}
+
+void UTimerWheelSubsystem::ClearTimer(FLlamaTimerHandle& handle)
+{
+	wheel.Cancel(handle);
+}
+
+float UTimerWheelSubsystem::GetTimerRemaining(const FLlamaTimerHandle& handle) const
+{
+	const uint64 expireTick = wheel.GetExpireTick(handle);
+	return expireTick > 0 ? FMath::Max(expireTick / ticksPerSecond - GetServerTime(), 0.f) : -1.f;
+}
+
+void UTimerWheelSubsystem::Tick(float DeltaTime)
+{
+	LLAMA_SCOPE_CYCLE_COUNTER(STAT_LlamaTimerWheelAdvance);
+
+	//the synced clock can step back a little on clients, the wheel just waits for it to catch up
+	const uint64 tick = (uint64)FMath::Max(FMath::FloorToInt(GetServerTime() * ticksPerSecond), 0);
+	wheel.Advance(tick, expired);
+
+	//callbacks can add and cancel timers, they run once the wheel is done moving
+	for (FSimpleDelegate& callback : expired)
+	{
+		callback.ExecuteIfBound();
+	}
+
+	LLAMA_COUNT(ExpiredTimers, expired.Num());
+	LLAMA_SET_COUNT(ActiveTimers, wheel.Num());
+	expired.Reset();
+}
+
+TStatId UTimerWheelSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UTimerWheelSubsystem, STATGROUP_Tickables);
+}
+
+UWorld* UTimerWheelSubsystem::GetTickableGameObjectWorld() const
+{
+	return wheelWorld.Get();
+}
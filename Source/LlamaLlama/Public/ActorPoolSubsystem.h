@@ -0,0 +1,87 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "Engine/World.h"
+#include "ActorPoolSubsystem.generated.h"
+
+/** How many actors of a class to spawn into the pool when a map starts */
+USTRUCT()
+struct FActorPoolPrewarm
+{
+	GENERATED_BODY()
+
+	/** Map name without the PIE prefix, e.g. City */
+	UPROPERTY()
+	FString map;
+
+	UPROPERTY()
+	FSoftClassPath actorClass;
+
+	UPROPERTY()
+	int32 count = 0;
+};
+
+USTRUCT()
+struct FActorPoolList
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<AActor*> actors;
+};
+
+/**
+ * Keeps released actors around hidden instead of destroying them, so bursts of fires, thrown items and effects
+ * don't construct components, create physics bodies and open replication channels mid match.
+ * Pooling only happens on the server, clients just see the actors hide and go dormant.
+ * Each map's prewarm list is read from config and spawned once its actors are initialized, whatever game mode it runs.
+ */
+UCLASS(config = Game)
+class LLAMALLAMA_API UActorPoolSubsystem : public UGameInstanceSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	static UActorPoolSubsystem* Get(const UObject* worldContext);
+
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	/** Spawns count actors of actorClass straight into the pool, tops up to count if some are pooled already */
+	void Prewarm(UWorld* world, TSubclassOf<AActor> actorClass, int32 count);
+
+	/** Takes an actor of actorClass out of the pool or spawns one if the pool is empty */
+	AActor* Acquire(UWorld* world, TSubclassOf<AActor> actorClass, const FTransform& transform);
+
+	template<class T>
+	T* Acquire(UWorld* world, TSubclassOf<T> actorClass, const FTransform& transform)
+	{
+		return Cast<T>(Acquire(world, *actorClass, transform));
+	}
+
+	/** Hides the actor and keeps it for the next Acquire of its class, use this instead of Destroy */
+	void Release(AActor* actor);
+
+	int32 GetNumPooled(TSubclassOf<AActor> actorClass) const;
+
+	/** Where pooled actors are parked, far below any map so clients never see them even before bHidden arrives */
+	static const FVector ParkingLocation;
+
+private:
+	AActor* SpawnForPool(UWorld* world, TSubclassOf<AActor> actorClass, const FTransform& transform);
+
+	void OnWorldInitializedActors(const UWorld::FActorsInitializedParams& params);
+	void OnWorldCleanup(UWorld* world, bool bSessionEnded, bool bCleanupResources);
+
+	UPROPERTY(config)
+	TArray<FActorPoolPrewarm> prewarm;
+
+	UPROPERTY(Transient)
+	TMap<UClass*, FActorPoolList> pools;
+
+	FDelegateHandle worldInitializedActorsHandle;
+	FDelegateHandle worldCleanupHandle;
+};
@@ -0,0 +1,23 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Animation/AnimNotifies/AnimNotifyState.h"
+#include "AnimNotifyState_PushWindow.generated.h"
+
+/**
+ * Marks the frames of the push montage where the hands can land a hit.
+ * Outside of this window the push hitboxes cost nothing.
+ */
+UCLASS(meta = (DisplayName = "Push Window"))
+class LLAMALLAMA_API UAnimNotifyState_PushWindow : public UAnimNotifyState
+{
+	GENERATED_BODY()
+
+public:
+	virtual void NotifyBegin(USkeletalMeshComponent* MeshComp, UAnimSequenceBase* Animation, float TotalDuration) override;
+	virtual void NotifyEnd(USkeletalMeshComponent* MeshComp, UAnimSequenceBase* Animation) override;
+
+	virtual FString GetNotifyName_Implementation() const override;
+};
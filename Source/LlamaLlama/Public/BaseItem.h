@@ -4,14 +4,45 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "Engine/NetSerialization.h"
+#include "PooledActor.h"
+#include "ItemRepMovement.h"
 #include "BaseItem.generated.h"
 
 class UStaticMeshComponent;
 class USphereComponent;
 class ALlamaLlamaCharacter;
+class UItemDefinition;
+
+/** Where and how fast a toss started, in server time, enough for every machine to fly the same arc */
+USTRUCT()
+struct FItemLaunch
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	FVector_NetQuantize10 location;
+
+	UPROPERTY()
+	FVector_NetQuantize10 velocity;
+
+	UPROPERTY()
+	float serverTime = 0.f;
+
+	/** Collision with the thrower is ignored for the flight */
+	UPROPERTY()
+	AActor* thrower = nullptr;
+
+	/** Bumped on every launch so the same item tossed twice from the same spot still replicates */
+	UPROPERTY()
+	uint8 launchCount = 0;
+};
+
+DECLARE_MULTICAST_DELEGATE_ThreeParams(FOnItemCarrierChanged, ABaseItem* /*item*/, ALlamaLlamaCharacter* /*newCarrier*/, ALlamaLlamaCharacter* /*oldCarrier*/);
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnItemNetUpdateFrequencyChanged, ABaseItem* /*item*/);
 
 UCLASS()
-class LLAMALLAMA_API ABaseItem : public AActor
+class LLAMALLAMA_API ABaseItem : public AActor, public IPooledActor
 {
 	GENERATED_BODY()
 	
@@ -25,24 +56,100 @@ public:
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Components)
 	USphereComponent* sphereComp;
 
-	UPROPERTY(Replicated, VisibleAnywhere, BlueprintReadWrite)
+	/** Where the item's mesh, sounds and effects come from, the blueprint only keeps soft references through it */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Item)
+	UItemDefinition* definition;
+
+	/**
+	 * Llama holding the item, set from ALlamaLlamaGameState's inventory on clients.
+	 * Replicates on the item itself only on maps whose game state has no inventory, see UsesInventory.
+	 */
+	UPROPERTY(VisibleAnywhere, BlueprintReadWrite, ReplicatedUsing=OnRep_carrier)
 	ALlamaLlamaCharacter* carrier;
 
-	UFUNCTION(Server, Reliable, WithValidation)
-	void Server_OnPickUp(ACharacter* invoker);
+	/** True when the world's game state is an ALlamaLlamaGameState and carries who holds what */
+	bool UsesInventory() const;
+
+	/** Sets the carrier and keeps the item grid, and on the server the inventory, in sync. Use this instead of writing carrier directly */
+	void SetCarrier(ALlamaLlamaCharacter* newCarrier);
+
+	/** Broadcast on the server whenever any item changes hands */
+	static FOnItemCarrierChanged OnCarrierChanged;
+
+	/** Detaches the item from its carrier and hands it back to physics */
+	void Drop();
+
+	/**
+	 * Drops the item and throws it along a ballistic arc, server only. Movement replication is off for the flight,
+	 * clients fly the same arc from the launch, and the item goes back to physics and replicated movement once
+	 * the server's arc hits something.
+	 */
+	void Launch(const FVector& velocity, AActor* thrower);
+
+	bool IsInFlight() const { return bInFlight; }
 
+	/** Moves the item along its arc, swept in substeps of at most maxFlightSubstep. Called by the item grid for awake items */
+	void TickFlight(float DeltaTime);
+
+	/** Items landing faster than this get CCD until they fall asleep */
+	UPROPERTY(EditDefaultsOnly, Category = Item)
+	float ccdSpeed;
+
+	UPROPERTY(EditDefaultsOnly, Category = Item)
+	float maxFlightSubstep;
+
+	/** Broadcast on the server when an item's NetUpdateFrequency follows its speed to another step */
+	static FOnItemNetUpdateFrequencyChanged OnNetUpdateFrequencyChanged;
+
+	/** Whether free items replicate through FItemRepMovement instead of the actor's FRepMovement, Llama.CompactItemMovement */
+	static bool IsMovementCompact();
+
+	/** Scales NetUpdateFrequency with the item's speed, server only. Called by the item grid for awake items */
+	void UpdateNetUpdateFrequency();
+
+	/** Net update rate of an item that barely moves, it goes up to maxNetUpdateFrequency at fastMovementSpeed */
+	UPROPERTY(EditDefaultsOnly, Category = Replication)
+	float minNetUpdateFrequency;
+
+	UPROPERTY(EditDefaultsOnly, Category = Replication)
+	float maxNetUpdateFrequency;
+
+	UPROPERTY(EditDefaultsOnly, Category = Replication)
+	float fastMovementSpeed;
+
+	/** Velocity changes up to these many units and degrees per second aren't replicated, the client's physics carries on with the old one */
+	UPROPERTY(EditDefaultsOnly, Category = Replication)
+	float linearVelocityThreshold;
+
+	UPROPERTY(EditDefaultsOnly, Category = Replication)
+	float angularVelocityThreshold;
+
+	/** Drops the item if carried and puts it back at transform at rest, server only */
+	virtual void ResetForRound(const FTransform& transform);
+
+	/** Freezes and hides the item while the streaming cell under it is unloaded on this client, see UCellStreamingSubsystem */
+	void SetStreamedIn(bool bStreamedIn);
+
+	/** Attaches the item to the invoker's hand, see ALlamaLlamaCharacter::CarryItem */
 	UFUNCTION()
 	void OnPickUp(ACharacter* invoker);
 
-	UFUNCTION(Server, reliable, WithValidation)
-	void Server_OnPrimaryAction();
+	// IPooledActor interface
+	virtual void OnAcquiredFromPool() override;
+	virtual void OnReturnedToPool() override;
+	// End of IPooledActor interface
+
+	/**
+	 * Uses the item, server only, llamas send their presses along with their moves. Native items run
+	 * NativePrimaryAction directly, the blueprint VM only gets involved when the class overrides OnPrimaryAction.
+	 */
+	void PrimaryAction();
+	void SecondaryAction();
 
+	/** Blueprint side of PrimaryAction, the native implementation runs NativePrimaryAction so overrides can call the parent */
 	UFUNCTION(BlueprintNativeEvent)
 	void OnPrimaryAction();
 
-	UFUNCTION(Server, reliable, WithValidation)
-	void Server_OnSecondaryAction();
-
 	UFUNCTION(BlueprintNativeEvent)
 	void OnSecondaryAction();
 
@@ -50,8 +157,87 @@ protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
-public:	
-	// Called every frame
-	virtual void Tick(float DeltaTime) override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	/**
+	 * Packs the movement the engine just gathered into itemMovement and replicates that instead. Carried items replicate
+	 * neither movement nor attachment, the inventory attaches them on every machine
+	 */
+	virtual void PreReplication(IRepChangedPropertyTracker& ChangedPropertyTracker) override;
+
+	/** Adds the item to the grid and the item stats, undone by UnregisterFromWorld */
+	void RegisterWithWorld();
+	void UnregisterFromWorld();
+
+	bool bRegisteredWithWorld = false;
+
+	bool bStreamedOut = false;
+
+	UFUNCTION()
+	void OnMeshWake(UPrimitiveComponent* WakingComponent, FName BoneName);
+
+	UFUNCTION()
+	void OnMeshSleep(UPrimitiveComponent* SleepingComponent, FName BoneName);
+
+	/** Applies the definition's mesh once its bundles are loaded, runs on the server too since the mesh is the item's body */
+	void ApplyDefinition();
+
+	FDelegateHandle itemDefinitionsLoadedHandle;
+
+	/** Puts the item to net dormancy while it rests or is carried and wakes it back up, server only */
+	void SetDormant(bool bDormant);
+
+	/** What the item does when used, overridden by the native items */
+	virtual void NativePrimaryAction() {}
+	virtual void NativeSecondaryAction() {}
+
+	/** Whether the class overrides OnPrimaryAction/OnSecondaryAction in blueprint, looked up once on BeginPlay */
+	bool bScriptPrimaryAction = false;
+	bool bScriptSecondaryAction = false;
+
+	/** Plays the definition's use sound and effect on the clients that have the item, server only */
+	void PlayUseEffects();
+
+	UFUNCTION(NetMulticast, Unreliable)
+	void Multicast_PlayUseEffects();
+
+	/** Fallback for game states without the inventory, carries or lets go of the item like the inventory would */
+	UFUNCTION()
+	void OnRep_carrier(ALlamaLlamaCharacter* oldCarrier);
+
+	UPROPERTY(ReplicatedUsing=OnRep_launch)
+	FItemLaunch launch;
+
+	UFUNCTION()
+	void OnRep_launch();
+
+	/** Quantized and delta compressed movement while the item is free and not in flight, see FItemRepMovement */
+	UPROPERTY(ReplicatedUsing=OnRep_itemMovement)
+	FItemRepMovement itemMovement;
+
+	/** Hands the decoded movement to the engine, which blends the body towards it like any replicated physics actor */
+	UFUNCTION()
+	void OnRep_itemMovement();
+
+	/** Puts the stock ReplicatedMovement in the load test's item movement bytes when it changes, so both paths share a column */
+	void CountStockMovementBits();
+
+	/** ReplicatedMovement as last counted, not replicated */
+	FRepMovement countedMovement;
+
+	/** The server turning movement replication back on is the end of the flight for clients */
+	virtual void OnRep_ReplicateMovement() override;
+
+	void StartFlight(float elapsed);
+
+	/** Hands the item back to physics at velocity, and on the server back to replicated movement */
+	void EndFlight(const FVector& velocity);
+
+	/** Stops a flight without handing it to physics, for pick ups, pooling and round resets */
+	void CancelFlight();
+
+	FVector GetFlightLocation(float time) const;
 
+	bool bInFlight = false;
+	float flightTime = 0.f;
 };
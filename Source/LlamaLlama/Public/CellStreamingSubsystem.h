@@ -0,0 +1,99 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "Tickable.h"
+#include "Engine/World.h"
+#include "CellStreamingSubsystem.generated.h"
+
+class ULevelStreaming;
+
+/** A streaming sublevel laid out on the cell grid */
+struct FStreamingCell
+{
+	TWeakObjectPtr<ULevelStreaming> level;
+	FIntPoint coord = FIntPoint::ZeroValue;
+	FBox2D bounds = FBox2D(ForceInit);
+	bool bWanted = false;
+
+	/** When the current load was requested, 0 once it finished */
+	double loadRequestTime = 0.0;
+};
+
+/**
+ * Streams the map's cells, the sublevels named <Map>_Cell_<x>_<y>, in and out around the local llama.
+ * Dedicated and listen servers keep every cell loaded so item physics and llama movement have collision everywhere,
+ * the server cook already strips the cells' visual only holders (see UInstancePropsCommandlet).
+ * Items stay in the persistent level and keep replicating normally, a client freezes the ones sitting in a cell it has
+ * unloaded so they don't fall through the missing floor, and lets them go once the cell is back.
+ */
+UCLASS(config = Game)
+class LLAMALLAMA_API UCellStreamingSubsystem : public UGameInstanceSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	static UCellStreamingSubsystem* Get(const UObject* worldContext);
+
+	/** Cell edge length in world units, has to match how the map was split */
+	UPROPERTY(Config)
+	float cellSize = 10000.f;
+
+	/** World XY of cell 0_0's min corner */
+	UPROPERTY(Config)
+	FVector2D cellOrigin = FVector2D::ZeroVector;
+
+	/** Cells closer than this to the llama are loaded */
+	UPROPERTY(Config)
+	float loadRadius = 15000.f;
+
+	/** Loaded cells are only dropped past this, so walking along a border doesn't thrash */
+	UPROPERTY(Config)
+	float unloadRadius = 20000.f;
+
+	/** Seconds between streaming and item checks */
+	UPROPERTY(Config)
+	float updateInterval = 0.25f;
+
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	/** False for a location in a cell this machine has unloaded, true anywhere outside the cell grid */
+	bool IsLocationStreamedIn(const FVector& location) const;
+
+	/** Loaded cells, per cell load times and resident memory, for comparing against a full map load */
+	void LogStreamingStats() const;
+
+	// FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override { return cells.Num() > 0; }
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override;
+	// End of FTickableGameObject interface
+
+private:
+	void OnPostWorldInitialization(UWorld* world, const UWorld::InitializationValues initValues);
+	void OnWorldCleanup(UWorld* world, bool bSessionEnded, bool bCleanupResources);
+
+	/** Picks up the world's cell sublevels, everything else in the world streams as it did before */
+	void GatherCells(UWorld* world);
+
+	void UpdateWantedCells();
+	void UpdateItems();
+
+	TWeakObjectPtr<UWorld> cellWorld;
+	TArray<FStreamingCell> cells;
+	TMap<FIntPoint, int32> cellIndices;
+
+	bool bLoadEverything = false;
+	bool bFirstUpdate = true;
+	float updateElapsed = 0.f;
+
+	/** Seconds each cell took from request to loaded, the most recent load per cell */
+	TMap<FIntPoint, float> cellLoadSeconds;
+
+	FDelegateHandle postWorldInitHandle;
+	FDelegateHandle worldCleanupHandle;
+};
@@ -0,0 +1,123 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "HAL/ThreadSafeBool.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "Containers/CircularQueue.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "EventJournal.generated.h"
+
+class IFileHandle;
+class FRunnableThread;
+class UWorld;
+
+enum class ELlamaJournalEvent : uint8
+{
+	PickUp,
+	Toss,
+	Push,
+	PushHit,
+	Stun,
+	ItemPrimaryAction,
+	ItemSecondaryAction,
+};
+
+struct FLlamaJournalRecord
+{
+	ELlamaJournalEvent type;
+	float serverTime;
+	uint32 actorId;
+	uint32 otherId;
+	FVector location;
+
+	/** Bytes a record takes in the file after its one byte length prefix */
+	static const int32 SerializedSize = 1 + 4 + 4 + 4 + 12;
+
+	void Serialize(uint8* out) const;
+	static bool Deserialize(const uint8* in, int32 size, FLlamaJournalRecord& outRecord);
+
+	static const TCHAR* GetTypeName(ELlamaJournalEvent type);
+};
+
+/**
+ * Server event journal. The game thread pushes fixed size records into a lock-free single producer single consumer
+ * ring, a background thread drains it into a binary file of length prefixed records and flushes it every second.
+ * Records that don't fit while the ring is full are dropped and counted rather than stalling the game thread.
+ * Every game instance owns its own journal through UEventJournalSubsystem, so PIE instances don't share one.
+ */
+class LLAMALLAMA_API FLlamaEventJournal : public FRunnable
+{
+public:
+	static const uint32 FileMagic = 0x314A4C4C; // "LLJ1"
+
+	/** Starts a journal writing to path on its own thread, nullptr if the thread couldn't start, game thread only */
+	static FLlamaEventJournal* StartRecording(const FString& path);
+
+	/** Lets the thread drain what's left and deletes the journal */
+	static void StopRecording(FLlamaEventJournal* journal);
+
+	/** Records an event into the journal of world's game instance, only a counter check when nothing is recording, server only */
+	static void Record(const UWorld* world, ELlamaJournalEvent type, const AActor* actor, const AActor* other, const FVector& location)
+	{
+		if (numRecording > 0)
+		{
+			RecordInWorld(world, type, actor, other, location);
+		}
+	}
+
+	/** Reads a journal file back, used by the JournalToCsv commandlet */
+	static bool ReadFile(const FString& path, TArray<FLlamaJournalRecord>& outRecords);
+
+	/** The file is opened by the writer thread, a journal that never gets a thread can still be pushed to and drained */
+	FLlamaEventJournal(const FString& inPath, uint32 capacity);
+	virtual ~FLlamaEventJournal();
+
+	void Push(ELlamaJournalEvent type, float serverTime, const AActor* actor, const AActor* other, const FVector& location);
+
+	/** Drains whatever is queued into buffer, consumer side */
+	int32 Drain(TArray<uint8>& buffer);
+
+	// FRunnable interface
+	virtual bool Init() override;
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+	// End of FRunnable interface
+
+	int32 GetDroppedCount() const { return droppedCount.GetValue(); }
+
+private:
+	static void RecordInWorld(const UWorld* world, ELlamaJournalEvent type, const AActor* actor, const AActor* other, const FVector& location);
+
+	/** Journals running in any game instance */
+	static int32 numRecording;
+
+	FString path;
+	TCircularQueue<FLlamaJournalRecord> queue;
+	IFileHandle* file = nullptr;
+	FRunnableThread* thread = nullptr;
+	FThreadSafeBool bStopping;
+	FThreadSafeCounter droppedCount;
+};
+
+/**
+ * Runs the journal on servers started with -LlamaJournal[=<file>], relative paths go under Saved.
+ * PIE instances each write their own file with the instance number appended.
+ */
+UCLASS()
+class LLAMALLAMA_API UEventJournalSubsystem : public UGameInstanceSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	/** The game instance's journal, nullptr when it isn't recording */
+	FLlamaEventJournal* GetJournal() const { return journal; }
+
+private:
+	FLlamaEventJournal* journal = nullptr;
+};
@@ -0,0 +1,44 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BaseItem.h"
+#include "ExtinguisherItem.generated.h"
+
+class UAnimMontage;
+
+/** Sprays in front of the carrier, putting out and dampening the fire field cells along the spray */
+UCLASS()
+class LLAMALLAMA_API AExtinguisherItem : public ABaseItem
+{
+	GENERATED_BODY()
+
+public:
+	AExtinguisherItem();
+
+	/** How far in front of the carrier the spray reaches */
+	UPROPERTY(EditDefaultsOnly, Category = Extinguisher)
+	float sprayLength;
+
+	/** Radius of each extinguish along the spray, they are spaced one radius apart */
+	UPROPERTY(EditDefaultsOnly, Category = Extinguisher)
+	float sprayRadius;
+
+	/** Heat taken out of every cell in the spray, see UFireFieldSubsystem::Extinguish */
+	UPROPERTY(EditDefaultsOnly, Category = Extinguisher)
+	float extinguishAmount;
+
+	/** Seconds between sprays */
+	UPROPERTY(EditDefaultsOnly, Category = Extinguisher)
+	float sprayCooldown;
+
+	/** Carrier montage, it has to be in the llama's montage table */
+	UPROPERTY(EditDefaultsOnly, Category = Animation)
+	UAnimMontage* sprayMontage;
+
+protected:
+	virtual void NativePrimaryAction() override;
+
+	float nextSprayTime = 0.f;
+};
@@ -0,0 +1,109 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/** Tunables of the fire cellular automaton, rates are per second */
+struct FFireFieldParams
+{
+	/** Fraction of the difference to the neighbor average a cell takes per second */
+	float diffusion = 2.f;
+
+	/** Fraction of its heat a cell loses per second */
+	float cooling = 0.3f;
+
+	/** Heat a burning cell adds to itself per second */
+	float burnHeat = 4.f;
+
+	/** Fuel a burning cell consumes per second */
+	float burnRate = 0.1f;
+
+	/** A cell with fuel catches fire at this heat */
+	float ignitionHeat = 0.2f;
+
+	float maxHeat = 1.f;
+	float maxFuel = 1.f;
+};
+
+/**
+ * Fixed resolution 2D grid of fuel, heat and burning state, stored as separate arrays with a one cell ghost border
+ * so the kernel can read the four neighbors of any cell without bounds checks.
+ * Width is rounded up to a multiple of 4 so every row steps in whole vector registers, the padding columns are masked
+ * out and stay cold like the ghost border.
+ * The net state of every cell is kept up to date as rows are stepped, along with the rectangle of cells whose net state
+ * changed, so sending updates doesn't have to scan the grid.
+ */
+class LLAMALLAMA_API FFireField
+{
+public:
+	/** Cell state as it goes over the network, burning in the top bit and fuel in the low 7 */
+	static const uint8 BurningBit = 0x80;
+
+	void Init(int32 inWidth, int32 inHeight);
+
+	void Reset();
+
+	int32 GetWidth() const { return width; }
+	int32 GetHeight() const { return height; }
+	bool IsValidCell(int32 x, int32 y) const { return x >= 0 && y >= 0 && x < width && y < height; }
+
+	float GetFuel(int32 x, int32 y) const { return fuel[Index(x, y)]; }
+	float GetHeat(int32 x, int32 y) const { return heat[Index(x, y)]; }
+	bool IsBurning(int32 x, int32 y) const { return burning[Index(x, y)] > 0.f; }
+
+	void AddFuel(int32 x, int32 y, float amount);
+	void AddHeat(int32 x, int32 y, float amount);
+
+	/** Cools the cell and puts it out */
+	void Extinguish(int32 x, int32 y, float amount);
+
+	/** Advances every cell by deltaTime, rows run on the task graph when bParallel */
+	void Step(float deltaTime, bool bParallel = true);
+
+	/** Plain one cell at a time version of Step, kept as the reference the vector kernel is checked against */
+	void StepScalar(float deltaTime);
+
+	int32 CountBurning() const;
+
+	uint8 GetNetState(int32 x, int32 y) const { return netStates[y * width + x]; }
+
+	/** Bounding rectangle, max inclusive, of the cells whose net state changed since the last ClearNetDirty, false when none did */
+	bool GetNetDirtyRect(FIntRect& outRect) const;
+	void ClearNetDirty();
+
+	FFireFieldParams params;
+
+private:
+	int32 Index(int32 x, int32 y) const { return (y + 1) * pitch + x + 1; }
+
+	void StepRow(int32 y, const float* heatIn, float* heatOut, float diffuseDt, float coolDt, float burnHeatDt, float burnRateDt);
+
+	uint8 ComputeNetState(int32 x, int32 y) const;
+
+	/** Refreshes the net states of the row and widens its dirty span, rows are independent so this is safe from ParallelFor */
+	void UpdateNetStates(int32 y, int32 minX, int32 maxX);
+
+	int32 width = 0;
+	int32 height = 0;
+
+	/** Row stride including the ghost columns */
+	int32 pitch = 0;
+
+	TArray<float> fuel;
+	TArray<float> heat;
+	TArray<float> burning;
+
+	/** Heat is double buffered since every cell reads its neighbors */
+	TArray<float> heatScratch;
+
+	/** 1 for real columns and 0 for the padding up to the next multiple of 4 */
+	TArray<float> columnMask;
+
+	/** width * height, what GetNetState returns */
+	TArray<uint8> netStates;
+
+	/** Per row first and last column whose net state changed, first > last when the row is clean */
+	TArray<int32> dirtyMinX;
+	TArray<int32> dirtyMaxX;
+};
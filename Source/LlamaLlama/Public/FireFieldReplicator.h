@@ -0,0 +1,84 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Info.h"
+#include "FireFieldReplicator.generated.h"
+
+/** A rectangle of fire field cell states, run length encoded as (run - 1, state) byte pairs */
+USTRUCT()
+struct FFireFieldCells
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	uint16 x = 0;
+
+	UPROPERTY()
+	uint16 y = 0;
+
+	UPROPERTY()
+	uint16 width = 0;
+
+	UPROPERTY()
+	uint16 height = 0;
+
+	UPROPERTY()
+	TArray<uint8> runs;
+
+	void Encode(const TArray<uint8>& states);
+	bool Decode(TArray<uint8>& outStates) const;
+};
+
+/**
+ * Placed once per map to lay the fire field over it and to carry the field to clients.
+ * Every update the server sends the bounding rectangle of the cells that changed since the last one, plus a rolling band
+ * of rows as a keyframe so lost updates and late joiners catch up. Both go unreliable, each message holds absolute
+ * states so a lost one only leaves its cells stale until the next change or keyframe.
+ */
+UCLASS(placeable)
+class LLAMALLAMA_API AFireFieldReplicator : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	AFireFieldReplicator();
+
+	/** World XY area the field covers */
+	UPROPERTY(EditAnywhere, Category = Fire)
+	FBox2D fieldBounds;
+
+	UPROPERTY(EditAnywhere, Category = Fire, meta = (ClampMin = "10"))
+	float cellSize;
+
+	/** Seconds between updates sent to clients */
+	UPROPERTY(EditAnywhere, Category = Fire)
+	float sendInterval;
+
+	/** Rows per keyframe band, the whole field is refreshed every height / keyframeRows updates */
+	UPROPERTY(EditAnywhere, Category = Fire)
+	int32 keyframeRows;
+
+	/** Larger rectangles are split into several messages */
+	UPROPERTY(EditAnywhere, Category = Fire)
+	int32 maxCellsPerMessage;
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void Tick(float DeltaSeconds) override;
+
+	UFUNCTION(NetMulticast, Unreliable)
+	void Multicast_ApplyCells(const FFireFieldCells& cells);
+
+private:
+	void SendRect(int32 x, int32 y, int32 width, int32 height);
+
+	/** Cell states as of the last update, server only */
+	TArray<uint8> sentStates;
+
+	int32 fieldWidth;
+	int32 nextKeyframeRow;
+	float sendAccumulator;
+};
@@ -0,0 +1,117 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "Tickable.h"
+#include "FireField.h"
+#include "TimerWheel.h"
+#include "FireFieldSubsystem.generated.h"
+
+/**
+ * Fire and gasoline spread over the current map, set up by the map's AFireFieldReplicator.
+ * The server steps the FFireField at a fixed rate, clients only keep the quantized cell states the replicator sends them.
+ */
+UCLASS(config = Game)
+class LLAMALLAMA_API UFireFieldSubsystem : public UGameInstanceSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	static UFireFieldSubsystem* Get(const UObject* worldContext);
+
+	/** Simulation steps per second, the server runs at most 4 steps per frame to catch up */
+	UPROPERTY(Config)
+	float stepRate = 10.f;
+
+	UPROPERTY(Config)
+	float diffusion = 2.f;
+
+	UPROPERTY(Config)
+	float cooling = 0.3f;
+
+	UPROPERTY(Config)
+	float burnHeat = 4.f;
+
+	UPROPERTY(Config)
+	float burnRate = 0.1f;
+
+	UPROPERTY(Config)
+	float ignitionHeat = 0.2f;
+
+	/** Seconds an extinguished cell stays damp, it can't be lit or catch fire from its neighbors until then */
+	UPROPERTY(Config)
+	float reigniteCooldown = 3.f;
+
+	virtual void Deinitialize() override;
+
+	/** Lays the grid over bounds, called by the replicator on the server and on clients */
+	void InitializeField(UWorld* world, const FBox2D& bounds, float cellSize);
+	void ReleaseField();
+
+	/** Puts out and clears every cell for a new round, the replicator sends the cleared cells as a normal update */
+	void ResetField();
+
+	bool HasField() const { return fieldWorld.IsValid(); }
+
+	/** Spreads fuel over the cells within radius, server only */
+	UFUNCTION(BlueprintCallable, Category = Fire)
+	void PourFuel(const FVector& location, float radius, float amount);
+
+	/** Heats the cells within radius to the max so any fuel there catches fire, damp cells stay out, server only */
+	UFUNCTION(BlueprintCallable, Category = Fire)
+	void Ignite(const FVector& location, float radius);
+
+	/** Cools and puts out the cells within radius and keeps them damp for reigniteCooldown, server only */
+	UFUNCTION(BlueprintCallable, Category = Fire)
+	void Extinguish(const FVector& location, float radius, float amount);
+
+	UFUNCTION(BlueprintPure, Category = Fire)
+	bool IsBurningAt(const FVector& location) const;
+
+	const FFireField& GetField() const { return field; }
+
+	/** Cell state packed like FFireField::GetNetState, from the simulation on the server and from the last update on clients */
+	uint8 GetCellState(int32 x, int32 y) const;
+
+	/** Rectangle, max inclusive, of the cells whose state changed since the last ClearNetDirty, server only */
+	bool GetNetDirtyRect(FIntRect& outRect) const { return bSimulating && field.GetNetDirtyRect(outRect); }
+	void ClearNetDirty() { field.ClearNetDirty(); }
+
+	/** Writes a block of replicated cell states, clients only */
+	void ApplyCellStates(int32 x, int32 y, int32 width, int32 height, const TArray<uint8>& states);
+
+	// FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override { return bSimulating; }
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override;
+	// End of FTickableGameObject interface
+
+private:
+	bool WorldToCell(const FVector& location, int32& outX, int32& outY) const;
+
+	/** Calls visit for every cell whose center is within radius of location */
+	void ForEachCellInRadius(const FVector& location, float radius, TFunctionRef<void(int32, int32)> visit);
+
+	bool CanWrite() const { return bSimulating; }
+
+	void DryCell(int32 cellIndex);
+	void ClearDampCells();
+
+	FFireField field;
+
+	TWeakObjectPtr<UWorld> fieldWorld;
+	FBox2D fieldBounds;
+	float fieldCellSize = 100.f;
+
+	bool bSimulating = false;
+	float stepAccumulator = 0.f;
+
+	/** What the clients know, width * height cells */
+	TArray<uint8> clientStates;
+
+	/** Extinguished cells by y * width + x, with the timer that dries them out */
+	TMap<int32, FLlamaTimerHandle> dampCells;
+};
@@ -0,0 +1,59 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BaseItem.h"
+#include "GasCanItem.generated.h"
+
+class UAnimMontage;
+
+/** Pours fuel into the fire field in front of the carrier, a few pours per fill */
+UCLASS()
+class LLAMALLAMA_API AGasCanItem : public ABaseItem
+{
+	GENERATED_BODY()
+
+public:
+	AGasCanItem();
+
+	/** Pours a full can has */
+	UPROPERTY(EditDefaultsOnly, Category = GasCan)
+	int32 capacity;
+
+	/** How far in front of the carrier the fuel lands */
+	UPROPERTY(EditDefaultsOnly, Category = GasCan)
+	float pourDistance;
+
+	UPROPERTY(EditDefaultsOnly, Category = GasCan)
+	float pourRadius;
+
+	/** Fuel added to every cell within pourRadius, see UFireFieldSubsystem::PourFuel */
+	UPROPERTY(EditDefaultsOnly, Category = GasCan)
+	float pourAmount;
+
+	/** Carrier montages, they have to be in the llama's montage table */
+	UPROPERTY(EditDefaultsOnly, Category = Animation)
+	UAnimMontage* pourMontage;
+
+	UPROPERTY(EditDefaultsOnly, Category = Animation)
+	UAnimMontage* emptyMontage;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = GasCan)
+	int32 pours;
+
+	/** Fills the can back up, for refill points. Server only */
+	UFUNCTION(BlueprintCallable, Category = GasCan)
+	void Refill();
+
+	virtual void ResetForRound(const FTransform& transform) override;
+
+	// IPooledActor interface
+	virtual void OnAcquiredFromPool() override;
+	// End of IPooledActor interface
+
+protected:
+	virtual void BeginPlay() override;
+
+	virtual void NativePrimaryAction() override;
+};
@@ -0,0 +1,27 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "InstancePropsCommandlet.generated.h"
+
+/**
+ * Merges a map's static mesh actors into AInstancedPropsActors grouped by mesh, materials and collision profile,
+ * and moves props without collision, decals and emitters into a holder the dedicated server doesn't load.
+ * Actors that are tagged, attached or referenced by another actor or the level blueprint are left alone.
+ * Logs actor, component and collision body counts and the estimated memory of the full and the server load,
+ * before and after. Without -save nothing is written.
+ * Merged props lose their baked lightmaps, the map needs a lighting rebuild after a saved run.
+ * usage: UE4Editor-Cmd LlamaLlama.uproject -run=InstanceProps -map=/Game/LlamaLlama/Maps/City [-MinInstances=2] [-save]
+ */
+UCLASS()
+class UInstancePropsCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UInstancePropsCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,43 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "InstancedPropsActor.generated.h"
+
+class UHierarchicalInstancedStaticMeshComponent;
+class UMaterialInterface;
+class UStaticMesh;
+
+/**
+ * Holds a map's static props as hierarchical instanced meshes, one component per mesh, materials and collision profile.
+ * Built by the InstanceProps commandlet. The visual only holder carries the props without collision plus the decals
+ * and emitters moved off their own actors, and is left out of the dedicated server cook entirely.
+ */
+UCLASS(NotBlueprintable)
+class LLAMALLAMA_API AInstancedPropsActor : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	AInstancedPropsActor();
+
+	/** Nothing in here affects gameplay, the server doesn't load it */
+	UPROPERTY(VisibleAnywhere, Category = Props)
+	bool bVisualOnly;
+
+	virtual bool NeedsLoadForServer() const override;
+
+	/** Adds an instance at worldTransform to the component matching mesh, materials and collisionProfile, creating it if needed */
+	void AddInstance(UStaticMesh* mesh, const TArray<UMaterialInterface*>& materials, FName collisionProfile, const FTransform& worldTransform);
+
+	/** Moves a copy of a visual only component, a decal or an emitter, onto this actor at the same world transform */
+	void AdoptComponent(USceneComponent* source);
+
+	const TArray<UHierarchicalInstancedStaticMeshComponent*>& GetInstanceComponents() const { return instanceComponents; }
+
+private:
+	UPROPERTY()
+	TArray<UHierarchicalInstancedStaticMeshComponent*> instanceComponents;
+};
@@ -0,0 +1,87 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "Engine/World.h"
+#include "ItemAssetSubsystem.generated.h"
+
+class UItemDefinition;
+struct FStreamableHandle;
+
+/** Definitions a map needs besides the ones of the items placed in it, e.g. what a spawner hands out */
+USTRUCT()
+struct FMapItemDefinitions
+{
+	GENERATED_BODY()
+
+	/** Map name without the PIE prefix, e.g. City */
+	UPROPERTY()
+	FString map;
+
+	UPROPERTY()
+	TArray<FPrimaryAssetId> definitions;
+};
+
+/**
+ * Async loads the current map's item definitions through the AssetManager when it starts and releases them when it ends,
+ * so a match only keeps its own item assets resident. Dedicated servers load the Gameplay bundle only.
+ */
+UCLASS(config = Game)
+class LLAMALLAMA_API UItemAssetSubsystem : public UGameInstanceSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	static UItemAssetSubsystem* Get(const UObject* worldContext);
+
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	/** Requests the definitions of the items placed in the map plus its mapItemDefinitions entry */
+	void LoadItemDefinitions(UWorld* world);
+
+	/** Adds one definition to the loaded set, for items that were not in the map when it started, safe to call again */
+	void LoadItemDefinition(const UItemDefinition* definition);
+
+	/** Drops our handles so the AssetManager can unload them */
+	void ReleaseItemDefinitions();
+
+	bool AreItemDefinitionsLoaded() const { return pendingLoads == 0 && requestedIds.Num() > 0; }
+
+	/** True once the definition's bundles are in memory */
+	bool IsItemDefinitionLoaded(const UItemDefinition* definition) const;
+
+	/** Loaded definitions, empty until AreItemDefinitionsLoaded */
+	const TArray<UItemDefinition*>& GetItemDefinitions() const { return definitions; }
+
+	/** Broadcast once the requested bundles are in memory */
+	FSimpleMulticastDelegate OnItemDefinitionsLoaded;
+
+	/** Time the last load took and resident memory right after it, for comparing startup cost */
+	void LogLoadStats() const;
+
+private:
+	void OnPostWorldInitialization(UWorld* world, const UWorld::InitializationValues initValues);
+	void OnWorldCleanup(UWorld* world, bool bSessionEnded, bool bCleanupResources);
+	void RequestItemDefinitions(const TArray<FPrimaryAssetId>& ids);
+	void OnLoadCompleted();
+
+	UPROPERTY(config)
+	TArray<FMapItemDefinitions> mapItemDefinitions;
+
+	TArray<TSharedPtr<FStreamableHandle>> loadHandles;
+	TSet<FPrimaryAssetId> requestedIds;
+	int32 pendingLoads = 0;
+
+	UPROPERTY(Transient)
+	TArray<UItemDefinition*> definitions;
+
+	double loadStartTime = 0.0;
+	double loadSeconds = 0.0;
+	uint64 usedPhysicalAfterLoad = 0;
+
+	FDelegateHandle postWorldInitHandle;
+	FDelegateHandle worldCleanupHandle;
+};
@@ -0,0 +1,46 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "ItemDefinition.generated.h"
+
+class ABaseItem;
+class UStaticMesh;
+class USoundBase;
+class UParticleSystem;
+
+/**
+ * Data asset describing one kind of item, scanned by the AssetManager under /Game/Items.
+ * Everything is a soft reference split in two bundles: Gameplay is what the server needs to run the item,
+ * including the mesh since it is the item's collision and physics body, Cosmetic is sounds and effects
+ * and never loads on a dedicated server.
+ */
+UCLASS(BlueprintType)
+class LLAMALLAMA_API UItemDefinition : public UPrimaryDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	static const FPrimaryAssetType ItemDefinitionType;
+	static const FName GameplayBundle;
+	static const FName CosmeticBundle;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Item)
+	FText displayName;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Item, meta = (AssetBundles = "Gameplay"))
+	TSoftClassPtr<ABaseItem> itemClass;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Item, meta = (AssetBundles = "Gameplay"))
+	TSoftObjectPtr<UStaticMesh> mesh;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Cosmetic, meta = (AssetBundles = "Cosmetic"))
+	TSoftObjectPtr<USoundBase> useSound;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Cosmetic, meta = (AssetBundles = "Cosmetic"))
+	TSoftObjectPtr<UParticleSystem> useEffect;
+
+	virtual FPrimaryAssetId GetPrimaryAssetId() const override;
+};
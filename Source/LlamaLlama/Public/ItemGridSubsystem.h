@@ -0,0 +1,77 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "Tickable.h"
+#include "ItemGridSubsystem.generated.h"
+
+class ABaseItem;
+
+/**
+ * Uniform-grid spatial hash of every ABaseItem in the current world.
+ * Items are only re-bucketed while their physics body is awake, so resting items cost next to nothing per frame.
+ * Carried items stay registered but are taken out of the grid since they can't be picked up.
+ */
+UCLASS(config = Game)
+class LLAMALLAMA_API UItemGridSubsystem : public UGameInstanceSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	static UItemGridSubsystem* Get(const UObject* worldContext);
+
+	/** Edge length of a grid cell, keep it at least as big as the largest pick up radius so a query visits at most 3x3 cells */
+	UPROPERTY(Config)
+	float cellSize = 200.f;
+
+	/** Every free item stays inside this box, replicated item locations are steps of it, see FItemRepMovement */
+	UPROPERTY(Config)
+	FBox movementBounds = FBox(FVector(-150000.f, -150000.f, -20000.f), FVector(150000.f, 150000.f, 45536.f));
+
+	virtual void Deinitialize() override;
+
+	void RegisterItem(ABaseItem* item);
+	void UnregisterItem(ABaseItem* item);
+
+	/** Re-buckets the item if it moved to another cell, takes it out of the grid while it has a carrier */
+	void UpdateItem(ABaseItem* item);
+
+	/** Awake items are re-bucketed every frame until their body goes back to sleep, tossed items also fly their arc from here */
+	void SetItemAwake(ABaseItem* item, bool bAwake);
+
+	/** Returns the closest item without a carrier within radius of origin, nullptr if there is none */
+	ABaseItem* FindNearestFreeItem(const FVector& origin, float radius) const;
+
+	int32 GetNumItems() const { return registeredItems.Num(); }
+
+	/** Awake items without a carrier as of the last tick, flying or rolling */
+	int32 GetNumItemsInFlight() const { return numItemsInFlight; }
+
+	// FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override { return awakeItems.Num() > 0 || bCountsDirty; }
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override;
+	// End of FTickableGameObject interface
+
+private:
+	FIntPoint GetCell(const FVector& location) const;
+
+	void RemoveFromGrid(ABaseItem* item);
+
+	TSet<ABaseItem*> registeredItems;
+
+	TMap<FIntPoint, TArray<ABaseItem*>> cells;
+
+	/** Cell of every item currently in the grid */
+	TMap<ABaseItem*, FIntPoint> itemCells;
+
+	TArray<ABaseItem*> awakeItems;
+
+	int32 numItemsInFlight = 0;
+
+	/** Held or awake items changed, tick once more to update the counters even if nothing is awake */
+	bool bCountsDirty = false;
+};
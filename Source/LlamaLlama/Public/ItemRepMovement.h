@@ -0,0 +1,95 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/NetSerialization.h"
+#include "ItemRepMovement.generated.h"
+
+struct FRepMovement;
+
+/** Physics state of an item in the integer steps FItemRepMovement sends */
+struct LLAMALLAMA_API FItemMovementState
+{
+	/** Bits per axis of the location, steps of the movement bounds */
+	static const int32 LocationBits[3];
+
+	/** Bits per component of the velocities, in units and degrees per second */
+	static const int32 VelocityBits = 14;
+
+	FIntVector location = FIntVector::ZeroValue;
+
+	/** Smallest three quaternion, index of the dropped component in the top 2 bits and 10 bits for each other one */
+	uint32 rotation = 0;
+
+	FIntVector linearVelocity = FIntVector::ZeroValue;
+	FIntVector angularVelocity = FIntVector::ZeroValue;
+
+	bool bSimulatingPhysics = false;
+	bool bSleeping = false;
+
+	/** Quantizes what AActor::GatherCurrentMovement collected, locations outside bounds are clamped to its faces */
+	void FromMovement(const FRepMovement& movement, const FBox& bounds);
+
+	void ToMovement(FRepMovement& movement, const FBox& bounds) const;
+
+	static uint32 PackRotation(const FQuat& quat);
+	static FQuat UnpackRotation(uint32 packed);
+
+	bool operator==(const FItemMovementState& other) const
+	{
+		return location == other.location && rotation == other.rotation && linearVelocity == other.linearVelocity
+			&& angularVelocity == other.angularVelocity && bSimulatingPhysics == other.bSimulatingPhysics && bSleeping == other.bSleeping;
+	}
+
+	bool operator!=(const FItemMovementState& other) const { return !(*this == other); }
+};
+
+/**
+ * Replicated movement of a physics item, replaces the actor's FRepMovement.
+ * Every update is a delta against a state the connection was sent before: only the fields that changed go out, the
+ * location as a short offset when it moved little, and velocities only once they are off by more than a threshold.
+ * When a packet is lost the engine rolls the connection's base back to the one that packet was built on, clients keep
+ * the last few states they got around to decode against and skip the odd update whose base never arrived.
+ */
+USTRUCT()
+struct LLAMALLAMA_API FItemRepMovement
+{
+	GENERATED_BODY()
+
+	/** Latest state, gathered by the server before it replicates and decoded into on clients */
+	FItemMovementState state;
+
+	/** Velocity changes up to these aren't sent, server only */
+	int32 linearVelocityThreshold = 0;
+	int32 angularVelocityThreshold = 0;
+
+	bool NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms);
+
+private:
+	bool Write(FNetDeltaSerializeInfo& DeltaParms);
+	void Read(FBitReader& reader);
+
+	void RememberReceived(uint8 sequence, const FItemMovementState& receivedState);
+
+	struct FReceivedState
+	{
+		uint8 sequence = 0;
+		FItemMovementState state;
+	};
+
+	static const int32 NumReceivedStates = 8;
+
+	/** Newest first, the bases the server may send a delta against */
+	FReceivedState receivedStates[NumReceivedStates];
+	int32 numReceivedStates = 0;
+};
+
+template<>
+struct TStructOpsTypeTraits<FItemRepMovement> : public TStructOpsTypeTraitsBase2<FItemRepMovement>
+{
+	enum
+	{
+		WithNetDeltaSerializer = true,
+	};
+};
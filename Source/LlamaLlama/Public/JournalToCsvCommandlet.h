@@ -0,0 +1,22 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "JournalToCsvCommandlet.generated.h"
+
+/**
+ * Converts an event journal to csv.
+ * usage: UE4Editor-Cmd LlamaLlama.uproject -run=JournalToCsv -in=<journal> [-out=<csv>]
+ */
+UCLASS()
+class UJournalToCsvCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UJournalToCsvCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
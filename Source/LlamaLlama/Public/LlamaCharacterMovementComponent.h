@@ -0,0 +1,115 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "LlamaCharacterMovementComponent.generated.h"
+
+/** Action buttons that travel with the saved moves instead of their own RPCs */
+namespace ELlamaMoveAction
+{
+	enum Type : uint8
+	{
+		PickUp			= 1 << 0,
+		PrimaryAction	= 1 << 1,
+		SecondaryAction	= 1 << 2,
+	};
+}
+
+/** Llama state that changes how fast it can move, kept per saved move so replays run with the state each move had */
+namespace ELlamaMoveState
+{
+	enum Type : uint8
+	{
+		Carrying	= 1 << 0,
+		Stunned		= 1 << 1,
+		Pushing		= 1 << 2,
+	};
+}
+
+/**
+ * Character movement that packs the llama's action presses into the compressed flags of the saved moves.
+ * That way actions are timestamped with the move they happened on, resent with the important moves if a packet
+ * gets lost, dropped by the server's timestamp check if they arrive twice, and never touch the reliable buffer.
+ * Carrying, stunned and pushing are movement state rather than a MaxWalkSpeed written from OnRep. Both ends change it
+ * while handling the same action move, so the speed changes on the same timestamp and pickups don't cause corrections.
+ */
+UCLASS()
+class LLAMALLAMA_API ULlamaCharacterMovementComponent : public UCharacterMovementComponent
+{
+	GENERATED_BODY()
+
+	friend class FSavedMove_Llama;
+
+public:
+	/** Queues an action press on the owning client, it is sent with the next saved move */
+	void QueueAction(ELlamaMoveAction::Type action);
+
+	/** Top walking speed while carrying an item */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Llama")
+	float carrySpeed = 500.f;
+
+	/** Top walking speed while stunned */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Llama")
+	float stunnedSpeed = 0.f;
+
+	/** Scales the top speed during a push */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Llama")
+	float pushSpeedScale = 1.f;
+
+	/** ELlamaMoveState bits, set by the llama on the server and predicted on the owning client */
+	void SetMoveState(uint8 newState) { moveState = newState; }
+	uint8 GetMoveState() const { return moveState; }
+
+	/** False with Llama.PredictMoveState 0, the llama then only changes MaxWalkSpeed when replication arrives */
+	static bool IsMoveStatePredicted();
+
+	/** Corrections the server sent this client since it connected */
+	int32 GetNumCorrections() const { return numCorrections; }
+
+	virtual float GetMaxSpeed() const override;
+	virtual float GetMaxAcceleration() const override;
+	virtual bool CanAttemptJump() const override;
+	virtual void UpdateFromCompressedFlags(uint8 Flags) override;
+	virtual bool ClientUpdatePositionAfterServerUpdate() override;
+	virtual void SendClientAdjustment() override;
+	virtual void ClientAdjustPosition_Implementation(float TimeStamp, FVector NewLoc, FVector NewVel, UPrimitiveComponent* NewBase, FName NewBaseBoneName, bool bHasBase, bool bBaseRelativePosition, uint8 ServerMovementMode) override;
+	virtual class FNetworkPredictionData_Client* GetPredictionData_Client() const override;
+
+private:
+	/** Presses that happened since the last saved move was built */
+	uint8 pendingActions = 0;
+
+	uint8 moveState = 0;
+	int32 numCorrections = 0;
+};
+
+class LLAMALLAMA_API FSavedMove_Llama : public FSavedMove_Character
+{
+public:
+	typedef FSavedMove_Character Super;
+
+	virtual void Clear() override;
+	virtual uint8 GetCompressedFlags() const override;
+	virtual bool CanCombineWith(const FSavedMovePtr& NewMove, ACharacter* InCharacter, float MaxDelta) const override;
+	virtual bool IsImportantMove(const FSavedMovePtr& LastAckedMove) const override;
+	virtual void SetMoveFor(ACharacter* C, float InDeltaTime, FVector const& NewAccel, class FNetworkPredictionData_Client_Character& ClientData) override;
+	virtual void PrepMoveFor(ACharacter* C) override;
+
+	/** ELlamaMoveAction bits pressed on this move */
+	uint8 savedActions = 0;
+
+	/** ELlamaMoveState the move was simulated with, never sent, the server derives it from the same action moves */
+	uint8 savedMoveState = 0;
+};
+
+class LLAMALLAMA_API FNetworkPredictionData_Client_Llama : public FNetworkPredictionData_Client_Character
+{
+public:
+	typedef FNetworkPredictionData_Client_Character Super;
+
+	FNetworkPredictionData_Client_Llama(const UCharacterMovementComponent& ClientMovement);
+
+	virtual FSavedMovePtr AllocateNewMove() override;
+};
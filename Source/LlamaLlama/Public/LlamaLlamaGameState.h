@@ -0,0 +1,88 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/GameState.h"
+#include "Engine/NetSerialization.h"
+#include "LlamaLlamaGameState.generated.h"
+
+class ABaseItem;
+class ALlamaLlamaCharacter;
+struct FLlamaInventory;
+
+/** An item in a llama's hand, applied on clients as the entry is added, changed and removed */
+USTRUCT()
+struct FLlamaInventoryEntry : public FFastArraySerializerItem
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	ALlamaLlamaCharacter* llama = nullptr;
+
+	UPROPERTY()
+	ABaseItem* item = nullptr;
+
+	/** Hand the item is in, llamas only have the one for now */
+	UPROPERTY()
+	uint8 slot = 0;
+
+	void PreReplicatedRemove(const FLlamaInventory& inventory);
+	void PostReplicatedAdd(const FLlamaInventory& inventory);
+	void PostReplicatedChange(const FLlamaInventory& inventory);
+
+private:
+	/** Has llama carry item once both have replicated, letting go of whatever the entry applied before */
+	void Apply();
+	void Release();
+
+	/** What the entry applied on this client, its references can resolve or go away after it arrived */
+	TWeakObjectPtr<ALlamaLlamaCharacter> appliedLlama;
+	TWeakObjectPtr<ABaseItem> appliedItem;
+};
+
+/** Every carried item in the game, replicated as a delta per added, changed or removed entry */
+USTRUCT()
+struct FLlamaInventory : public FFastArraySerializer
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<FLlamaInventoryEntry> entries;
+
+	bool NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms)
+	{
+		return FFastArraySerializer::FastArrayDeltaSerialize<FLlamaInventoryEntry, FLlamaInventory>(entries, DeltaParms, *this);
+	}
+};
+
+template<>
+struct TStructOpsTypeTraits<FLlamaInventory> : public TStructOpsTypeTraitsBase2<FLlamaInventory>
+{
+	enum
+	{
+		WithNetDeltaSerializer = true,
+	};
+};
+
+/**
+ * Game state holding the one authoritative record of who carries what.
+ * Items and llamas don't replicate their side of it, clients attach, detach, ignore and slow down from the inventory.
+ * A map running another game state falls back to replicating ABaseItem::carrier.
+ */
+UCLASS()
+class LLAMALLAMA_API ALlamaLlamaGameState : public AGameState
+{
+	GENERATED_BODY()
+
+public:
+	/** Puts item in carrier's hand, or takes it out of the inventory with nullptr, server only. ABaseItem::SetCarrier calls this */
+	void SetItemCarrier(ABaseItem* item, ALlamaLlamaCharacter* carrier);
+
+	/** Takes every entry of llama out of the inventory as it leaves play, so clients don't apply a carrier that is gone. Server only */
+	void RemoveLlama(ALlamaLlamaCharacter* llama);
+
+protected:
+	UPROPERTY(Replicated)
+	FLlamaInventory inventory;
+};
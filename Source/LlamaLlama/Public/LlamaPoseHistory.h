@@ -0,0 +1,57 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/** Where a llama's capsule and push hands were at a given server time */
+struct FLlamaPoseSnapshot
+{
+	float serverTime = 0.f;
+	FVector capsuleLocation = FVector::ZeroVector;
+	FVector leftHand = FVector::ZeroVector;
+	FVector rightHand = FVector::ZeroVector;
+
+	static FLlamaPoseSnapshot Lerp(const FLlamaPoseSnapshot& a, const FLlamaPoseSnapshot& b, float alpha);
+};
+
+/**
+ * Fixed size ring buffer of pose snapshots recorded on the server, used to rewind llamas to what an attacker saw.
+ */
+class LLAMALLAMA_API FLlamaPoseHistory
+{
+public:
+	static const int32 Capacity = 64;
+
+	void Record(const FLlamaPoseSnapshot& snapshot);
+
+	void Reset() { num = 0; head = 0; }
+
+	int32 Num() const { return num; }
+
+	/** Interpolated pose at time, clamped to the oldest and newest snapshot. Returns false if nothing was recorded yet */
+	bool Sample(float time, FLlamaPoseSnapshot& outSnapshot) const;
+
+	/**
+	 * Whether hands sweeping from previousPose to currentPose touch this llama's capsule as it was at rewindTime.
+	 * outRewoundLocation is where the capsule was then. False without a hit or if nothing was recorded yet
+	 */
+	bool TestPushHit(const FLlamaPoseSnapshot& previousPose, const FLlamaPoseSnapshot& currentPose, float handRadius, float rewindTime,
+		float capsuleRadius, float capsuleHalfHeight, FVector& outRewoundLocation) const;
+
+	/** How far back a push is checked for an attacker with pingSeconds of round trip, never further than maxRewind */
+	static float GetPushRewind(float pingSeconds, float maxRewind) { return FMath::Clamp(pingSeconds, 0.f, maxRewind); }
+
+	/** True if a hand sphere touches a vertical capsule centered at capsuleLocation */
+	static bool TestHandHit(const FVector& hand, float handRadius, const FVector& capsuleLocation, float capsuleRadius, float capsuleHalfHeight);
+
+	/** Same as TestHandHit but for a hand that moved from handStart to handEnd during the frame, so fast swings can't skip through */
+	static bool TestHandSweep(const FVector& handStart, const FVector& handEnd, float handRadius, const FVector& capsuleLocation, float capsuleRadius, float capsuleHalfHeight);
+
+private:
+	const FLlamaPoseSnapshot& Get(int32 indexFromOldest) const;
+
+	FLlamaPoseSnapshot snapshots[Capacity];
+	int32 head = 0;
+	int32 num = 0;
+};
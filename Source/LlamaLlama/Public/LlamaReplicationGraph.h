@@ -0,0 +1,86 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ReplicationGraph.h"
+#include "LlamaReplicationGraph.generated.h"
+
+class ABaseItem;
+class ALlamaLlamaCharacter;
+
+enum class ELlamaRepNodeMapping : uint8
+{
+	NotRouted,					// Not routed to a node, another node or the dependent actor list takes care of it
+	RelevantAllConnections,		// Routed to the always relevant node
+	Spatialize_Static,			// Grid node, actor never moves
+	Spatialize_Dynamic,			// Grid node, actor position is updated every frame
+	Spatialize_Dormancy,		// Grid node, treated as static while dormant and dynamic while awake
+};
+
+/**
+ * Replication graph for llamas and items.
+ * Llamas and free items live in a 2D spatial grid so a connection only considers what is near its view target,
+ * info actors like the game state go to an always relevant node, and carried items are not routed at all,
+ * they replicate as dependents of their carrier.
+ */
+UCLASS(transient, config = Engine)
+class LLAMALLAMA_API ULlamaReplicationGraph : public UReplicationGraph
+{
+	GENERATED_BODY()
+
+public:
+	virtual void InitForNetDriver(UNetDriver* InNetDriver) override;
+	virtual void BeginDestroy() override;
+	virtual void InitGlobalActorClassSettings() override;
+	virtual void InitGlobalGraphNodes() override;
+	virtual void InitConnectionGraphNodes(UNetReplicationGraphConnection* RepGraphConnection) override;
+	virtual void RouteAddNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& GlobalInfo) override;
+	virtual void RouteRemoveNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo) override;
+	virtual int32 ServerReplicateActors(float DeltaSeconds) override;
+
+	/** Wall time the last ServerReplicateActors took, read by the load test recorder */
+	double lastReplicateSeconds = 0.0;
+
+	UPROPERTY(Config)
+	float gridCellSize = 10000.f;
+
+	/** Offset applied to the grid so the map's most negative corner maps to cell 0 */
+	UPROPERTY(Config)
+	FVector2D gridSpatialBias = FVector2D(-150000.f, -150000.f);
+
+	UPROPERTY()
+	UReplicationGraphNode_GridSpatialization2D* gridNode;
+
+	UPROPERTY()
+	UReplicationGraphNode_ActorList* alwaysRelevantNode;
+
+private:
+	ELlamaRepNodeMapping GetMappingPolicy(UClass* Class);
+
+	/** Adds or removes an actor on the node its class's policy routes it to */
+	void AddToPolicyNode(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& GlobalInfo);
+	void RemoveFromPolicyNode(const FNewReplicatedActorInfo& ActorInfo);
+
+	void InitClassReplicationInfo(FClassReplicationInfo& Info, UClass* Class, bool bSpatialize) const;
+
+	/** Frames between replications of an actor that wants to update netUpdateFrequency times a second */
+	uint32 GetReplicationPeriodFrame(float netUpdateFrequency) const;
+
+	/** Whether item replicates through this graph, the item delegates are static and fire for every world and net driver */
+	bool IsGraphItem(const ABaseItem* item) const;
+
+	/** Moves an item between the grid and its carrier's dependent list */
+	void OnItemCarrierChanged(ABaseItem* item, ALlamaLlamaCharacter* newCarrier, ALlamaLlamaCharacter* oldCarrier);
+
+	/** Items replicate faster while they move fast, see ABaseItem::UpdateNetUpdateFrequency */
+	void OnItemNetUpdateFrequencyChanged(ABaseItem* item);
+
+	void AddDependentItem(ABaseItem* item, ALlamaLlamaCharacter* carrier);
+	void RemoveDependentItem(ABaseItem* item, ALlamaLlamaCharacter* carrier);
+
+	TClassMap<ELlamaRepNodeMapping> classRepNodePolicies;
+
+	FDelegateHandle carrierChangedHandle;
+	FDelegateHandle netUpdateFrequencyChangedHandle;
+};
@@ -0,0 +1,37 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UAnimMontage;
+class USkeletalMesh;
+
+/**
+ * Mesh component space socket positions sampled over a montage, baked straight from its animation tracks and the
+ * skeleton's bone chains. Lets a dedicated server know where the push hands and the carry socket are while it only
+ * ticks montage timing and never evaluates the anim graph. Root motion and anything the graph layers on top
+ * (blends, IK, additives) are left out, the montages the server cares about play on their own.
+ */
+class LLAMALLAMA_API FLlamaSocketTrack
+{
+public:
+	static const float SampleRate;
+
+	/** Baked track for montage on mesh, baked on first use and shared by every llama, null if a socket is missing */
+	static TSharedPtr<const FLlamaSocketTrack> FindOrBake(UAnimMontage* montage, USkeletalMesh* mesh, const TArray<FName>& sockets);
+
+	int32 GetNumSockets() const { return numSockets; }
+	int32 GetNumFrames() const { return numFrames; }
+
+	/** Component space location of socketIndex at montage position, interpolated between frames */
+	FVector Sample(int32 socketIndex, float position) const;
+
+private:
+	bool Bake(UAnimMontage* montage, USkeletalMesh* mesh, const TArray<FName>& sockets);
+
+	/** numFrames * numSockets locations, frame major */
+	TArray<FVector> samples;
+	int32 numSockets = 0;
+	int32 numFrames = 0;
+};
@@ -0,0 +1,103 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "Tickable.h"
+#include "LoadTestSubsystem.generated.h"
+
+class ALlamaLlamaCharacter;
+
+/**
+ * Counts a sent or received RPC by type for the CSV profiler, Llama.DumpFrame and the load test recorder.
+ * Expands to LLAMA_COUNT, so the file using it also includes LlamaLlama.h.
+ */
+#define LLAMA_COUNT_RPC(Name) \
+	do \
+	{ \
+		LLAMA_COUNT(Name, 1); \
+		ULoadTestSubsystem::CountRpc(TEXT(#Name)); \
+	} while (0)
+
+/**
+ * Load test harness, does nothing unless started with one of these on the command line:
+ *   -LlamaLoadTest=<csv>	server, writes one row per second of frame time percentiles, bytes per connection, RPCs,
+ *							replication time, item movement bytes and resident memory to <csv>, and exits after
+ *							-LoadTestDuration seconds (default 120)
+ *   -LlamaBot				client, drives its llama around with scripted moves and action presses, and logs how many
+ *							movement corrections the server sent it every minute
+ * Both run fine with -nullrhi, see Scripts/LoadTest.sh.
+ * Dedicated servers also log "Server ready" with the startup time and resident memory once a map is loaded and listening.
+ */
+UCLASS()
+class LLAMALLAMA_API ULoadTestSubsystem : public UGameInstanceSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	/** Counts an RPC or action press by name while the server is recording, only a bool check when it isn't */
+	static void CountRpc(const TCHAR* rpc)
+	{
+		if (bRecording)
+		{
+			rpcCounts.FindOrAdd(FName(rpc))++;
+		}
+	}
+
+	static bool IsRecording() { return bRecording; }
+
+	/** Counts the bits of item movement, compact or stock, written to any connection while the server is recording */
+	static void CountItemMovementBits(int32 bits)
+	{
+		if (bRecording)
+		{
+			itemMovementBits += bits;
+		}
+	}
+
+	// FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override { return bRecording || bBot; }
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override;
+	// End of FTickableGameObject interface
+
+private:
+	void TickRecorder(float DeltaTime);
+	void WriteRow();
+
+	void TickBot(float DeltaTime);
+
+	void OnPostLoadMap(UWorld* world);
+	FDelegateHandle postLoadMapHandle;
+
+	static bool bRecording;
+	static TMap<FName, int32> rpcCounts;
+	static int64 itemMovementBits;
+
+	bool bBot = false;
+
+	FString csvPath;
+	float duration = 120.f;
+	float elapsed = 0.f;
+	float rowElapsed = 0.f;
+
+	/** Game thread milliseconds of every frame in the current row */
+	TArray<float> frameTimes;
+	double replicateSeconds = 0.0;
+
+	/** Free awake items times the seconds they were in the air or rolling, over the current row */
+	float itemSeconds = 0.f;
+
+	float botMoveTimer = 0.f;
+	float botActionTimer = 0.f;
+	FVector2D botMoveInput = FVector2D::ZeroVector;
+	FRandomStream botRandom;
+
+	float botMinuteElapsed = 0.f;
+	int32 botMinuteStartCorrections = 0;
+};
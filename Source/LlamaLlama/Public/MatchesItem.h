@@ -0,0 +1,49 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BaseItem.h"
+#include "MatchesItem.generated.h"
+
+class UAnimMontage;
+
+/** Lights the fire field in front of the carrier, fuel there catches fire */
+UCLASS()
+class LLAMALLAMA_API AMatchesItem : public ABaseItem
+{
+	GENERATED_BODY()
+
+public:
+	AMatchesItem();
+
+	/** Matches in a full box */
+	UPROPERTY(EditDefaultsOnly, Category = Matches)
+	int32 capacity;
+
+	/** How far in front of the carrier the match is dropped */
+	UPROPERTY(EditDefaultsOnly, Category = Matches)
+	float igniteDistance;
+
+	/** See UFireFieldSubsystem::Ignite */
+	UPROPERTY(EditDefaultsOnly, Category = Matches)
+	float igniteRadius;
+
+	/** Carrier montage, it has to be in the llama's montage table */
+	UPROPERTY(EditDefaultsOnly, Category = Animation)
+	UAnimMontage* strikeMontage;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Matches)
+	int32 matches;
+
+	virtual void ResetForRound(const FTransform& transform) override;
+
+	// IPooledActor interface
+	virtual void OnAcquiredFromPool() override;
+	// End of IPooledActor interface
+
+protected:
+	virtual void BeginPlay() override;
+
+	virtual void NativePrimaryAction() override;
+};
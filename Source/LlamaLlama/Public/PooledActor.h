@@ -0,0 +1,30 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Interface.h"
+#include "PooledActor.generated.h"
+
+UINTERFACE(MinimalAPI, meta = (CannotImplementInterfaceInBlueprint))
+class UPooledActor : public UInterface
+{
+	GENERATED_BODY()
+};
+
+/**
+ * Reset hooks for actors that live in the UActorPoolSubsystem.
+ * The pool already hides the actor, turns off its collision and tick and puts it to net dormancy,
+ * implement this for whatever else has to be undone, like a carrier or physics state.
+ */
+class LLAMALLAMA_API IPooledActor
+{
+	GENERATED_BODY()
+
+public:
+	/** Called after the actor was moved to its new transform and shown again, server only */
+	virtual void OnAcquiredFromPool() {}
+
+	/** Called before the actor is hidden and parked, server only */
+	virtual void OnReturnedToPool() {}
+};
@@ -0,0 +1,63 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BaseItem.h"
+#include "RevolverItem.generated.h"
+
+class UAnimMontage;
+class UDamageType;
+
+/** Shoots along the carrier's facing and damages whatever the trace hits, reloads with the secondary action */
+UCLASS()
+class LLAMALLAMA_API ARevolverItem : public ABaseItem
+{
+	GENERATED_BODY()
+
+public:
+	ARevolverItem();
+
+	UPROPERTY(EditDefaultsOnly, Category = Revolver)
+	float range;
+
+	/** Handed to ApplyDamage, the llama blueprint decides what a hit does */
+	UPROPERTY(EditDefaultsOnly, Category = Revolver)
+	float damage;
+
+	UPROPERTY(EditDefaultsOnly, Category = Revolver)
+	TSubclassOf<UDamageType> damageType;
+
+	/** Rounds a reload puts in the cylinder */
+	UPROPERTY(EditDefaultsOnly, Category = Revolver)
+	int32 capacity;
+
+	/** Carrier montages, they have to be in the llama's montage table */
+	UPROPERTY(EditDefaultsOnly, Category = Animation)
+	UAnimMontage* fireMontage;
+
+	UPROPERTY(EditDefaultsOnly, Category = Animation)
+	UAnimMontage* emptyMontage;
+
+	UPROPERTY(EditDefaultsOnly, Category = Animation)
+	UAnimMontage* reloadMontage;
+
+	/** Played when reloading a full cylinder */
+	UPROPERTY(EditDefaultsOnly, Category = Animation)
+	UAnimMontage* reloadFailMontage;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Revolver)
+	int32 rounds;
+
+	virtual void ResetForRound(const FTransform& transform) override;
+
+	// IPooledActor interface
+	virtual void OnAcquiredFromPool() override;
+	// End of IPooledActor interface
+
+protected:
+	virtual void BeginPlay() override;
+
+	virtual void NativePrimaryAction() override;
+	virtual void NativeSecondaryAction() override;
+};
@@ -0,0 +1,18 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "../LlamaLlamaGameMode.h"
+#include "TeamSuicideMatchGameMode.generated.h"
+
+/**
+ * Game mode of City and Farm. The maps still point at the old TeamSuicideMatch blueprint, a class redirect in
+ * DefaultEngine.ini sends them here so they run the round reset and inventory code of ALlamaLlamaGameMode.
+ * Only the pawn differs, set in DefaultGame.ini.
+ */
+UCLASS(config = Game)
+class LLAMALLAMA_API ATeamSuicideMatchGameMode : public ALlamaLlamaGameMode
+{
+	GENERATED_BODY()
+};
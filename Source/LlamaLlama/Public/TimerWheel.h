@@ -0,0 +1,104 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TimerWheel.generated.h"
+
+/** Refers to a timer in a FTimerWheel, goes stale once the timer fired or was cancelled */
+USTRUCT(BlueprintType)
+struct LLAMALLAMA_API FLlamaTimerHandle
+{
+	GENERATED_BODY()
+
+	int32 index = INDEX_NONE;
+	uint32 serial = 0;
+
+	void Invalidate() { index = INDEX_NONE; }
+};
+
+/**
+ * Hierarchical timing wheel over integer ticks. Adding and cancelling a timer is O(1) whatever the delay, advancing
+ * costs one slot per tick plus a cascade of one coarser slot every 256 ticks, so thousands of timers cost next to
+ * nothing until they fire, and stretches where the finer levels are empty are skipped instead of stepped.
+ * The finest level has 256 one tick slots, each coarser one 64 slots of the whole level below, four levels reach
+ * 2^26 ticks and anything further is parked in the last slot until it comes in range.
+ */
+class LLAMALLAMA_API FTimerWheel
+{
+public:
+	FTimerWheel();
+
+	/** Drops every timer and starts counting from tick, handles from before stay stale */
+	void Reset(uint64 tick);
+
+	/** Timer firing on the first Advance that reaches expireTick, ticks already passed fire on the next tick */
+	FLlamaTimerHandle Add(uint64 expireTick, const FSimpleDelegate& callback);
+
+	/** Cancels the timer and invalidates the handle, false if it already fired or was cancelled */
+	bool Cancel(FLlamaTimerHandle& handle);
+
+	bool IsActive(const FLlamaTimerHandle& handle) const;
+
+	/** Tick the timer fires on, 0 if it isn't active */
+	uint64 GetExpireTick(const FLlamaTimerHandle& handle) const;
+
+	/** Steps up to tick and appends the callbacks of every timer that expired on the way, in expiry order */
+	void Advance(uint64 tick, TArray<FSimpleDelegate>& outExpired);
+
+	uint64 GetCurrentTick() const { return currentTick; }
+	int32 Num() const { return numActive; }
+
+private:
+	static const int32 Level0Bits = 8;
+	static const int32 LevelBits = 6;
+	static const int32 NumLevels = 4;
+	static const int32 Level0Slots = 1 << Level0Bits;
+	static const int32 LevelSlots = 1 << LevelBits;
+	static const int32 NumSlots = Level0Slots + (NumLevels - 1) * LevelSlots;
+
+	struct FEntry
+	{
+		uint64 expireTick = 0;
+		FSimpleDelegate callback;
+
+		/** Neighbors in the slot's list, or the next free entry */
+		int32 prev = INDEX_NONE;
+		int32 next = INDEX_NONE;
+
+		/** Slot the entry is linked into, INDEX_NONE while free */
+		int32 slot = INDEX_NONE;
+
+		/** Unique per Add, a handle only matches the timer it was returned for */
+		uint32 serial = 0;
+	};
+
+	/** Slot an expiry belongs in, seen from currentTick */
+	int32 GetSlot(uint64 expireTick) const;
+
+	static int32 GetLevel(int32 slot) { return slot < Level0Slots ? 0 : 1 + (slot - Level0Slots) / LevelSlots; }
+
+	void Link(int32 index);
+	void Unlink(int32 index);
+	void Free(int32 index);
+
+	/** Re-sorts the timers of a coarse slot into the finer levels */
+	void Cascade(int32 slot);
+
+	const FEntry* Find(const FLlamaTimerHandle& handle) const;
+
+	TArray<FEntry> entries;
+	int32 freeHead = INDEX_NONE;
+	int32 numActive = 0;
+
+	/** First entry of each slot's list, level 0 slots first */
+	int32 slotHeads[NumSlots];
+
+	/** Timers linked into each level, empty levels are stepped over a whole turn at a time */
+	int32 levelCounts[NumLevels];
+
+	uint64 currentTick = 0;
+
+	/** Keeps counting through Reset, so a handle held across one can't match a timer that reuses its entry */
+	uint32 nextSerial = 0;
+};
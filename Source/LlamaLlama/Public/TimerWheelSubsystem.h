@@ -0,0 +1,79 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "Tickable.h"
+#include "Engine/World.h"
+#include "TimerWheel.h"
+#include "TimerWheelSubsystem.generated.h"
+
+DECLARE_DYNAMIC_DELEGATE(FLlamaTimerDynamicDelegate);
+
+/**
+ * Gameplay timers of the current map on one FTimerWheel keyed on server time: stuns, push windows, toss releases,
+ * fire re-ignite cooldowns and whatever blueprints schedule. Timers fire together once per frame after the actors
+ * ticked. Since clients run on the synced server clock too, an effect can replicate the server time it ends at and
+ * every machine schedules the end itself, nothing has to replicate when it runs out.
+ */
+UCLASS(config = Game)
+class LLAMALLAMA_API UTimerWheelSubsystem : public UGameInstanceSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	static UTimerWheelSubsystem* Get(const UObject* worldContext);
+
+	/** Wheel resolution, timers fire up to one tick late */
+	UPROPERTY(Config)
+	float ticksPerSecond = 30.f;
+
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	/** Seconds on the server's clock, the authority's world time or the client's synced estimate of it */
+	float GetServerTime() const;
+
+	/** Calls callback once the server clock reaches serverTime, unbound UObject callbacks are skipped */
+	FLlamaTimerHandle SetTimerAt(float serverTime, const FSimpleDelegate& callback);
+
+	/** Calls callback delay seconds from now */
+	FLlamaTimerHandle SetTimer(float delay, const FSimpleDelegate& callback) { return SetTimerAt(GetServerTime() + delay, callback); }
+
+	UFUNCTION(BlueprintCallable, Category = Timers, meta = (DisplayName = "Set Wheel Timer"))
+	FLlamaTimerHandle SetTimerForEvent(const FLlamaTimerDynamicDelegate& event, float delay);
+
+	/** Cancels the timer if it's still pending and invalidates the handle */
+	UFUNCTION(BlueprintCallable, Category = Timers, meta = (DisplayName = "Clear Wheel Timer"))
+	void ClearTimer(UPARAM(ref) FLlamaTimerHandle& handle);
+
+	UFUNCTION(BlueprintPure, Category = Timers, meta = (DisplayName = "Is Wheel Timer Active"))
+	bool IsTimerActive(const FLlamaTimerHandle& handle) const { return wheel.IsActive(handle); }
+
+	/** Seconds until the timer fires, -1 if it isn't active */
+	UFUNCTION(BlueprintPure, Category = Timers, meta = (DisplayName = "Get Wheel Timer Remaining"))
+	float GetTimerRemaining(const FLlamaTimerHandle& handle) const;
+
+	int32 GetNumTimers() const { return wheel.Num(); }
+
+	// FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override { return wheelWorld.IsValid(); }
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override;
+	// End of FTickableGameObject interface
+
+private:
+	void OnPostWorldInitialization(UWorld* world, const UWorld::InitializationValues initValues);
+	void OnWorldCleanup(UWorld* world, bool bSessionEnded, bool bCleanupResources);
+
+	FTimerWheel wheel;
+	TWeakObjectPtr<UWorld> wheelWorld;
+
+	/** Callbacks that expired this frame, kept around so the array doesn't reallocate every frame */
+	TArray<FSimpleDelegate> expired;
+
+	FDelegateHandle postWorldInitHandle;
+	FDelegateHandle worldCleanupHandle;
+};
@@ -0,0 +1,23 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+using UnrealBuildTool;
+using System.Collections.Generic;
+
+public class LlamaLlamaServerTarget : TargetRules
+{
+	public LlamaLlamaServerTarget(TargetInfo Target) : base(Target)
+	{
+		Type = TargetType.Server;
+		ExtraModuleNames.Add("LlamaLlama");
+
+		// the server never renders or plays audio, leave out the engine features that only exist for that
+		BuildEnvironment = TargetBuildEnvironment.Unique;
+		bCompileAPEX = false;
+		bCompileNvCloth = false;
+		bCompileCEF3 = false;
+		bCompileSpeedTree = false;
+
+		// match logs are how server start time and memory get tracked
+		bUseLoggingInShipping = true;
+	}
+}